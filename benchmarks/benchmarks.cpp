@@ -0,0 +1,534 @@
+/*
+Microbenchmarks for the simulation and asset loading hot paths.
+
+Each case is run with a doubling iteration count until one batch takes at
+least the minimum time, then reported as ns/op, items/sec and heap
+allocations per op. Results are printed as a table and written as JSON so
+two builds can be diffed.
+
+Usage:
+    benchmarks [--filter substring] [--min-time seconds] [--json path] [--data-dir path]
+*/
+
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+// Include GLM
+#include <glm/glm.hpp>
+
+#include <common/objloader.hpp>
+#include <common/vboindexer.hpp>
+#include <common/tangentspace.hpp>
+#include <common/mesh_simplifier.hpp>
+#include <common/trace_recorder.hpp>
+
+#include <tanksim/environment.hpp>
+
+#ifndef BENCHMARKS_DATA_DIR
+#define BENCHMARKS_DATA_DIR                 "../tutorial09_vbo_indexing/"
+#endif
+
+/*****************************************************************************/
+/***************************** ALLOCATION COUNTER ****************************/
+/*****************************************************************************/
+
+static std::atomic<unsigned long> g_num_alloc(0);
+
+void * operator new(size_t size) {
+    g_num_alloc.fetch_add(1, std::memory_order_relaxed);
+    void * p = malloc(size == 0 ? 1 : size);
+    if (p == NULL) {
+        throw std::bad_alloc();
+    }
+    return p;
+}
+
+void * operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void * p) noexcept {
+    free(p);
+}
+
+void operator delete[](void * p) noexcept {
+    free(p);
+}
+
+void operator delete(void * p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void * p, size_t) noexcept {
+    free(p);
+}
+
+/*****************************************************************************/
+/********************************** HARNESS **********************************/
+/*****************************************************************************/
+
+typedef struct BenchResult_s {
+    std::string name;
+    long param;
+    long num_iter;
+    double ns_per_op;
+    double items_per_sec;
+    double allocs_per_op;
+} BenchResult_s;
+
+typedef struct BenchConfig_s {
+    char const * filter;
+    double min_time;
+    char const * json_path;
+    std::string data_dir;
+} BenchConfig_s;
+
+// Keeps results observable so the optimizer cannot drop the measured work
+static volatile unsigned long g_sink;
+
+static std::vector<BenchResult_s> g_result_vec;
+
+// body(num_iter) runs the measured operation num_iter times; items_per_op is
+// how many entities / vertices one operation processes
+template <typename F>
+static bool run_bench(BenchConfig_s const & config, char const * name, long param, long items_per_op, F body) {
+    if (config.filter != NULL && strstr(name, config.filter) == NULL) {
+        return false;
+    }
+
+    long num_iter = 1;
+    double elapsed_time = 0.0;
+    unsigned long num_alloc = 0;
+    while (true) {
+        unsigned long alloc_begin = g_num_alloc.load(std::memory_order_relaxed);
+        std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+        body(num_iter);
+        elapsed_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+        num_alloc = g_num_alloc.load(std::memory_order_relaxed) - alloc_begin;
+        if (elapsed_time >= config.min_time || num_iter >= (1L << 40)) {
+            break;
+        }
+        num_iter *= 2;
+    }
+
+    BenchResult_s result;
+    result.name = name;
+    result.param = param;
+    result.num_iter = num_iter;
+    result.ns_per_op = elapsed_time * 1e9 / num_iter;
+    result.items_per_sec = static_cast<double>(num_iter) * items_per_op / elapsed_time;
+    result.allocs_per_op = static_cast<double>(num_alloc) / num_iter;
+    g_result_vec.push_back(result);
+
+    printf("%-36s %8ld %12ld %14.1f %14.3e %10.2f\n",
+        result.name.c_str(), result.param, result.num_iter, result.ns_per_op, result.items_per_sec, result.allocs_per_op);
+    fflush(stdout);
+    return true;
+}
+
+static bool write_json(char const * path) {
+    FILE * file = fopen(path, "w");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return false;
+    }
+    fprintf(file, "{\n  \"benchmarks\": [\n");
+    for (int result_idx = 0; result_idx < g_result_vec.size(); result_idx ++) {
+        BenchResult_s const & result = g_result_vec[result_idx];
+        fprintf(file, "    {\"name\": \"%s\", \"param\": %ld, \"iterations\": %ld, \"ns_per_op\": %.3f, \"items_per_sec\": %.3f, \"allocs_per_op\": %.4f}%s\n",
+            result.name.c_str(), result.param, result.num_iter, result.ns_per_op, result.items_per_sec, result.allocs_per_op,
+            result_idx + 1 < g_result_vec.size() ? "," : "");
+    }
+    fprintf(file, "  ]\n}\n");
+    fclose(file);
+    return true;
+}
+
+/*****************************************************************************/
+/********************************** FIXTURES *********************************/
+/*****************************************************************************/
+
+static unsigned int g_rand_state = 1;
+
+// Small LCG, keeps fixtures identical between runs and independent of rand()
+static float bench_rand(float lo, float hi) {
+    g_rand_state = g_rand_state * 1664525u + 1013904223u;
+    return lo + (hi - lo) * static_cast<float>(g_rand_state >> 8) / static_cast<float>(1u << 24);
+}
+
+// Default environment with its obstacles replaced by num_obst random ones
+static bool bench_env_init(Environment_s & env, int num_obst) {
+    env_init(env);
+    g_rand_state = 1;
+    env.obst_vec.clear();
+    for (int obst_idx = 0; obst_idx < num_obst; obst_idx ++) {
+        env.obst_vec.push_back(Obst(bench_rand(BOUND_X_MIN, BOUND_X_MAX), bench_rand(BOUND_Y_MIN, BOUND_Y_MAX), 1.0f, 1.0f));
+    }
+    return env_build_broadphase(env);
+}
+
+// Flat n x n quad grid, two triangles per quad, unindexed like loadOBJ output
+static bool bench_make_grid_mesh(int n, std::vector<glm::vec3> & vertices, std::vector<glm::vec2> & uvs, std::vector<glm::vec3> & normals) {
+    vertices.clear();
+    uvs.clear();
+    normals.clear();
+    static int const corner_x[6] = {0, 1, 1, 0, 1, 0};
+    static int const corner_y[6] = {0, 0, 1, 0, 1, 1};
+    for (int j = 0; j < n; j ++) {
+        for (int i = 0; i < n; i ++) {
+            for (int corner = 0; corner < 6; corner ++) {
+                float u = static_cast<float>(i + corner_x[corner]) / n;
+                float v = static_cast<float>(j + corner_y[corner]) / n;
+                vertices.push_back(glm::vec3(u, v, 0.0f));
+                uvs.push_back(glm::vec2(u, v));
+                normals.push_back(glm::vec3(0.0f, 0.0f, 1.0f));
+            }
+        }
+    }
+    return true;
+}
+
+/*****************************************************************************/
+/*********************************** CASES ***********************************/
+/*****************************************************************************/
+
+static void bench_collision(BenchConfig_s const & config) {
+    static int const num_vec[] = {16, 256, 4096};
+    for (int num_idx = 0; num_idx < 3; num_idx ++) {
+        int num = num_vec[num_idx];
+        g_rand_state = 1;
+        std::vector<Sphere> sphere_vec;
+        SphereSoA sphere_soa;
+        std::vector<int> idx_vec;
+        for (int i = 0; i < num; i ++) {
+            sphere_vec.push_back(Sphere(bench_rand(-20.0f, 20.0f), bench_rand(-20.0f, 20.0f), bench_rand(0.0f, 2.0f), 1.0f));
+            sphere_soa.push_back(sphere_vec.back());
+            idx_vec.push_back(i);
+        }
+        Sphere probe(0.0f, 0.0f, 1.0f, 2.0f);
+
+        run_bench(config, "sphere_check_is_collided", num, num, [&](long num_iter) {
+            unsigned long num_hit = 0;
+            for (long iter = 0; iter < num_iter; iter ++) {
+                for (int i = 0; i < num; i ++) {
+                    num_hit += Sphere::check_is_collided(probe, sphere_vec[i]) ? 1 : 0;
+                }
+            }
+            g_sink = num_hit;
+        });
+
+        std::vector<int> candidate_vec;
+        candidate_vec.reserve(num);
+        run_bench(config, "sphere_soa_filter_collided", num, num, [&](long num_iter) {
+            unsigned long num_hit = 0;
+            for (long iter = 0; iter < num_iter; iter ++) {
+                candidate_vec.assign(idx_vec.begin(), idx_vec.end());
+                sphere_soa.filter_collided(probe, candidate_vec);
+                num_hit += candidate_vec.size();
+            }
+            g_sink = num_hit;
+        });
+    }
+}
+
+static void bench_movement(BenchConfig_s const & config) {
+    static int const num_obst_vec[] = {20, 200, 2000};
+    for (int num_idx = 0; num_idx < 3; num_idx ++) {
+        int num_obst = num_obst_vec[num_idx];
+
+        Environment_s env;
+        bench_env_init(env, num_obst);
+        run_bench(config, "tank_move_and_check", num_obst, 1, [&](long num_iter) {
+            Tank & tank = env.tank_vec[0];
+            for (long iter = 0; iter < num_iter; iter ++) {
+                // back and forth so the tank stays in place over a batch
+                float dist = (iter & 1) ? -0.01f : 0.01f;
+                tank_move_and_check(tank, tank.get_dir_x(), tank.get_dir_y(), tank.get_dir_z(), dist, env);
+            }
+        });
+
+        Environment_s ammo_env;
+        bench_env_init(ammo_env, num_obst);
+        run_bench(config, "ammo_move_and_check", num_obst, 1, [&](long num_iter) {
+            for (long iter = 0; iter < num_iter; iter ++) {
+                // a fresh shot crossing the arena at a fixed height above the obstacles
+                Ammo ammo(BOUND_X_MIN, bench_rand(BOUND_Y_MIN, BOUND_Y_MAX), 3.0f, 0.5f, 0.0f, 0.0f, 25.0f);
+                ammo_move_and_check(ammo, 0.1f, ammo_env);
+            }
+        });
+
+        Environment_s tick_env;
+        bench_env_init(tick_env, num_obst);
+        run_bench(config, "env_tick", num_obst, 1, [&](long num_iter) {
+            for (long iter = 0; iter < num_iter; iter ++) {
+                env_tick(tick_env, tick_env.tick_time);
+            }
+        });
+    }
+}
+
+// Obstacle BVH queries against a fixed set of probe tanks scattered over the
+// arena; the raycasts cross the whole arena like a line-of-sight check
+static void bench_obst_bvh(BenchConfig_s const & config) {
+    static int const num_obst_vec[] = {20, 200, 2000};
+    int const num_probe = 64;
+    for (int num_idx = 0; num_idx < 3; num_idx ++) {
+        int num_obst = num_obst_vec[num_idx];
+
+        Environment_s env;
+        bench_env_init(env, num_obst);
+        std::vector<Sphere> probe_vec;
+        std::vector<float> dir_vec;
+        std::vector<float> dist_vec;
+        for (int probe_idx = 0; probe_idx < num_probe; probe_idx ++) {
+            probe_vec.push_back(Sphere(bench_rand(BOUND_X_MIN, BOUND_X_MAX), bench_rand(BOUND_Y_MIN, BOUND_Y_MAX), 1.0f, 1.0f));
+            float angle_xy = bench_rand(0.0f, 4.0f * MY_PI_HALF);
+            dir_vec.push_back(cos(angle_xy));
+            dir_vec.push_back(sin(angle_xy));
+            dir_vec.push_back(0.0f);
+            dist_vec.push_back(BOUND_X_MAX - BOUND_X_MIN);
+        }
+
+        std::vector<int> idx_vec;
+        run_bench(config, "obst_bvh_query", num_obst, num_probe, [&](long num_iter) {
+            unsigned long num_hit = 0;
+            for (long iter = 0; iter < num_iter; iter ++) {
+                for (int probe_idx = 0; probe_idx < num_probe; probe_idx ++) {
+                    env.obst_bvh.query(probe_vec[probe_idx], idx_vec);
+                    num_hit += idx_vec.size();
+                }
+            }
+            g_sink = num_hit;
+        });
+
+        run_bench(config, "obst_bvh_raycast", num_obst, num_probe, [&](long num_iter) {
+            unsigned long num_hit = 0;
+            for (long iter = 0; iter < num_iter; iter ++) {
+                for (int probe_idx = 0; probe_idx < num_probe; probe_idx ++) {
+                    int hit_idx = -1;
+                    float toi = 0.0f;
+                    float const * dir = &dir_vec[probe_idx * 3];
+                    num_hit += env.obst_bvh.raycast(probe_vec[probe_idx], dir[0], dir[1], dir[2], dist_vec[probe_idx], hit_idx, toi) ? 1 : 0;
+                }
+            }
+            g_sink = num_hit;
+        });
+    }
+}
+
+// Every tank drives full speed along +x, so they pile up against the wall and
+// each other and the contact solver has work on every tick
+class BenchPileupInputSource : public TankInputSource {
+    public:
+    bool get_tank_act(TankAction_s & tank_act, int tank_idx, float delta_time) {
+        tank_act.turn_angle_xy = 0.0f;
+        tank_act.advance_dist = 1.0f;
+        tank_act.is_firing = 0;
+        return true;
+    }
+};
+
+static void bench_contacts(BenchConfig_s const & config) {
+    static int const num_tank_vec[] = {8, 16, 32};
+    for (int num_idx = 0; num_idx < 3; num_idx ++) {
+        int num_tank = num_tank_vec[num_idx];
+
+        Scenario_s scenario;
+        scenario_set_default(scenario);
+        scenario.num_obst = 0;
+        scenario.num_rain = 0;
+        scenario.num_tank = num_tank;
+        scenario.tank_spawn = SCENARIO_SPAWN_UNIFORM;
+        Environment_s env;
+        env_init(env, scenario);
+        BenchPileupInputSource input;
+        env.p_input = &input;
+        // let the pile form before timing
+        for (int tick_idx = 0; tick_idx < 2000; tick_idx ++) {
+            env_tick(env, env.tick_time);
+        }
+        run_bench(config, "tank_pileup_tick", num_tank, num_tank, [&](long num_iter) {
+            for (long iter = 0; iter < num_iter; iter ++) {
+                env_tick(env, env.tick_time);
+            }
+        });
+    }
+}
+
+// Whole ticks of the default world with its rain scaled up and no tank input,
+// so the time is dominated by the rain step
+static void bench_rain(BenchConfig_s const & config) {
+    static int const num_rain_vec[] = {1000, 10000, 100000};
+    for (int num_idx = 0; num_idx < 3; num_idx ++) {
+        int num_rain = num_rain_vec[num_idx];
+
+        Scenario_s scenario;
+        scenario_set_default(scenario);
+        scenario.num_rain = num_rain;
+        Environment_s env;
+        env_init(env, scenario);
+        run_bench(config, "rain_tick", num_rain, num_rain, [&](long num_iter) {
+            for (long iter = 0; iter < num_iter; iter ++) {
+                env_tick(env, env.tick_time);
+            }
+        });
+    }
+}
+
+static void bench_mesh(BenchConfig_s const & config) {
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec2> uvs;
+    std::vector<glm::vec3> normals;
+    std::vector<unsigned short> out_indices;
+    std::vector<glm::vec3> out_vertices;
+    std::vector<glm::vec2> out_uvs;
+    std::vector<glm::vec3> out_normals;
+    std::vector<glm::vec3> tangents;
+    std::vector<glm::vec3> bitangents;
+
+    std::string tank_path = config.data_dir + "tank.obj";
+    if (loadOBJ(tank_path.c_str(), vertices, uvs, normals)) {
+        long num_vert = vertices.size();
+        run_bench(config, "loadOBJ_tank", num_vert, num_vert, [&](long num_iter) {
+            for (long iter = 0; iter < num_iter; iter ++) {
+                vertices.clear();
+                uvs.clear();
+                normals.clear();
+                loadOBJ(tank_path.c_str(), vertices, uvs, normals);
+            }
+        });
+        run_bench(config, "indexVBO_tank", num_vert, num_vert, [&](long num_iter) {
+            for (long iter = 0; iter < num_iter; iter ++) {
+                out_indices.clear();
+                out_vertices.clear();
+                out_uvs.clear();
+                out_normals.clear();
+                indexVBO(vertices, uvs, normals, out_indices, out_vertices, out_uvs, out_normals);
+            }
+        });
+        run_bench(config, "indexVBO_slow_tank", num_vert, num_vert, [&](long num_iter) {
+            for (long iter = 0; iter < num_iter; iter ++) {
+                out_indices.clear();
+                out_vertices.clear();
+                out_uvs.clear();
+                out_normals.clear();
+                indexVBO_slow(vertices, uvs, normals, out_indices, out_vertices, out_uvs, out_normals);
+            }
+        });
+        // one level of detail per param, halving the triangles each time
+        std::vector<unsigned short> indices;
+        std::vector<PackedVertex> packed_vertices;
+        std::vector<unsigned short> lod_indices;
+        indexVBO_interleaved(vertices, uvs, normals, indices, packed_vertices);
+        for (int lod = 1; lod < 4; lod ++) {
+            run_bench(config, "simplifyMesh_tank", lod, indices.size() / 3, [&](long num_iter) {
+                for (long iter = 0; iter < num_iter; iter ++) {
+                    simplifyMesh(indices, packed_vertices, (indices.size() >> lod) / 3 * 3, lod_indices);
+                }
+            });
+        }
+    }
+    else {
+        fprintf(stderr, "Skipping tank.obj cases, set --data-dir\n");
+    }
+
+    static int const grid_size_vec[] = {16, 32, 64};
+    for (int size_idx = 0; size_idx < 3; size_idx ++) {
+        int grid_size = grid_size_vec[size_idx];
+        bench_make_grid_mesh(grid_size, vertices, uvs, normals);
+        long num_vert = vertices.size();
+
+        run_bench(config, "indexVBO_grid", num_vert, num_vert, [&](long num_iter) {
+            for (long iter = 0; iter < num_iter; iter ++) {
+                out_indices.clear();
+                out_vertices.clear();
+                out_uvs.clear();
+                out_normals.clear();
+                indexVBO(vertices, uvs, normals, out_indices, out_vertices, out_uvs, out_normals);
+            }
+        });
+        run_bench(config, "indexVBO_slow_grid", num_vert, num_vert, [&](long num_iter) {
+            for (long iter = 0; iter < num_iter; iter ++) {
+                out_indices.clear();
+                out_vertices.clear();
+                out_uvs.clear();
+                out_normals.clear();
+                indexVBO_slow(vertices, uvs, normals, out_indices, out_vertices, out_uvs, out_normals);
+            }
+        });
+        run_bench(config, "computeTangentBasis_grid", num_vert, num_vert, [&](long num_iter) {
+            for (long iter = 0; iter < num_iter; iter ++) {
+                tangents.clear();
+                bitangents.clear();
+                computeTangentBasis(vertices, uvs, normals, tangents, bitangents);
+            }
+        });
+    }
+}
+
+// One empty trace zone, param 0 with recording off and 1 with it on. Runs
+// last, since it leaves the recorder with the events it took, never written.
+static void bench_trace(BenchConfig_s const & config) {
+    for (int is_enabled = 0; is_enabled < 2; is_enabled ++) {
+        if (is_enabled) {
+            trace_start("benchmarks_trace.json");
+        }
+        run_bench(config, "trace_zone", is_enabled, 1, [&](long num_iter) {
+            for (long iter = 0; iter < num_iter; iter ++) {
+                TRACE_ZONE("bench");
+                g_sink += 1;
+            }
+        });
+        trace_stop();
+    }
+}
+
+int main(int argc, char ** argv) {
+    BenchConfig_s config;
+    config.filter = NULL;
+    config.min_time = 0.2;
+    config.json_path = "benchmarks.json";
+    config.data_dir = BENCHMARKS_DATA_DIR;
+
+    for (int arg_idx = 1; arg_idx + 1 < argc; arg_idx += 2) {
+        if (strcmp(argv[arg_idx], "--filter") == 0) {
+            config.filter = argv[arg_idx + 1];
+        }
+        else if (strcmp(argv[arg_idx], "--min-time") == 0) {
+            config.min_time = atof(argv[arg_idx + 1]);
+        }
+        else if (strcmp(argv[arg_idx], "--json") == 0) {
+            config.json_path = argv[arg_idx + 1];
+        }
+        else if (strcmp(argv[arg_idx], "--data-dir") == 0) {
+            config.data_dir = argv[arg_idx + 1];
+            config.data_dir += "/";
+        }
+        else {
+            fprintf(stderr, "Unknown option %s\n", argv[arg_idx]);
+            return -1;
+        }
+    }
+
+    printf("%-36s %8s %12s %14s %14s %10s\n", "name", "param", "iterations", "ns/op", "items/sec", "allocs/op");
+    bench_collision(config);
+    bench_movement(config);
+    bench_obst_bvh(config);
+    bench_contacts(config);
+    bench_rain(config);
+    bench_mesh(config);
+    bench_trace(config);
+
+    if (write_json(config.json_path) == false) {
+        return -1;
+    }
+    printf("Results written to %s\n", config.json_path);
+    return 0;
+}
@@ -0,0 +1,201 @@
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+#include "asset_registry.hpp"
+#include "objloader.hpp"
+#include "vboindexer.hpp"
+#include "mesh_simplifier.hpp"
+#include "texture.hpp"
+#include "trace_recorder.hpp"
+
+#define ASSET_REGISTRY_MAX_MIP_LEVELS       (16)
+#define ASSET_REGISTRY_MIN_LOD_REDUCTION     (0.75f) // a level must drop at least a quarter of the indices
+
+// Sums the driver's size of every mip level; uncompressed levels count 4 bytes
+// per texel, which is what RGB8 takes on most hardware
+static size_t asset_get_texture_num_bytes(GLuint texture){
+	glBindTexture(GL_TEXTURE_2D, texture);
+	size_t num_bytes = 0;
+	for (int level = 0; level < ASSET_REGISTRY_MAX_MIP_LEVELS; level ++) {
+		GLint width = 0, height = 0, is_compressed = 0;
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+		if (width == 0 || height == 0) {
+			break;
+		}
+		glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED, &is_compressed);
+		if (is_compressed) {
+			GLint level_bytes = 0;
+			glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_COMPRESSED_IMAGE_SIZE, &level_bytes);
+			num_bytes += level_bytes;
+		}
+		else {
+			num_bytes += static_cast<size_t>(width) * height * 4;
+		}
+	}
+	return num_bytes;
+}
+
+AssetRegistry::Entry_s * AssetRegistry::find(char const * path, bool is_mesh){
+	std::map<std::string, Entry_s>::iterator it = entry_map.find(path);
+	if (it == entry_map.end()) {
+		return NULL;
+	}
+	if (it->second.is_mesh != is_mesh) {
+		fprintf(stderr, "%s is registered as a %s\n", path, it->second.is_mesh ? "mesh" : "texture");
+		return NULL;
+	}
+	return &it->second;
+}
+
+MeshAsset_s const * AssetRegistry::acquire_mesh(char const * path, int max_num_lods){
+	Entry_s * p_entry = find(path, true);
+	if (p_entry != NULL) {
+		p_entry->ref_cnt ++;
+		return &p_entry->mesh;
+	}
+	if (entry_map.count(path) != 0) {
+		return NULL;
+	}
+
+	TRACE_ZONE("acquire_mesh");
+	std::vector<glm::vec3> vertices;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec3> normals;
+	if (loadOBJ(path, vertices, uvs, normals) == false || vertices.empty()) {
+		fprintf(stderr, "Failed to load mesh %s\n", path);
+		return NULL;
+	}
+	std::vector<unsigned short> indices;
+	std::vector<PackedVertex> packed_vertices;
+	indexVBO_interleaved(vertices, uvs, normals, indices, packed_vertices);
+
+	Entry_s entry;
+	entry.ref_cnt = 1;
+	entry.is_mesh = true;
+	entry.texture.texture = 0;
+	entry.texture.num_bytes = 0;
+	MeshAsset_s & mesh = entry.mesh;
+	mesh.vert_cnt = static_cast<GLsizei>(packed_vertices.size());
+	mesh.elem_cnt = static_cast<GLsizei>(indices.size());
+	mesh.num_lods = 1;
+	mesh.lod_elem_start[0] = 0;
+	mesh.lod_elem_cnt[0] = mesh.elem_cnt;
+	mesh.lod_error[0] = 0.0f;
+	// every level is simplified from the full mesh, so errors do not pile up
+	std::vector<unsigned short> elem_indices(indices);
+	std::vector<unsigned short> lod_indices;
+	while (mesh.num_lods < std::min(max_num_lods, MESH_ASSET_MAX_LODS)) {
+		int lod = mesh.num_lods;
+		float error = simplifyMesh(indices, packed_vertices, (indices.size() >> lod) / 3 * 3, lod_indices);
+		if (lod_indices.empty() || lod_indices.size() > mesh.lod_elem_cnt[lod - 1] * ASSET_REGISTRY_MIN_LOD_REDUCTION) {
+			break;
+		}
+		mesh.lod_elem_start[lod] = static_cast<GLsizei>(elem_indices.size());
+		mesh.lod_elem_cnt[lod] = static_cast<GLsizei>(lod_indices.size());
+		mesh.lod_error[lod] = error;
+		elem_indices.insert(elem_indices.end(), lod_indices.begin(), lod_indices.end());
+		mesh.num_lods ++;
+	}
+	mesh.bound_r = 0.0f;
+	for (size_t vert_idx = 0; vert_idx < packed_vertices.size(); vert_idx ++) {
+		mesh.bound_r = std::max(mesh.bound_r, glm::length(packed_vertices[vert_idx].position));
+	}
+	mesh.num_bytes = packed_vertices.size() * sizeof(PackedVertex) + elem_indices.size() * sizeof(unsigned short);
+	// both go through GL_ARRAY_BUFFER, an element buffer binding would need a vertex array
+	glGenBuffers(1, &mesh.vert_buf);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.vert_buf);
+	glBufferData(GL_ARRAY_BUFFER, packed_vertices.size() * sizeof(PackedVertex), &packed_vertices[0], GL_STATIC_DRAW);
+	glGenBuffers(1, &mesh.elem_buf);
+	glBindBuffer(GL_ARRAY_BUFFER, mesh.elem_buf);
+	glBufferData(GL_ARRAY_BUFFER, elem_indices.size() * sizeof(unsigned short), &elem_indices[0], GL_STATIC_DRAW);
+
+	return &(entry_map[path] = entry).mesh;
+}
+
+TextureAsset_s const * AssetRegistry::acquire_texture(char const * path){
+	Entry_s * p_entry = find(path, false);
+	if (p_entry != NULL) {
+		p_entry->ref_cnt ++;
+		return &p_entry->texture;
+	}
+	if (entry_map.count(path) != 0) {
+		return NULL;
+	}
+
+	TRACE_ZONE("acquire_texture");
+	size_t path_len = strlen(path);
+	bool is_bmp = path_len >= 4 && (strcmp(path + path_len - 4, ".bmp") == 0 || strcmp(path + path_len - 4, ".BMP") == 0);
+	GLuint texture = is_bmp ? loadBMP_custom(path) : loadDDS(path);
+	if (texture == 0) {
+		fprintf(stderr, "Failed to load texture %s\n", path);
+		return NULL;
+	}
+
+	Entry_s entry;
+	entry.ref_cnt = 1;
+	entry.is_mesh = false;
+	entry.mesh.vert_buf = 0;
+	entry.mesh.elem_buf = 0;
+	entry.mesh.vert_cnt = 0;
+	entry.mesh.elem_cnt = 0;
+	entry.mesh.num_lods = 0;
+	entry.mesh.bound_r = 0.0f;
+	entry.mesh.num_bytes = 0;
+	entry.texture.texture = texture;
+	entry.texture.num_bytes = asset_get_texture_num_bytes(texture);
+
+	return &(entry_map[path] = entry).texture;
+}
+
+bool AssetRegistry::release_mesh(char const * path){
+	Entry_s * p_entry = find(path, true);
+	if (p_entry == NULL) {
+		return false;
+	}
+	if (-- p_entry->ref_cnt == 0) {
+		glDeleteBuffers(1, &p_entry->mesh.vert_buf);
+		glDeleteBuffers(1, &p_entry->mesh.elem_buf);
+		entry_map.erase(path);
+	}
+	return true;
+}
+
+bool AssetRegistry::release_texture(char const * path){
+	Entry_s * p_entry = find(path, false);
+	if (p_entry == NULL) {
+		return false;
+	}
+	if (-- p_entry->ref_cnt == 0) {
+		glDeleteTextures(1, &p_entry->texture.texture);
+		entry_map.erase(path);
+	}
+	return true;
+}
+
+size_t AssetRegistry::get_num_bytes() const{
+	size_t num_bytes = 0;
+	for (std::map<std::string, Entry_s>::const_iterator it = entry_map.begin(); it != entry_map.end(); ++ it) {
+		num_bytes += it->second.is_mesh ? it->second.mesh.num_bytes : it->second.texture.num_bytes;
+	}
+	return num_bytes;
+}
+
+bool AssetRegistry::print(FILE * file) const{
+	fprintf(file, "%-24s %8s %6s %12s\n", "asset", "kind", "refs", "GPU bytes");
+	for (std::map<std::string, Entry_s>::const_iterator it = entry_map.begin(); it != entry_map.end(); ++ it) {
+		Entry_s const & entry = it->second;
+		fprintf(file, "%-24s %8s %6d %12lu\n", it->first.c_str(), entry.is_mesh ? "mesh" : "texture", entry.ref_cnt,
+			static_cast<unsigned long>(entry.is_mesh ? entry.mesh.num_bytes : entry.texture.num_bytes));
+		for (int lod = 0; entry.is_mesh && entry.mesh.num_lods > 1 && lod < entry.mesh.num_lods; lod ++) {
+			fprintf(file, "  LOD %d: %6d triangles, error %.3f\n", lod, entry.mesh.lod_elem_cnt[lod] / 3, entry.mesh.lod_error[lod]);
+		}
+	}
+	fprintf(file, "%-24s %8s %6s %12lu\n", "total", "", "", static_cast<unsigned long>(get_num_bytes()));
+	return true;
+}
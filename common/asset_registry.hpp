@@ -0,0 +1,66 @@
+#ifndef ASSET_REGISTRY_HPP
+#define ASSET_REGISTRY_HPP
+
+#include <stdio.h>
+#include <map>
+#include <string>
+
+#define MESH_ASSET_MAX_LODS                 (4)
+
+// Indexed mesh on the GPU: one interleaved vertex buffer of PackedVertex
+// (see vboindexer.hpp) and its unsigned short indices. Levels of detail from
+// simplifyMesh index the same vertices and follow the full mesh in elem_buf.
+typedef struct MeshAsset_s {
+	GLuint vert_buf;
+	GLuint elem_buf;
+	GLsizei vert_cnt;
+	GLsizei elem_cnt;        // full mesh, the same as lod_elem_cnt[0]
+	int num_lods;
+	GLsizei lod_elem_start[MESH_ASSET_MAX_LODS];     // first index of each level in elem_buf
+	GLsizei lod_elem_cnt[MESH_ASSET_MAX_LODS];
+	float lod_error[MESH_ASSET_MAX_LODS];            // simplifyMesh error, in model units
+	float bound_r;           // farthest vertex from the model origin
+	size_t num_bytes;
+} MeshAsset_s;
+
+typedef struct TextureAsset_s {
+	GLuint texture;
+	size_t num_bytes;       // all mip levels, as reported by the driver
+} TextureAsset_s;
+
+// GPU meshes (.obj) and textures (.dds, .bmp) shared by path: the first
+// acquire loads the file, later ones return the same asset, and the last
+// matching release frees it. Handles stay valid until then. Needs a current
+// GL context throughout; release everything before destroying the context.
+class AssetRegistry {
+	typedef struct Entry_s {
+		int ref_cnt;
+		bool is_mesh;
+		MeshAsset_s mesh;
+		TextureAsset_s texture;
+	} Entry_s;
+
+	std::map<std::string, Entry_s> entry_map;
+
+	Entry_s * find(char const * path, bool is_mesh);
+
+public:
+	// Both return NULL, after printing why, if the file fails to load.
+	// max_num_lods > 1 adds up to that many levels in all, each about half the
+	// triangles of the one before, as long as the mesh still simplifies; only
+	// the first acquire of a path decides.
+	MeshAsset_s const * acquire_mesh(char const * path, int max_num_lods = 1);
+	TextureAsset_s const * acquire_texture(char const * path);
+	bool release_mesh(char const * path);
+	bool release_texture(char const * path);
+
+	int get_num_assets() const{
+		return static_cast<int>(entry_map.size());
+	}
+	size_t get_num_bytes() const;
+	// One line per resident asset with its references and GPU bytes, and
+	// the triangles of every level of detail
+	bool print(FILE * file) const;
+};
+
+#endif
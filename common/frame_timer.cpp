@@ -0,0 +1,138 @@
+#include <stdio.h>
+#include <chrono>
+#include <algorithm>
+
+#include "frame_timer.hpp"
+#include "trace_recorder.hpp"
+
+static unsigned long long frame_timer_get_ns(){
+	return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static char const * const g_frame_timer_column_name_vec[FRAME_TIMER_NUM_COLUMNS] = {
+	"frame", "cpu", "ground", "obst", "tank", "ammo", "rain", "shadow", "swap",
+};
+
+FrameTimer::FrameTimer() :
+	is_recording_rows(false),
+	p_sync_fn(NULL),
+	is_in_frame(false),
+	frame_start_ns(0),
+	open_section(-1),
+	section_start_ns(0)
+{
+	std::fill(section_ns, section_ns + FRAME_SECTION_NUM, 0ull);
+}
+
+char const * FrameTimer::get_column_name(int column){
+	return g_frame_timer_column_name_vec[column];
+}
+
+bool FrameTimer::set_is_recording_rows(bool is_recording_rows){
+	this->is_recording_rows = is_recording_rows;
+	return true;
+}
+
+bool FrameTimer::set_sync_fn(void (*p_sync_fn)()){
+	this->p_sync_fn = p_sync_fn;
+	return true;
+}
+
+bool FrameTimer::end_frame(unsigned long long end_ns){
+	unsigned long long column_ns[FRAME_TIMER_NUM_COLUMNS];
+	column_ns[FRAME_TIMER_COLUMN_FRAME] = end_ns - frame_start_ns;
+	column_ns[FRAME_TIMER_COLUMN_CPU] = column_ns[FRAME_TIMER_COLUMN_FRAME] - std::min(section_ns[FRAME_SECTION_SWAP], column_ns[FRAME_TIMER_COLUMN_FRAME]);
+	for (int section = 0; section < FRAME_SECTION_NUM; section ++) {
+		column_ns[FRAME_TIMER_COLUMN_SECTION + section] = section_ns[section];
+	}
+	FrameRow_s row;
+	for (int column = 0; column < FRAME_TIMER_NUM_COLUMNS; column ++) {
+		total_hist_vec[column].add(column_ns[column]);
+		window_hist_vec[column].add(column_ns[column]);
+		row.ms[column] = static_cast<float>(column_ns[column] * 1e-6);
+	}
+	if (is_recording_rows) {
+		row_vec.push_back(row);
+	}
+	trace_add_event(get_column_name(FRAME_TIMER_COLUMN_FRAME), frame_start_ns, column_ns[FRAME_TIMER_COLUMN_FRAME]);
+	return true;
+}
+
+bool FrameTimer::begin_frame(){
+	end_section();
+	unsigned long long now_ns = frame_timer_get_ns();
+	if (is_in_frame) {
+		end_frame(now_ns);
+	}
+	is_in_frame = true;
+	frame_start_ns = now_ns;
+	std::fill(section_ns, section_ns + FRAME_SECTION_NUM, 0ull);
+	return true;
+}
+
+bool FrameTimer::begin_section(int section){
+	end_section();
+	open_section = section;
+	section_start_ns = frame_timer_get_ns();
+	return true;
+}
+
+bool FrameTimer::end_section(){
+	if (open_section < 0) {
+		return false;
+	}
+	if (p_sync_fn != NULL) {
+		p_sync_fn();
+	}
+	// a section may be entered more than once per frame
+	unsigned long long ns = frame_timer_get_ns() - section_start_ns;
+	section_ns[open_section] += ns;
+	trace_add_event(get_column_name(FRAME_TIMER_COLUMN_SECTION + open_section), section_start_ns, ns);
+	open_section = -1;
+	return true;
+}
+
+bool FrameTimer::print_window(FILE * file){
+	LogHistogram & hist = window_hist_vec[FRAME_TIMER_COLUMN_FRAME];
+	if (hist.get_num_samples() == 0) {
+		return false;
+	}
+	fprintf(file, "%llu frames, %.3f ms/frame, p50 < %.3f ms, p99 < %.3f ms, max %.3f ms\n",
+		hist.get_num_samples(), hist.get_mean() * 1e-6, hist.get_percentile(0.5) * 1e-6, hist.get_percentile(0.99) * 1e-6, hist.get_max() * 1e-6);
+	for (int column = 0; column < FRAME_TIMER_NUM_COLUMNS; column ++) {
+		window_hist_vec[column].clear();
+	}
+	return true;
+}
+
+bool FrameTimer::print(FILE * file) const {
+	fprintf(file, "%-8s %10s %10s %10s %10s %10s %10s\n", "ms", "frames", "mean", "p50", "p95", "p99", "max");
+	for (int column = 0; column < FRAME_TIMER_NUM_COLUMNS; column ++) {
+		LogHistogram const & hist = total_hist_vec[column];
+		fprintf(file, "%-8s %10llu %10.3f %10.3f %10.3f %10.3f %10.3f\n", get_column_name(column), hist.get_num_samples(),
+			hist.get_mean() * 1e-6, hist.get_percentile(0.5) * 1e-6, hist.get_percentile(0.95) * 1e-6, hist.get_percentile(0.99) * 1e-6, hist.get_max() * 1e-6);
+	}
+	return true;
+}
+
+bool FrameTimer::write_csv(char const * path) const {
+	FILE * file = fopen(path, "w");
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open %s\n", path);
+		return false;
+	}
+	fprintf(file, "frame_idx");
+	for (int column = 0; column < FRAME_TIMER_NUM_COLUMNS; column ++) {
+		fprintf(file, ",%s_ms", get_column_name(column));
+	}
+	fprintf(file, "\n");
+	for (size_t row_idx = 0; row_idx < row_vec.size(); row_idx ++) {
+		fprintf(file, "%lu", static_cast<unsigned long>(row_idx));
+		for (int column = 0; column < FRAME_TIMER_NUM_COLUMNS; column ++) {
+			fprintf(file, ",%.4f", row_vec[row_idx].ms[column]);
+		}
+		fprintf(file, "\n");
+	}
+	fclose(file);
+	return true;
+}
@@ -0,0 +1,73 @@
+#ifndef FRAME_TIMER_HPP
+#define FRAME_TIMER_HPP
+
+#include <stdio.h>
+#include <vector>
+
+#include "log_histogram.hpp"
+
+// Draw sections of one frame, timed between begin_section and end_section
+#define FRAME_SECTION_GROUND                (0)
+#define FRAME_SECTION_OBST                  (1)
+#define FRAME_SECTION_TANK                  (2)
+#define FRAME_SECTION_AMMO                  (3)
+#define FRAME_SECTION_RAIN                  (4)
+#define FRAME_SECTION_SHADOW                (5)
+#define FRAME_SECTION_SWAP                  (6)
+#define FRAME_SECTION_NUM                   (7)
+
+// Render loop timing: call begin_frame at the top of every frame, wrap the
+// draw sections and the buffer swap in begin_section / end_section. A frame
+// lasts from one begin_frame to the next; its CPU time is that minus the swap.
+// Keeps all-time and per-window histograms of every column and, if asked,
+// every frame as a row for write_csv.
+// The section times are CPU submission times unless a sync function (e.g. one
+// calling glFinish) is set, which then runs at the end of every section.
+// While trace_start is on, every frame and section is also a trace zone.
+class FrameTimer {
+	#define FRAME_TIMER_COLUMN_FRAME            (0)
+	#define FRAME_TIMER_COLUMN_CPU              (1)
+	#define FRAME_TIMER_COLUMN_SECTION          (2)     // first section column
+	#define FRAME_TIMER_NUM_COLUMNS             (FRAME_TIMER_COLUMN_SECTION + FRAME_SECTION_NUM)
+
+	typedef struct FrameRow_s {
+		float ms[FRAME_TIMER_NUM_COLUMNS];
+	} FrameRow_s;
+
+	LogHistogram total_hist_vec[FRAME_TIMER_NUM_COLUMNS];
+	LogHistogram window_hist_vec[FRAME_TIMER_NUM_COLUMNS];
+	std::vector<FrameRow_s> row_vec;
+	bool is_recording_rows;
+	void (*p_sync_fn)();
+
+	bool is_in_frame;
+	unsigned long long frame_start_ns;
+	int open_section;                               // -1 if none
+	unsigned long long section_start_ns;
+	unsigned long long section_ns[FRAME_SECTION_NUM];
+
+	bool end_frame(unsigned long long end_ns);
+
+public:
+	FrameTimer();
+
+	static char const * get_column_name(int column);
+
+	// Keep every frame for write_csv; costs one row of floats per frame
+	bool set_is_recording_rows(bool is_recording_rows);
+	bool set_sync_fn(void (*p_sync_fn)());
+
+	// Closes the previous frame, if any, and starts a new one
+	bool begin_frame();
+	bool begin_section(int section);
+	bool end_section();
+
+	// One line for the frames since the previous print_window: count, mean, p50, p99 and max frame time
+	bool print_window(FILE * file);
+	// Every column over all frames
+	bool print(FILE * file) const;
+	// One row per recorded frame, times in ms
+	bool write_csv(char const * path) const;
+};
+
+#endif
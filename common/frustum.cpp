@@ -0,0 +1,55 @@
+#include <math.h>
+
+#include "frustum.hpp"
+
+Frustum::Frustum(){
+	// until set_view_proj, everything is inside
+	for (int plane_idx = 0; plane_idx < FRUSTUM_NUM_PLANES; plane_idx ++) {
+		plane_a[plane_idx] = 0.0f;
+		plane_b[plane_idx] = 0.0f;
+		plane_c[plane_idx] = 0.0f;
+		plane_d[plane_idx] = 1.0f;
+	}
+}
+
+bool Frustum::set_view_proj(glm::mat4 const & vp_mat){
+	// a point is inside when -w <= x, y, z <= w in clip space; each of the six
+	// inequalities is row 3 of the matrix plus or minus row 0, 1 or 2 (glm is
+	// column-major, row i is vp_mat[0..3][i])
+	for (int plane_idx = 0; plane_idx < FRUSTUM_NUM_PLANES; plane_idx ++) {
+		int row = plane_idx / 2;
+		float sign = plane_idx % 2 == 0 ? 1.0f : -1.0f;
+		float a = vp_mat[0][3] + sign * vp_mat[0][row];
+		float b = vp_mat[1][3] + sign * vp_mat[1][row];
+		float c = vp_mat[2][3] + sign * vp_mat[2][row];
+		float d = vp_mat[3][3] + sign * vp_mat[3][row];
+		// unit normals make the plane value a distance to compare radii against
+		float len = sqrtf(a * a + b * b + c * c);
+		float inv_len = len > 0.0f ? 1.0f / len : 0.0f;
+		plane_a[plane_idx] = a * inv_len;
+		plane_b[plane_idx] = b * inv_len;
+		plane_c[plane_idx] = c * inv_len;
+		plane_d[plane_idx] = d * inv_len;
+	}
+	return true;
+}
+
+bool Frustum::is_sphere_visible(float x, float y, float z, float r) const{
+	for (int plane_idx = 0; plane_idx < FRUSTUM_NUM_PLANES; plane_idx ++) {
+		if (plane_a[plane_idx] * x + plane_b[plane_idx] * y + plane_c[plane_idx] * z + plane_d[plane_idx] < -r) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool cull_stats_print(FILE * file, char const * const * name_vec, CullStats_s const * stats_vec, int num_categories){
+	fprintf(file, "drawn / tested:");
+	for (int category = 0; category < num_categories; category ++) {
+		CullStats_s const & stats = stats_vec[category];
+		double culled_pct = stats.num_tested > 0 ? 100.0 * (stats.num_tested - stats.num_visible) / stats.num_tested : 0.0;
+		fprintf(file, " %s %llu / %llu (%.0f%% culled)%s", name_vec[category], stats.num_visible, stats.num_tested, culled_pct,
+			category + 1 < num_categories ? "," : "\n");
+	}
+	return true;
+}
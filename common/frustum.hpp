@@ -0,0 +1,94 @@
+#ifndef FRUSTUM_HPP
+#define FRUSTUM_HPP
+
+#include <stdio.h>
+#include <vector>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#include <glm/glm.hpp>
+
+// Spheres a cull call was given and kept, summed over calls until reset
+typedef struct CullStats_s {
+	unsigned long long num_tested;                  // live spheres only
+	unsigned long long num_visible;
+} CullStats_s;
+
+// View frustum as six inward-facing planes, a x + b y + c z + d >= 0 inside,
+// extracted from a view-projection matrix. A sphere is culled only when it is
+// entirely behind one plane, so spheres near a frustum corner may be kept.
+class Frustum {
+	#define FRUSTUM_NUM_PLANES                  (6)
+
+	// one array per coefficient, so a plane is tested against four spheres at once
+	float plane_a[FRUSTUM_NUM_PLANES];
+	float plane_b[FRUSTUM_NUM_PLANES];
+	float plane_c[FRUSTUM_NUM_PLANES];
+	float plane_d[FRUSTUM_NUM_PLANES];
+
+public:
+	Frustum();
+
+	// vp_mat maps world space to OpenGL clip space, e.g. getProjectionMatrix() * getViewMatrix()
+	bool set_view_proj(glm::mat4 const & vp_mat);
+
+	bool is_sphere_visible(float x, float y, float z, float r) const;
+
+	// Appends to visible_idx_vec the index of every live sphere of sphere_vec
+	// that is at least partly inside. SphereT needs x, y, z, scale and is_alive
+	// (e.g. RenderSphere_s); the bounding radius is scale * r_per_scale, with
+	// r_per_scale the radius of the mesh drawn at scale 1.
+	template <typename SphereT>
+	bool cull_spheres(std::vector<SphereT> const & sphere_vec, float r_per_scale, std::vector<int> & visible_idx_vec, CullStats_s * p_stats) const{
+		int num_spheres = static_cast<int>(sphere_vec.size());
+		int num_tested = 0;
+		size_t start_num_visible = visible_idx_vec.size();
+		int idx = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+		__m128 zero = _mm_setzero_ps();
+		__m128 r_per_scale_4 = _mm_set1_ps(r_per_scale);
+		for (; idx + 4 <= num_spheres; idx += 4) {
+			SphereT const * p = &sphere_vec[idx];
+			__m128 x = _mm_setr_ps(p[0].x, p[1].x, p[2].x, p[3].x);
+			__m128 y = _mm_setr_ps(p[0].y, p[1].y, p[2].y, p[3].y);
+			__m128 z = _mm_setr_ps(p[0].z, p[1].z, p[2].z, p[3].z);
+			__m128 neg_r = _mm_sub_ps(zero, _mm_mul_ps(_mm_setr_ps(p[0].scale, p[1].scale, p[2].scale, p[3].scale), r_per_scale_4));
+			__m128 is_inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+			for (int plane_idx = 0; plane_idx < FRUSTUM_NUM_PLANES; plane_idx ++) {
+				__m128 dist = _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane_a[plane_idx]), x), _mm_mul_ps(_mm_set1_ps(plane_b[plane_idx]), y)),
+					_mm_add_ps(_mm_mul_ps(_mm_set1_ps(plane_c[plane_idx]), z), _mm_set1_ps(plane_d[plane_idx])));
+				is_inside = _mm_and_ps(is_inside, _mm_cmpge_ps(dist, neg_r));
+			}
+			unsigned int alive_mask = (p[0].is_alive ? 1u : 0u) | (p[1].is_alive ? 2u : 0u) | (p[2].is_alive ? 4u : 0u) | (p[3].is_alive ? 8u : 0u);
+			unsigned int visible_mask = static_cast<unsigned int>(_mm_movemask_ps(is_inside)) & alive_mask;
+			num_tested += (alive_mask & 1) + ((alive_mask >> 1) & 1) + ((alive_mask >> 2) & 1) + (alive_mask >> 3);
+			for (int i = 0; i < 4; i ++) {
+				if (visible_mask & (1u << i)) {
+					visible_idx_vec.push_back(idx + i);
+				}
+			}
+		}
+#endif
+		for (; idx < num_spheres; idx ++) {
+			SphereT const & s = sphere_vec[idx];
+			if (s.is_alive == false) {
+				continue;
+			}
+			num_tested ++;
+			if (is_sphere_visible(s.x, s.y, s.z, s.scale * r_per_scale)) {
+				visible_idx_vec.push_back(idx);
+			}
+		}
+		if (p_stats != NULL) {
+			p_stats->num_tested += num_tested;
+			p_stats->num_visible += visible_idx_vec.size() - start_num_visible;
+		}
+		return true;
+	}
+};
+
+// One "name drawn / tested (culled %)" entry per category on a single line
+bool cull_stats_print(FILE * file, char const * const * name_vec, CullStats_s const * stats_vec, int num_categories);
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef LOG_HISTOGRAM_HPP
+#define LOG_HISTOGRAM_HPP
+
+#include <algorithm>
+
+// Log-linear histogram of non-negative integer samples, e.g. durations in ns:
+// 8 buckets per power of two, so percentiles are within 12.5% (exact below 8).
+// Not thread-safe, see PhaseHistogram in tanksim/profiler.hpp for a shared one.
+class LogHistogram {
+	#define LOG_HISTOGRAM_SUB_BITS              (3)
+	#define LOG_HISTOGRAM_NUM_BUCKETS           (304)   // up to 2^40, larger samples share the last bucket
+
+	unsigned long long bucket_vec[LOG_HISTOGRAM_NUM_BUCKETS];
+	unsigned long long num_samples;
+	unsigned long long sum;
+	unsigned long long max;
+
+public:
+	LogHistogram(){
+		clear();
+	}
+
+	static int get_bucket_idx(unsigned long long value){
+		int const num_sub = 1 << LOG_HISTOGRAM_SUB_BITS;
+		if (value < static_cast<unsigned long long>(num_sub)) {
+			return static_cast<int>(value);
+		}
+		int exponent = 0;
+#if defined(__GNUC__)
+		exponent = 63 - __builtin_clzll(value);
+#else
+		for (unsigned long long rest = value >> 1; rest != 0; rest >>= 1) {
+			exponent ++;
+		}
+#endif
+		int sub_idx = static_cast<int>(value >> (exponent - LOG_HISTOGRAM_SUB_BITS)) & (num_sub - 1);
+		int bucket_idx = (exponent - LOG_HISTOGRAM_SUB_BITS + 1) * num_sub + sub_idx;
+		return std::min(bucket_idx, LOG_HISTOGRAM_NUM_BUCKETS - 1);
+	}
+
+	// Exclusive upper edge of the bucket
+	static unsigned long long get_bucket_end(int bucket_idx){
+		int const num_sub = 1 << LOG_HISTOGRAM_SUB_BITS;
+		if (bucket_idx < num_sub) {
+			return static_cast<unsigned long long>(bucket_idx + 1);
+		}
+		int exponent = bucket_idx / num_sub + LOG_HISTOGRAM_SUB_BITS - 1;
+		int sub_idx = bucket_idx % num_sub;
+		return static_cast<unsigned long long>(num_sub + sub_idx + 1) << (exponent - LOG_HISTOGRAM_SUB_BITS);
+	}
+
+	bool clear(){
+		std::fill(bucket_vec, bucket_vec + LOG_HISTOGRAM_NUM_BUCKETS, 0ull);
+		num_samples = 0;
+		sum = 0;
+		max = 0;
+		return true;
+	}
+
+	bool add(unsigned long long value){
+		bucket_vec[get_bucket_idx(value)] ++;
+		num_samples ++;
+		sum += value;
+		max = std::max(max, value);
+		return true;
+	}
+
+	unsigned long long get_num_samples() const {
+		return num_samples;
+	}
+
+	double get_mean() const {
+		return num_samples > 0 ? static_cast<double>(sum) / num_samples : 0.0;
+	}
+
+	unsigned long long get_max() const {
+		return max;
+	}
+
+	// Upper edge of the bucket holding the given fraction of samples, capped at the maximum
+	unsigned long long get_percentile(double fraction) const {
+		if (num_samples == 0) {
+			return 0;
+		}
+		unsigned long long rank = std::min(static_cast<unsigned long long>(fraction * num_samples), num_samples - 1);
+		unsigned long long cnt = 0;
+		for (int bucket_idx = 0; bucket_idx < LOG_HISTOGRAM_NUM_BUCKETS; bucket_idx ++) {
+			cnt += bucket_vec[bucket_idx];
+			if (cnt > rank) {
+				return std::min(get_bucket_end(bucket_idx), max);
+			}
+		}
+		return max;
+	}
+};
+
+#endif
@@ -0,0 +1,296 @@
+#include <math.h>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "vboindexer.hpp"
+#include "mesh_simplifier.hpp"
+
+#define MESH_SIMPLIFIER_BORDER_WEIGHT       (10.0)  // keeps open edges from shrinking inwards
+#define MESH_SIMPLIFIER_MIN_NORMAL_DOT      (0.2f)  // a moved triangle must keep facing about the same way
+
+// Sum of weighted squared distances to a set of planes, as the symmetric 4x4
+// matrix of Garland and Heckbert; weight is the summed plane weights
+struct Quadric{
+	double a2, ab, ac, ad, b2, bc, bd, c2, cd, d2;
+	double weight;
+
+	Quadric() : a2(0), ab(0), ac(0), ad(0), b2(0), bc(0), bd(0), c2(0), cd(0), d2(0), weight(0) {}
+
+	void add_plane(glm::vec3 const & n, double d, double w){
+		a2 += w * n.x * n.x; ab += w * n.x * n.y; ac += w * n.x * n.z; ad += w * n.x * d;
+		b2 += w * n.y * n.y; bc += w * n.y * n.z; bd += w * n.y * d;
+		c2 += w * n.z * n.z; cd += w * n.z * d;
+		d2 += w * d * d;
+		weight += w;
+	}
+
+	void add(Quadric const & q){
+		a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+		b2 += q.b2; bc += q.bc; bd += q.bd;
+		c2 += q.c2; cd += q.cd;
+		d2 += q.d2;
+		weight += q.weight;
+	}
+
+	double eval(glm::vec3 const & p) const{
+		double x = p.x, y = p.y, z = p.z;
+		double e = a2 * x * x + 2 * ab * x * y + 2 * ac * x * z + 2 * ad * x
+			+ b2 * y * y + 2 * bc * y * z + 2 * bd * y
+			+ c2 * z * z + 2 * cd * z
+			+ d2;
+		return std::max(e, 0.0);
+	}
+};
+
+struct Collapse{
+	double cost;
+	int from_group;
+	int to_group;
+	bool operator<(Collapse const & that) const{
+		return cost < that.cost;
+	}
+};
+
+struct PositionLess{
+	bool operator()(glm::vec3 const & a, glm::vec3 const & b) const{
+		if (a.x != b.x) return a.x < b.x;
+		if (a.y != b.y) return a.y < b.y;
+		return a.z < b.z;
+	}
+};
+
+static glm::vec3 triangle_normal(glm::vec3 const & p0, glm::vec3 const & p1, glm::vec3 const & p2){
+	return glm::cross(p1 - p0, p2 - p0);
+}
+
+float simplifyMesh(
+	std::vector<unsigned short> const & in_indices,
+	std::vector<PackedVertex> const & in_packed_vertices,
+	size_t target_index_cnt,
+
+	std::vector<unsigned short> & out_indices
+){
+	int num_vertices = static_cast<int>(in_packed_vertices.size());
+
+	// one group per distinct position, collapses act on whole groups
+	std::vector<int> group_of(num_vertices);
+	std::vector<glm::vec3> group_pos;
+	std::map<glm::vec3, int, PositionLess> group_map;
+	for (int v = 0; v < num_vertices; v ++) {
+		glm::vec3 const & p = in_packed_vertices[v].position;
+		std::map<glm::vec3, int, PositionLess>::iterator it = group_map.find(p);
+		if (it == group_map.end()) {
+			it = group_map.insert(std::make_pair(p, static_cast<int>(group_pos.size()))).first;
+			group_pos.push_back(p);
+		}
+		group_of[v] = it->second;
+	}
+	int num_groups = static_cast<int>(group_pos.size());
+
+	// drop triangles that are already degenerate in position
+	std::vector<unsigned short> tri_indices;
+	for (size_t i = 0; i + 2 < in_indices.size(); i += 3) {
+		int g0 = group_of[in_indices[i]], g1 = group_of[in_indices[i + 1]], g2 = group_of[in_indices[i + 2]];
+		if (g0 != g1 && g1 != g2 && g0 != g2) {
+			tri_indices.insert(tri_indices.end(), in_indices.begin() + i, in_indices.begin() + i + 3);
+		}
+	}
+
+	// plane of every triangle, area weighted, and of every open edge, at right angles to its triangle
+	std::vector<Quadric> group_quadric(num_groups);
+	std::map<std::pair<int, int>, int> edge_cnt_map;
+	for (size_t i = 0; i < tri_indices.size(); i += 3) {
+		for (int k = 0; k < 3; k ++) {
+			int ga = group_of[tri_indices[i + k]], gb = group_of[tri_indices[i + (k + 1) % 3]];
+			edge_cnt_map[std::make_pair(std::min(ga, gb), std::max(ga, gb))] ++;
+		}
+	}
+	for (size_t i = 0; i < tri_indices.size(); i += 3) {
+		int g[3] = {group_of[tri_indices[i]], group_of[tri_indices[i + 1]], group_of[tri_indices[i + 2]]};
+		glm::vec3 n = triangle_normal(group_pos[g[0]], group_pos[g[1]], group_pos[g[2]]);
+		float area2 = glm::length(n);
+		if (area2 == 0.0f) {
+			continue;
+		}
+		n = n / area2;
+		for (int k = 0; k < 3; k ++) {
+			group_quadric[g[k]].add_plane(n, -glm::dot(n, group_pos[g[k]]), area2 * 0.5);
+		}
+		for (int k = 0; k < 3; k ++) {
+			int ga = g[k], gb = g[(k + 1) % 3];
+			if (edge_cnt_map[std::make_pair(std::min(ga, gb), std::max(ga, gb))] != 1) {
+				continue;
+			}
+			glm::vec3 edge = group_pos[gb] - group_pos[ga];
+			double edge_len = glm::length(edge);
+			if (edge_len == 0.0) {
+				continue;
+			}
+			glm::vec3 edge_n = glm::normalize(glm::cross(edge, n));
+			double d = -glm::dot(edge_n, group_pos[ga]);
+			double w = MESH_SIMPLIFIER_BORDER_WEIGHT * edge_len * edge_len;
+			group_quadric[ga].add_plane(edge_n, d, w);
+			group_quadric[gb].add_plane(edge_n, d, w);
+		}
+	}
+
+	std::vector<int> vertex_remap(num_vertices);
+	std::vector<int> group_tri_start(num_groups + 1);
+	std::vector<int> group_tri_vec;
+	std::vector<char> is_group_locked(num_groups);
+	std::vector<Collapse> collapse_vec;
+	std::vector<int> move_from_vec;
+	std::vector<int> move_to_vec;
+	double max_error_sq = 0.0;
+	bool is_cost_limited = true;
+
+	while (tri_indices.size() > target_index_cnt) {
+		size_t num_tris = tri_indices.size() / 3;
+
+		// triangles around every group, as offsets into group_tri_vec
+		std::fill(group_tri_start.begin(), group_tri_start.end(), 0);
+		for (size_t i = 0; i < tri_indices.size(); i ++) {
+			group_tri_start[group_of[tri_indices[i]] + 1] ++;
+		}
+		for (int g = 0; g < num_groups; g ++) {
+			group_tri_start[g + 1] += group_tri_start[g];
+		}
+		group_tri_vec.resize(tri_indices.size());
+		std::vector<int> fill_pos(group_tri_start.begin(), group_tri_start.end() - 1);
+		for (size_t i = 0; i < tri_indices.size(); i ++) {
+			group_tri_vec[fill_pos[group_of[tri_indices[i]]] ++] = static_cast<int>(i / 3);
+		}
+
+		// both directions of every edge, cheapest first
+		collapse_vec.clear();
+		for (size_t i = 0; i < tri_indices.size(); i += 3) {
+			for (int k = 0; k < 3; k ++) {
+				int ga = group_of[tri_indices[i + k]], gb = group_of[tri_indices[i + (k + 1) % 3]];
+				Quadric q = group_quadric[ga];
+				q.add(group_quadric[gb]);
+				Collapse collapse;
+				collapse.from_group = ga;
+				collapse.to_group = gb;
+				collapse.cost = q.eval(group_pos[gb]);
+				collapse_vec.push_back(collapse);
+				collapse.from_group = gb;
+				collapse.to_group = ga;
+				collapse.cost = q.eval(group_pos[ga]);
+				collapse_vec.push_back(collapse);
+			}
+		}
+		std::sort(collapse_vec.begin(), collapse_vec.end());
+		// a collapse removes about two triangles and every edge is listed about
+		// four times; leave collapses dearer than that many for later passes,
+		// where cheaper ones locked in this pass may have opened up
+		size_t num_collapses_needed = (num_tris * 3 - target_index_cnt) / 6 + 1;
+		double max_cost = is_cost_limited ? collapse_vec[std::min(collapse_vec.size(), num_collapses_needed * 4) - 1].cost : HUGE_VAL;
+
+		// take collapses greedily; the neighborhood of a taken one is locked
+		// until the next pass, so every test below sees current positions
+		for (int v = 0; v < num_vertices; v ++) {
+			vertex_remap[v] = v;
+		}
+		std::fill(is_group_locked.begin(), is_group_locked.end(), 0);
+		size_t num_removed_tris = 0;
+		int num_collapses = 0;
+		for (size_t collapse_idx = 0; collapse_idx < collapse_vec.size(); collapse_idx ++) {
+			if ((num_tris - num_removed_tris) * 3 <= target_index_cnt) {
+				break;
+			}
+			Collapse const & collapse = collapse_vec[collapse_idx];
+			if (collapse.cost > max_cost) {
+				break;
+			}
+			int ga = collapse.from_group, gb = collapse.to_group;
+			if (is_group_locked[ga] || is_group_locked[gb]) {
+				continue;
+			}
+
+			// every vertex of ga needs an edge to a vertex of gb to move onto,
+			// and no triangle kept may flip
+			move_from_vec.clear();
+			move_to_vec.clear();
+			bool is_valid = true;
+			size_t num_collapsed_tris = 0;
+			for (int t = group_tri_start[ga]; t < group_tri_start[ga + 1] && is_valid; t ++) {
+				unsigned short const * tri = &tri_indices[group_tri_vec[t] * 3];
+				int corner = group_of[tri[0]] == ga ? 0 : (group_of[tri[1]] == ga ? 1 : 2);
+				int from_v = tri[corner];
+				int to_v = -1;
+				for (int k = 0; k < 3; k ++) {
+					if (group_of[tri[k]] == gb) {
+						to_v = tri[k];
+					}
+				}
+				if (to_v >= 0) {
+					num_collapsed_tris ++;
+				}
+				else {
+					glm::vec3 p[3] = {group_pos[group_of[tri[0]]], group_pos[group_of[tri[1]]], group_pos[group_of[tri[2]]]};
+					glm::vec3 n_before = triangle_normal(p[0], p[1], p[2]);
+					p[corner] = group_pos[gb];
+					glm::vec3 n_after = triangle_normal(p[0], p[1], p[2]);
+					if (glm::dot(n_before, n_after) < MESH_SIMPLIFIER_MIN_NORMAL_DOT * glm::length(n_before) * glm::length(n_after)) {
+						is_valid = false;
+					}
+				}
+				std::vector<int>::iterator it = std::find(move_from_vec.begin(), move_from_vec.end(), from_v);
+				if (it == move_from_vec.end()) {
+					move_from_vec.push_back(from_v);
+					move_to_vec.push_back(to_v);
+				}
+				else if (move_to_vec[it - move_from_vec.begin()] < 0) {
+					move_to_vec[it - move_from_vec.begin()] = to_v;
+				}
+			}
+			if (is_valid == false || num_collapsed_tris == 0 ||
+				std::find(move_to_vec.begin(), move_to_vec.end(), -1) != move_to_vec.end()) {
+				continue;
+			}
+
+			for (size_t move_idx = 0; move_idx < move_from_vec.size(); move_idx ++) {
+				vertex_remap[move_from_vec[move_idx]] = move_to_vec[move_idx];
+			}
+			group_quadric[gb].add(group_quadric[ga]);
+			for (int t = group_tri_start[ga]; t < group_tri_start[ga + 1]; t ++) {
+				unsigned short const * tri = &tri_indices[group_tri_vec[t] * 3];
+				for (int k = 0; k < 3; k ++) {
+					is_group_locked[group_of[tri[k]]] = 1;
+				}
+			}
+			num_removed_tris += num_collapsed_tris;
+			max_error_sq = std::max(max_error_sq, collapse.cost / std::max(group_quadric[gb].weight, 1e-12));
+			num_collapses ++;
+		}
+		if (num_collapses == 0) {
+			// the cheap ones are all blocked, try the rest once before giving up
+			if (is_cost_limited == false) {
+				break;
+			}
+			is_cost_limited = false;
+			continue;
+		}
+		is_cost_limited = true;
+
+		// apply the moves and drop the triangles that lost an edge
+		size_t write_pos = 0;
+		for (size_t i = 0; i < tri_indices.size(); i += 3) {
+			int v0 = vertex_remap[tri_indices[i]], v1 = vertex_remap[tri_indices[i + 1]], v2 = vertex_remap[tri_indices[i + 2]];
+			int g0 = group_of[v0], g1 = group_of[v1], g2 = group_of[v2];
+			if (g0 == g1 || g1 == g2 || g0 == g2) {
+				continue;
+			}
+			tri_indices[write_pos ++] = static_cast<unsigned short>(v0);
+			tri_indices[write_pos ++] = static_cast<unsigned short>(v1);
+			tri_indices[write_pos ++] = static_cast<unsigned short>(v2);
+		}
+		tri_indices.resize(write_pos);
+	}
+
+	out_indices.swap(tri_indices);
+	return static_cast<float>(sqrt(max_error_sq));
+}
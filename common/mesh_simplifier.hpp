@@ -0,0 +1,22 @@
+#ifndef MESH_SIMPLIFIER_HPP
+#define MESH_SIMPLIFIER_HPP
+
+// Quadric error metric simplification (Garland and Heckbert) of an indexed mesh
+// from indexVBO_interleaved, for levels of detail. Every collapse moves one
+// position onto a neighboring one, so the output only indexes in_packed_vertices
+// and all levels can share the mesh's vertex buffer. Vertices at one position
+// (split by a UV or normal seam) move together, each onto a vertex it shares an
+// edge with, which keeps seams closed; collapses that would flip a triangle
+// are skipped. Stops at target_index_cnt indices or earlier once no collapse
+// is left. Returns the error of the worst collapse taken, the area-weighted
+// RMS distance of the moved position to the original triangles around it,
+// in model units.
+float simplifyMesh(
+	std::vector<unsigned short> const & in_indices,
+	std::vector<PackedVertex> const & in_packed_vertices,
+	size_t target_index_cnt,
+
+	std::vector<unsigned short> & out_indices
+);
+
+#endif
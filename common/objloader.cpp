@@ -6,6 +6,7 @@
 #include <glm/glm.hpp>
 
 #include "objloader.hpp"
+#include "trace_recorder.hpp"
 
 // Very, VERY simple OBJ loader.
 // Here is a short list of features a real function would provide : 
@@ -23,6 +24,7 @@ bool loadOBJ(
 	std::vector<glm::vec2> & out_uvs,
 	std::vector<glm::vec3> & out_normals
 ){
+	TRACE_ZONE("loadOBJ");
 	printf("Loading OBJ file %s...\n", path);
 
 	std::vector<unsigned int> vertexIndices, uvIndices, normalIndices;
@@ -125,6 +127,7 @@ bool loadAssImp(
 	std::vector<glm::vec2> & uvs,
 	std::vector<glm::vec3> & normals
 ){
+	TRACE_ZONE("loadAssImp");
 
 	Assimp::Importer importer;
 
@@ -13,8 +13,10 @@ using namespace std;
 #include <GL/glew.h>
 
 #include "shader.hpp"
+#include "trace_recorder.hpp"
 
 GLuint LoadShaders(const char * vertex_file_path,const char * fragment_file_path){
+	TRACE_ZONE("LoadShaders");
 
 	// Create the shaders
 	GLuint VertexShaderID = glCreateShader(GL_VERTEX_SHADER);
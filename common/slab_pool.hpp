@@ -0,0 +1,127 @@
+#ifndef SLAB_POOL_HPP
+#define SLAB_POOL_HPP
+
+#include <cstddef>
+#include <vector>
+
+// Handle to an entry of a SlabPool. It goes stale as soon as the entry is freed:
+// the slot's generation is bumped, so an old handle can never reach a new entry.
+typedef struct SlabHandle_s {
+	unsigned int slot_idx;
+	unsigned int generation;
+} SlabHandle_s;
+
+// Fixed-capacity pool with O(1) alloc and free.
+// Live entries are kept packed in [0, size()) for dense iteration; free swaps the
+// last live entry into the hole, so iteration order is not insertion order.
+// All storage is allocated once in init().
+template <typename T>
+class SlabPool {
+	std::vector<T> dense_vec;
+	std::vector<unsigned int> dense_to_slot_vec;
+	std::vector<unsigned int> slot_to_dense_vec;
+	std::vector<unsigned int> slot_generation_vec;
+	std::vector<unsigned int> free_slot_vec;
+
+	int num_live;
+	int high_water_mark;
+	unsigned long num_alloc_failed;
+
+public:
+	SlabPool() : num_live(0), high_water_mark(0), num_alloc_failed(0) {}
+
+	bool init(int capacity){
+		dense_vec.assign(capacity, T());
+		dense_to_slot_vec.assign(capacity, 0u);
+		slot_to_dense_vec.assign(capacity, 0u);
+		// generation 0 is never handed out, so a zeroed handle is always invalid
+		slot_generation_vec.assign(capacity, 1u);
+		free_slot_vec.resize(capacity);
+		for (int i = 0; i < capacity; i++) {
+			// pop_back hands out slot 0 first
+			free_slot_vec[i] = capacity - 1 - i;
+		}
+		num_live = 0;
+		high_water_mark = 0;
+		num_alloc_failed = 0;
+		return true;
+	}
+
+	bool alloc(T const & value, SlabHandle_s * p_handle = NULL){
+		if (free_slot_vec.empty()) {
+			num_alloc_failed++;
+			return false;
+		}
+		unsigned int slot_idx = free_slot_vec.back();
+		free_slot_vec.pop_back();
+
+		dense_vec[num_live] = value;
+		dense_to_slot_vec[num_live] = slot_idx;
+		slot_to_dense_vec[slot_idx] = num_live;
+		num_live++;
+		if (num_live > high_water_mark) {
+			high_water_mark = num_live;
+		}
+
+		if (p_handle != NULL) {
+			p_handle->slot_idx = slot_idx;
+			p_handle->generation = slot_generation_vec[slot_idx];
+		}
+		return true;
+	}
+
+	// Frees the live entry at dense position dense_idx; the former last entry takes its place
+	bool free_at(int dense_idx){
+		if (dense_idx < 0 || dense_idx >= num_live) {
+			return false;
+		}
+		unsigned int slot_idx = dense_to_slot_vec[dense_idx];
+		int last_idx = num_live - 1;
+		if (dense_idx != last_idx) {
+			dense_vec[dense_idx] = dense_vec[last_idx];
+			dense_to_slot_vec[dense_idx] = dense_to_slot_vec[last_idx];
+			slot_to_dense_vec[dense_to_slot_vec[dense_idx]] = dense_idx;
+		}
+		num_live--;
+		slot_generation_vec[slot_idx]++;
+		if (slot_generation_vec[slot_idx] == 0u) {
+			slot_generation_vec[slot_idx] = 1u;
+		}
+		free_slot_vec.push_back(slot_idx);
+		return true;
+	}
+
+	bool free(SlabHandle_s handle){
+		T * p_value = get(handle);
+		if (p_value == NULL) {
+			return false;
+		}
+		return free_at(static_cast<int>(p_value - &dense_vec[0]));
+	}
+
+	// NULL if the handle is stale
+	T * get(SlabHandle_s handle){
+		if (handle.slot_idx >= slot_generation_vec.size() || slot_generation_vec[handle.slot_idx] != handle.generation) {
+			return NULL;
+		}
+		unsigned int dense_idx = slot_to_dense_vec[handle.slot_idx];
+		if (dense_idx >= static_cast<unsigned int>(num_live) || dense_to_slot_vec[dense_idx] != handle.slot_idx) {
+			return NULL;
+		}
+		return &dense_vec[dense_idx];
+	}
+
+	// Dense access to live entries
+	int size() const { return num_live; }
+	T & operator[](int dense_idx){ return dense_vec[dense_idx]; }
+	T const & operator[](int dense_idx) const { return dense_vec[dense_idx]; }
+	T * data(){ return dense_vec.empty() ? NULL : &dense_vec[0]; }
+	T const * data() const { return dense_vec.empty() ? NULL : &dense_vec[0]; }
+
+	int get_capacity() const { return static_cast<int>(dense_vec.size()); }
+	bool get_is_full() const { return free_slot_vec.empty(); }
+	int get_high_water_mark() const { return high_water_mark; }
+	unsigned long get_num_alloc_failed() const { return num_alloc_failed; }
+};
+
+#endif
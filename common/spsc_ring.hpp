@@ -0,0 +1,68 @@
+#ifndef SPSC_RING_HPP
+#define SPSC_RING_HPP
+
+#include <atomic>
+#include <vector>
+
+// Bounded lock-free single-producer / single-consumer ring.
+// One thread calls push(), one other thread calls pop(); neither ever blocks.
+// init() must run before either side starts.
+template <typename T>
+class SpscRing {
+	#define SPSC_RING_CACHE_LINE_SIZE   (64)
+
+	std::vector<T> buf;
+	unsigned int mask;
+	// next slot to read, written by the consumer only
+	std::atomic<unsigned int> head;
+	char pad[SPSC_RING_CACHE_LINE_SIZE];
+	// next slot to write, written by the producer only
+	std::atomic<unsigned int> tail;
+
+	SpscRing(SpscRing const &);
+	SpscRing & operator=(SpscRing const &);
+
+public:
+	SpscRing() : mask(0u), head(0u), tail(0u) {}
+
+	// capacity is rounded up to a power of two
+	bool init(int capacity){
+		unsigned int size = 1u;
+		while (size < static_cast<unsigned int>(capacity)) {
+			size <<= 1;
+		}
+		buf.assign(size, T());
+		mask = size - 1u;
+		head.store(0u, std::memory_order_relaxed);
+		tail.store(0u, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Producer side, false if the ring is full
+	bool push(T const & value){
+		unsigned int curr_tail = tail.load(std::memory_order_relaxed);
+		if (curr_tail - head.load(std::memory_order_acquire) > mask) {
+			return false;
+		}
+		buf[curr_tail & mask] = value;
+		tail.store(curr_tail + 1u, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer side, false if the ring is empty
+	bool pop(T & value){
+		unsigned int curr_head = head.load(std::memory_order_relaxed);
+		if (curr_head == tail.load(std::memory_order_acquire)) {
+			return false;
+		}
+		value = buf[curr_head & mask];
+		head.store(curr_head + 1u, std::memory_order_release);
+		return true;
+	}
+
+	int get_capacity() const {
+		return static_cast<int>(buf.size());
+	}
+};
+
+#endif
@@ -6,8 +6,11 @@
 
 #include <GLFW/glfw3.h>
 
+#include "trace_recorder.hpp"
+
 
 GLuint loadBMP_custom(const char * imagepath){
+	TRACE_ZONE("loadBMP_custom");
 
 	printf("Reading image %s\n", imagepath);
 
@@ -125,6 +128,7 @@ GLuint loadBMP_custom(const char * imagepath){
 #define FOURCC_DXT5 0x35545844 // Equivalent to "DXT5" in ASCII
 
 GLuint loadDDS(const char * imagepath){
+	TRACE_ZONE("loadDDS");
 
 	unsigned char header[124];
 
@@ -0,0 +1,287 @@
+#ifndef TRACE_RECORDER_HPP
+#define TRACE_RECORDER_HPP
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+// Trace event recorder: named zones from any thread, written as a Chrome
+// trace JSON that chrome://tracing and ui.perfetto.dev load.
+// Off until trace_start; then a zone costs two time stamp counter reads and
+// one store into the buffer of its thread, and while off a single relaxed load.
+// The counter is converted to ns by trace_write, from the steady_clock time
+// elapsed between trace_start and trace_write (invariant TSC assumed); on
+// other CPUs zones read steady_clock instead.
+// A thread buffer is a chain of fixed-size chunks that only its thread
+// appends to; every chunk publishes its event count with a release store, so
+// trace_write may run while other threads still record and sees a prefix.
+// Zone and thread names are stored as pointers and must outlive trace_write,
+// string literals in practice.
+// Header-only so every target compiling the common loaders gets it for free.
+
+typedef struct TraceEvent_s {
+	char const * name;
+	unsigned long long start;
+	unsigned long long dur;
+	int is_ns;                                      // start and dur in steady_clock ns, not ticks
+} TraceEvent_s;
+
+class TraceThreadBuffer {
+	#define TRACE_CHUNK_SIZE                    (4096)
+	#define TRACE_MAX_CHUNKS                    (512)   // per thread, 2M events / 64 MB
+
+	typedef struct Chunk_s {
+		TraceEvent_s event_vec[TRACE_CHUNK_SIZE];
+		std::atomic<int> num_events;
+		std::atomic<Chunk_s *> p_next;
+	} Chunk_s;
+
+	std::atomic<Chunk_s *> p_head;                  // NULL until the first event
+	Chunk_s * p_tail;                               // owner thread only
+	int num_chunks;                                 // owner thread only
+	std::atomic<unsigned long> num_dropped;
+	std::atomic<char const *> thread_name;
+	int tid;
+
+	TraceThreadBuffer(TraceThreadBuffer const &);
+	TraceThreadBuffer & operator=(TraceThreadBuffer const &);
+
+	static Chunk_s * new_chunk(){
+		Chunk_s * p_chunk = new Chunk_s;
+		p_chunk->num_events.store(0, std::memory_order_relaxed);
+		p_chunk->p_next.store(NULL, std::memory_order_relaxed);
+		return p_chunk;
+	}
+
+public:
+	explicit TraceThreadBuffer(int tid) : p_head(NULL), p_tail(NULL), num_chunks(0), num_dropped(0), thread_name(NULL), tid(tid) {}
+
+	int get_tid() const {
+		return tid;
+	}
+
+	char const * get_thread_name() const {
+		return thread_name.load(std::memory_order_relaxed);
+	}
+
+	bool set_thread_name(char const * name){
+		thread_name.store(name, std::memory_order_relaxed);
+		return true;
+	}
+
+	unsigned long get_num_dropped() const {
+		return num_dropped.load(std::memory_order_relaxed);
+	}
+
+	// Owner thread only; drops the event once the thread has TRACE_MAX_CHUNKS full
+	bool add(char const * name, unsigned long long start, unsigned long long dur, int is_ns){
+		int num_events = p_tail != NULL ? p_tail->num_events.load(std::memory_order_relaxed) : TRACE_CHUNK_SIZE;
+		if (num_events == TRACE_CHUNK_SIZE) {
+			if (num_chunks == TRACE_MAX_CHUNKS) {
+				num_dropped.store(num_dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+				return false;
+			}
+			Chunk_s * p_chunk = new_chunk();
+			(p_tail != NULL ? p_tail->p_next : p_head).store(p_chunk, std::memory_order_release);
+			p_tail = p_chunk;
+			num_chunks ++;
+			num_events = 0;
+		}
+		TraceEvent_s & event = p_tail->event_vec[num_events];
+		event.name = name;
+		event.start = start;
+		event.dur = dur;
+		event.is_ns = is_ns;
+		p_tail->num_events.store(num_events + 1, std::memory_order_release);
+		return true;
+	}
+
+	// Any thread; calls fn(event) for every event published so far, in order
+	template <typename F>
+	bool for_each(F fn) const {
+		for (Chunk_s const * p_chunk = p_head.load(std::memory_order_acquire); p_chunk != NULL; p_chunk = p_chunk->p_next.load(std::memory_order_acquire)) {
+			int num_events = p_chunk->num_events.load(std::memory_order_acquire);
+			for (int event_idx = 0; event_idx < num_events; event_idx ++) {
+				fn(p_chunk->event_vec[event_idx]);
+			}
+		}
+		return true;
+	}
+};
+
+typedef struct TraceState_s {
+	std::mutex mutex;
+	std::vector<TraceThreadBuffer *> buffer_vec;    // never freed, threads may exit before trace_write
+	std::string path;
+	unsigned long long start_ns;
+	unsigned long long start_ticks;
+} TraceState_s;
+
+// Constant-initialized, so checking it needs no guard
+inline std::atomic<int> & trace_get_is_enabled_flag(){
+	static std::atomic<int> is_enabled(0);
+	return is_enabled;
+}
+
+inline bool trace_get_is_enabled(){
+	return trace_get_is_enabled_flag().load(std::memory_order_relaxed) != 0;
+}
+
+inline TraceState_s & trace_get_state(){
+	static TraceState_s state;
+	return state;
+}
+
+inline unsigned long long trace_get_ns(){
+	return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+// Zone clock: the time stamp counter where there is one, a few ns to read
+// against tens of ns for steady_clock
+inline unsigned long long trace_get_ticks(){
+#if defined(_MSC_VER) || defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return trace_get_ns();
+#endif
+}
+
+// Buffer of the calling thread, registered on its first use
+inline TraceThreadBuffer & trace_get_thread_buffer(){
+	static thread_local TraceThreadBuffer * p_buffer = NULL;
+	if (p_buffer == NULL) {
+		TraceState_s & state = trace_get_state();
+		std::lock_guard<std::mutex> lock(state.mutex);
+		p_buffer = new TraceThreadBuffer(static_cast<int>(state.buffer_vec.size()) + 1);
+		state.buffer_vec.push_back(p_buffer);
+	}
+	return *p_buffer;
+}
+
+// Names the calling thread in the trace, e.g. "sim"; works while off too
+inline bool trace_set_thread_name(char const * name){
+	return trace_get_thread_buffer().set_thread_name(name);
+}
+
+// Records a zone that ran from start_ns for dur_ns on the calling thread, in
+// trace_get_ns time; for timers that already hold both
+inline bool trace_add_event(char const * name, unsigned long long start_ns, unsigned long long dur_ns){
+	if (trace_get_is_enabled() == false) {
+		return false;
+	}
+	return trace_get_thread_buffer().add(name, start_ns, dur_ns, 1);
+}
+
+// Starts recording for trace_write to path; call before the threads to trace start zones
+inline bool trace_start(char const * path){
+	TraceState_s & state = trace_get_state();
+	{
+		std::lock_guard<std::mutex> lock(state.mutex);
+		state.path = path;
+		state.start_ticks = trace_get_ticks();
+		state.start_ns = trace_get_ns();
+	}
+	trace_get_is_enabled_flag().store(1, std::memory_order_release);
+	return true;
+}
+
+// Stops recording; zones already open still complete
+inline bool trace_stop(){
+	trace_get_is_enabled_flag().store(0, std::memory_order_relaxed);
+	return true;
+}
+
+// Stops recording and writes every thread's events to the trace_start path.
+// Returns false, writing nothing, if recording was never started.
+inline bool trace_write(){
+	TraceState_s & state = trace_get_state();
+	std::lock_guard<std::mutex> lock(state.mutex);
+	if (state.path.empty()) {
+		return false;
+	}
+	trace_stop();
+	unsigned long long end_ticks = trace_get_ticks();
+	unsigned long long end_ns = trace_get_ns();
+	double ns_per_tick = end_ticks > state.start_ticks ? static_cast<double>(end_ns - state.start_ns) / (end_ticks - state.start_ticks) : 1.0;
+
+	FILE * file = fopen(state.path.c_str(), "w");
+	if (file == NULL) {
+		fprintf(stderr, "Failed to open %s\n", state.path.c_str());
+		return false;
+	}
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"tanksim\"}}");
+	unsigned long num_events = 0;
+	unsigned long num_dropped = 0;
+	for (size_t buffer_idx = 0; buffer_idx < state.buffer_vec.size(); buffer_idx ++) {
+		TraceThreadBuffer const & buffer = *state.buffer_vec[buffer_idx];
+		int tid = buffer.get_tid();
+		if (buffer.get_thread_name() != NULL) {
+			fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}", tid, buffer.get_thread_name());
+		}
+		buffer.for_each([&](TraceEvent_s const & event) {
+			// timestamps relative to trace_start, in us; nothing starts before it
+			double ts = 0.0;
+			double dur = 0.0;
+			if (event.is_ns) {
+				ts = (static_cast<double>(event.start) - static_cast<double>(state.start_ns)) * 1e-3;
+				dur = event.dur * 1e-3;
+			}
+			else {
+				ts = (static_cast<double>(event.start) - static_cast<double>(state.start_ticks)) * ns_per_tick * 1e-3;
+				dur = event.dur * ns_per_tick * 1e-3;
+			}
+			fprintf(file, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", event.name, tid, ts, dur);
+			num_events ++;
+		});
+		num_dropped += buffer.get_num_dropped();
+	}
+	fprintf(file, "\n]}\n");
+	fclose(file);
+	printf("trace: %lu events written to %s", num_events, state.path.c_str());
+	if (num_dropped > 0) {
+		printf(", %lu dropped", num_dropped);
+	}
+	printf("\n");
+	return true;
+}
+
+// Times the rest of the enclosing block, or up to end()
+class TraceZone {
+	char const * name;
+	unsigned long long start_ticks;                 // 0 when not recording
+
+	TraceZone(TraceZone const &);
+	TraceZone & operator=(TraceZone const &);
+
+public:
+	explicit TraceZone(char const * name) : name(name), start_ticks(trace_get_is_enabled() ? trace_get_ticks() : 0ull) {}
+
+	~TraceZone(){
+		end();
+	}
+
+	bool end(){
+		if (start_ticks == 0) {
+			return false;
+		}
+		trace_get_thread_buffer().add(name, start_ticks, trace_get_ticks() - start_ticks, 0);
+		start_ticks = 0;
+		return true;
+	}
+};
+
+#define TRACE_CONCAT_IMPL(a, b)             a##b
+#define TRACE_CONCAT(a, b)                  TRACE_CONCAT_IMPL(a, b)
+#define TRACE_ZONE(name)                    TraceZone TRACE_CONCAT(trace_zone_, __LINE__)(name)
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef TRIPLE_BUFFER_HPP
+#define TRIPLE_BUFFER_HPP
+
+#include <atomic>
+
+// Wait-free single-producer / single-consumer triple buffer.
+// The producer fills get_back() and calls publish(); the consumer calls fetch()
+// and reads get_front(). The two sides never touch the same slot, and neither
+// ever blocks: publish() and fetch() are a single atomic exchange each.
+template <typename T>
+class TripleBuffer {
+	#define TRIPLE_BUFFER_IDX_MASK      (0x3u)
+	#define TRIPLE_BUFFER_DIRTY_BIT     (0x4u)
+
+	T buf[3];
+	// index of the slot in the middle, plus a dirty bit when it holds a frame the consumer has not seen
+	std::atomic<unsigned int> middle_state;
+	unsigned int back_idx;  // owned by the producer
+	unsigned int front_idx; // owned by the consumer
+
+	TripleBuffer(TripleBuffer const &);
+	TripleBuffer & operator=(TripleBuffer const &);
+
+public:
+	TripleBuffer() : middle_state(1u), back_idx(0u), front_idx(2u) {}
+
+	// Producer side
+	T & get_back(){
+		return buf[back_idx];
+	}
+
+	void publish(){
+		unsigned int prev_state = middle_state.exchange(back_idx | TRIPLE_BUFFER_DIRTY_BIT, std::memory_order_acq_rel);
+		back_idx = prev_state & TRIPLE_BUFFER_IDX_MASK;
+	}
+
+	// Consumer side. Returns true if a newer frame became the front one.
+	bool fetch(){
+		if ((middle_state.load(std::memory_order_relaxed) & TRIPLE_BUFFER_DIRTY_BIT) == 0) {
+			return false;
+		}
+		unsigned int prev_state = middle_state.exchange(front_idx, std::memory_order_acq_rel);
+		front_idx = prev_state & TRIPLE_BUFFER_IDX_MASK;
+		return true;
+	}
+
+	T const & get_front() const {
+		return buf[front_idx];
+	}
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <glm/glm.hpp>
 
 #include "vboindexer.hpp"
+#include "trace_recorder.hpp"
 
 #include <string.h> // for memcmp
 
@@ -74,14 +75,9 @@ void indexVBO_slow(
 	}
 }
 
-struct PackedVertex{
-	glm::vec3 position;
-	glm::vec2 uv;
-	glm::vec3 normal;
-	bool operator<(const PackedVertex that) const{
-		return memcmp((void*)this, (void*)&that, sizeof(PackedVertex))>0;
-	};
-};
+bool PackedVertex::operator<(const PackedVertex that) const{
+	return memcmp((void*)this, (void*)&that, sizeof(PackedVertex))>0;
+}
 
 bool getSimilarVertexIndex_fast( 
 	PackedVertex & packed, 
@@ -107,6 +103,7 @@ void indexVBO(
 	std::vector<glm::vec2> & out_uvs,
 	std::vector<glm::vec3> & out_normals
 ){
+	TRACE_ZONE("indexVBO");
 	std::map<PackedVertex,unsigned short> VertexToOutIndex;
 
 	// For each input vertex
@@ -132,6 +129,37 @@ void indexVBO(
 	}
 }
 
+void indexVBO_interleaved(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	std::vector<unsigned short> & out_indices,
+	std::vector<PackedVertex> & out_packed_vertices
+){
+	TRACE_ZONE("indexVBO_interleaved");
+	std::map<PackedVertex,unsigned short> VertexToOutIndex;
+
+	// For each input vertex
+	for ( unsigned int i=0; i<in_vertices.size(); i++ ){
+
+		PackedVertex packed = {in_vertices[i], in_uvs[i], in_normals[i]};
+
+		// Try to find a similar vertex in out_packed_vertices
+		unsigned short index;
+		bool found = getSimilarVertexIndex_fast( packed, VertexToOutIndex, index);
+
+		if ( found ){ // A similar vertex is already in the VBO, use it instead !
+			out_indices.push_back( index );
+		}else{ // If not, it needs to be added in the output data.
+			out_packed_vertices.push_back( packed );
+			unsigned short newindex = (unsigned short)out_packed_vertices.size() - 1;
+			out_indices .push_back( newindex );
+			VertexToOutIndex[ packed ] = newindex;
+		}
+	}
+}
+
 
 
 
@@ -1,6 +1,27 @@
 #ifndef VBOINDEXER_HPP
 #define VBOINDEXER_HPP
 
+// One vertex of an interleaved stream: position, UV and normal back to back,
+// 32 bytes without padding, so attribute offsets are offsetof(PackedVertex, x)
+struct PackedVertex{
+	glm::vec3 position;
+	glm::vec2 uv;
+	glm::vec3 normal;
+	bool operator<(const PackedVertex that) const;
+};
+
+// Reference O(n^2) version of indexVBO, kept for comparison
+void indexVBO_slow(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	std::vector<unsigned short> & out_indices,
+	std::vector<glm::vec3> & out_vertices,
+	std::vector<glm::vec2> & out_uvs,
+	std::vector<glm::vec3> & out_normals
+);
+
 void indexVBO(
 	std::vector<glm::vec3> & in_vertices,
 	std::vector<glm::vec2> & in_uvs,
@@ -12,6 +33,15 @@ void indexVBO(
 	std::vector<glm::vec3> & out_normals
 );
 
+// Same as indexVBO, but writes a single interleaved stream for one vertex buffer per mesh
+void indexVBO_interleaved(
+	std::vector<glm::vec3> & in_vertices,
+	std::vector<glm::vec2> & in_uvs,
+	std::vector<glm::vec3> & in_normals,
+
+	std::vector<unsigned short> & out_indices,
+	std::vector<PackedVertex> & out_packed_vertices
+);
 
 void indexVBO_TBN(
 	std::vector<glm::vec3> & in_vertices,
@@ -0,0 +1,120 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "trace_recorder.hpp"
+
+// Fixed set of worker threads for fork-join loops.
+// run() hands out task indices [0, num_tasks) to the workers and the calling
+// thread, and returns once every task has finished. Tasks must not call run().
+class WorkerPool {
+	std::vector<std::thread> thread_vec;
+	std::mutex mutex;
+	std::condition_variable start_cv;
+	std::condition_variable done_cv;
+
+	std::function<void(int)> const * p_task;
+	int num_tasks;
+	std::atomic<int> next_task_idx;
+	int num_active;
+	unsigned long generation;
+	bool is_stopping;
+
+	WorkerPool(WorkerPool const &);
+	WorkerPool & operator=(WorkerPool const &);
+
+	void run_tasks(){
+		int task_idx = next_task_idx.fetch_add(1, std::memory_order_relaxed);
+		while (task_idx < num_tasks) {
+			(*p_task)(task_idx);
+			task_idx = next_task_idx.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+	void worker_main(){
+		trace_set_thread_name("worker");
+		unsigned long seen_generation = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				start_cv.wait(lock, [&]{ return is_stopping || generation != seen_generation; });
+				if (is_stopping) {
+					return;
+				}
+				seen_generation = generation;
+			}
+			run_tasks();
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				num_active--;
+				if (num_active == 0) {
+					done_cv.notify_all();
+				}
+			}
+		}
+	}
+
+public:
+	WorkerPool() : p_task(NULL), num_tasks(0), next_task_idx(0), num_active(0), generation(0), is_stopping(false) {}
+
+	~WorkerPool(){
+		stop();
+	}
+
+	// num_threads counts the calling thread, so 1 means no extra threads
+	bool init(int num_threads){
+		stop();
+		is_stopping = false;
+		for (int i = 1; i < num_threads; i++) {
+			thread_vec.push_back(std::thread(&WorkerPool::worker_main, this));
+		}
+		return true;
+	}
+
+	bool stop(){
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			is_stopping = true;
+		}
+		start_cv.notify_all();
+		for (size_t i = 0; i < thread_vec.size(); i++) {
+			thread_vec[i].join();
+		}
+		thread_vec.clear();
+		return true;
+	}
+
+	int get_num_threads() const {
+		return static_cast<int>(thread_vec.size()) + 1;
+	}
+
+	bool run(int num_tasks, std::function<void(int)> const & task){
+		if (thread_vec.empty() || num_tasks <= 1) {
+			for (int task_idx = 0; task_idx < num_tasks; task_idx++) {
+				task(task_idx);
+			}
+			return true;
+		}
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			this->p_task = &task;
+			this->num_tasks = num_tasks;
+			next_task_idx.store(0, std::memory_order_relaxed);
+			num_active = static_cast<int>(thread_vec.size());
+			generation++;
+		}
+		start_cv.notify_all();
+		run_tasks();
+		std::unique_lock<std::mutex> lock(mutex);
+		done_cv.wait(lock, [&]{ return num_active == 0; });
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef XOSHIRO_HPP
+#define XOSHIRO_HPP
+
+// xoshiro128+ (Blackman / Vigna): 128 bits of state, a handful of ALU ops per
+// number and no shared state, so every thread or batch can own a stream.
+// The low bits are weak, next_float() only uses the top 24.
+// Streams with different (seed, stream_idx) pairs are seeded through splitmix64
+// and are independent for any practical purpose.
+class Xoshiro128 {
+	unsigned int s[4];
+
+	static unsigned long long splitmix64(unsigned long long & x){
+		unsigned long long z = (x += 0x9e3779b97f4a7c15ull);
+		z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+		z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+		return z ^ (z >> 31);
+	}
+
+	static unsigned int rotl(unsigned int x, int k){
+		return (x << k) | (x >> (32 - k));
+	}
+
+public:
+	Xoshiro128(){
+		seed(0u, 0u);
+	}
+
+	bool seed(unsigned long long seed_value, unsigned long long stream_idx){
+		unsigned long long x = seed_value ^ (stream_idx * 0xd1342543de82ef95ull);
+		unsigned long long lo = splitmix64(x);
+		unsigned long long hi = splitmix64(x);
+		s[0] = static_cast<unsigned int>(lo);
+		s[1] = static_cast<unsigned int>(lo >> 32);
+		s[2] = static_cast<unsigned int>(hi);
+		s[3] = static_cast<unsigned int>(hi >> 32);
+		// the all-zero state is a fixed point
+		if ((s[0] | s[1] | s[2] | s[3]) == 0u) {
+			s[0] = 1u;
+		}
+		return true;
+	}
+
+	unsigned int next(){
+		unsigned int result = s[0] + s[3];
+		unsigned int t = s[1] << 9;
+		s[2] ^= s[0];
+		s[3] ^= s[1];
+		s[1] ^= s[2];
+		s[0] ^= s[3];
+		s[2] ^= t;
+		s[3] = rotl(s[3], 11);
+		return result;
+	}
+
+	// Uniform in [0, 1)
+	float next_float(){
+		return static_cast<float>(next() >> 8) * (1.0f / 16777216.0f);
+	}
+
+	// Uniform in [lo, hi)
+	float next_float(float lo, float hi){
+		return lo + (hi - lo) * next_float();
+	}
+};
+
+#endif
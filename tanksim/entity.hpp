@@ -0,0 +1,361 @@
+#ifndef TANKSIM_ENTITY_HPP
+#define TANKSIM_ENTITY_HPP
+
+#include "sphere.hpp"
+
+// Compact render-only copy of one entity, written by the sim thread into a RenderSnapshot_s.
+// scale and angle_xy already include the per-type size ratio and rotation offset.
+typedef struct RenderSphere_s {
+    float x;
+    float y;
+    float z;
+    float scale;
+    float angle_xy;
+    float angle_z;
+    int is_hit;
+    int is_alive;
+} RenderSphere_s;
+
+class Obst : public Sphere {
+    #define OBST_DEFAULT_HEALTH                 (10.0f)
+    #define OBST_DEFAULT_TIMER_IS_HIT           (0.1f)
+
+    float health;
+    float timer_is_hit;
+
+    public:
+    Obst(float x, float y, float z, float r) : Sphere(x, y, z, r), health{OBST_DEFAULT_HEALTH}, timer_is_hit{0.0f} {}
+
+    float get_health() const {
+        return this->health;
+    }
+
+    bool get_is_activated() const {
+        return this->health > 0.0f;
+    }
+
+    bool set_is_activated(bool is_activated) {
+        if (is_activated) {
+            this->health = OBST_DEFAULT_HEALTH;
+        }
+        else {
+            this->health = 0.0f;
+        }
+        return true;
+    }
+
+    bool get_is_hit() const {
+        return this->timer_is_hit > 0.0f;
+    }
+
+    bool set_is_hit(bool is_hit) {
+        if (is_hit) {
+            this->timer_is_hit = OBST_DEFAULT_TIMER_IS_HIT;
+        }
+        else {
+            this->timer_is_hit = 0.0f;
+        }
+        return true;
+    }
+
+    bool reduce_health(float amount) {
+        if (this->health > 0.0f) {
+            this->health -= amount;
+            return true;
+        }
+        else {
+            return false;
+        }
+    }
+
+    bool refreash(float time) {
+        if (this->timer_is_hit > 0.0f) {
+            this->timer_is_hit -= time;
+        }
+        return true;
+    }
+
+    glm::mat4 get_model_matrix() const {
+        glm::mat4 scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(this->r, this->r, this->r));
+        glm::mat4 trans_mat = glm::translate(glm::mat4(), glm::vec3(this->x, this->y, this->z));
+        glm::mat4 rotat_mat = glm::rotate( glm::mat4(1.0f), 0.0f, glm::vec3(0, 0, 1) );
+        glm::mat4 model_mat = trans_mat * rotat_mat * scale_mat;
+        return model_mat;
+    }
+
+    bool get_render_sphere(RenderSphere_s & rs) const {
+        rs.x = this->x;
+        rs.y = this->y;
+        rs.z = this->z;
+        rs.scale = this->r;
+        rs.angle_xy = 0.0f;
+        rs.angle_z = 0.0f;
+        rs.is_hit = this->get_is_hit();
+        rs.is_alive = this->get_is_activated();
+        return true;
+    }
+};
+
+class Ammo : public Sphere {
+    bool is_fired;
+    float angle_xy;
+    float angle_z;
+    float move_speed;
+    // unit heading, fixed once fired; the angles above are only kept for rendering
+    float dir_x;
+    float dir_y;
+    float dir_z;
+
+    public:
+    Ammo() : Sphere(0.0f, 0.0f, 0.0f, 0.0f), is_fired{false}, angle_xy{0.0f}, angle_z{0.0f}, move_speed{0.0f}, dir_x{0.0f}, dir_y{0.0f}, dir_z{0.0f} {}
+    Ammo(float x, float y, float z, float r, float angle_xy, float angle_z, float move_speed) : Sphere(x, y, z, r), is_fired{true}, angle_xy{angle_xy}, angle_z{angle_z}, move_speed{move_speed},
+        dir_x{0.0f}, dir_y{0.0f}, dir_z{0.0f} {
+        Sphere::get_direction(angle_xy, angle_z, this->dir_x, this->dir_y, this->dir_z);
+    }
+
+    float get_angle_xy() const {
+        return this->angle_xy;
+    }
+
+    float get_angle_z() const {
+        return this->angle_z;
+    }
+
+    float get_move_speed() const {
+        return this->move_speed;
+    }
+
+    float get_dir_x() const {
+        return this->dir_x;
+    }
+
+    float get_dir_y() const {
+        return this->dir_y;
+    }
+
+    float get_dir_z() const {
+        return this->dir_z;
+    }
+
+    bool advance(float dist) {
+        return this->move(this->dir_x, this->dir_y, this->dir_z, dist);
+    }
+
+    bool get_is_fired() const {
+        return this->is_fired;
+    }
+
+    bool set_is_fired(bool is_fired) {
+        this->is_fired = is_fired;
+        return true;
+    }
+
+    bool refreash(float time) {
+        // do nothing
+        return true;
+    }
+
+    #define AMMO_R_TO_SIZE_RATIO            (3.0f)
+    #define AMMO_ROTATE_OFFS_ANGLE_XY       (MY_PI_HALF * 2.0f)
+    glm::mat4 get_model_matrix() const {
+        glm::mat4 scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(this->r * AMMO_R_TO_SIZE_RATIO, this->r * AMMO_R_TO_SIZE_RATIO, this->r * AMMO_R_TO_SIZE_RATIO));
+        glm::mat4 trans_mat = glm::translate(glm::mat4(), glm::vec3(this->x, this->y, this->z));
+        glm::mat4 rotat_mat = glm::rotate( glm::mat4(1.0f), this->angle_xy + AMMO_ROTATE_OFFS_ANGLE_XY, glm::vec3(0, 0, 1) );
+        rotat_mat = glm::rotate( rotat_mat, this->angle_z, glm::vec3(0, 1, 0) );
+        glm::mat4 model_mat = trans_mat * rotat_mat * scale_mat;
+
+        return model_mat;
+    }
+
+    bool get_render_sphere(RenderSphere_s & rs) const {
+        rs.x = this->x;
+        rs.y = this->y;
+        rs.z = this->z;
+        rs.scale = this->r * AMMO_R_TO_SIZE_RATIO;
+        rs.angle_xy = this->angle_xy + AMMO_ROTATE_OFFS_ANGLE_XY;
+        rs.angle_z = this->angle_z;
+        rs.is_hit = 0;
+        rs.is_alive = this->is_fired;
+        return true;
+    }
+};
+
+class Tank : public Sphere {
+    #define TANK_DEFAULT_HEALTH                 (20.0f)
+    #define TANK_DEFAULT_TURN_SPEED             (MY_PI_HALF / 2.0f)
+    #define TANK_DEFAULT_MOVE_SPEED             (5.0f)
+    #define TANK_DEFAULT_MAX_NUM_AMMO           (12)
+    #define TANK_DEFAULT_TIMER_IS_HIT           (0.1f)
+    #define TANK_DEFAULT_TIMER_IS_COOLING_FIRE  (0.05f)
+    #define TANK_DEFAULT_TIMER_IS_LOADING_AMMO  (0.8f)
+
+    float health;
+    float timer_is_hit;
+    float timer_is_cooling_fire;
+    float timer_is_loading_ammo;
+
+    int MAX_NUM_AMMO;
+    int num_ammo;
+    float move_speed;
+    float angle_xy;
+    float angle_z;
+    float turn_speed;
+    // unit heading, refreshed by turn()
+    float dir_x;
+    float dir_y;
+    float dir_z;
+
+    public:
+    Tank(float x, float y, float z, float r) : Sphere(x, y, z, r), health{TANK_DEFAULT_HEALTH}, timer_is_hit{0.0f}, timer_is_cooling_fire{0.0f}, timer_is_loading_ammo{0.0f},
+        MAX_NUM_AMMO{TANK_DEFAULT_MAX_NUM_AMMO}, num_ammo{TANK_DEFAULT_MAX_NUM_AMMO}, move_speed{TANK_DEFAULT_MOVE_SPEED}, angle_xy{0.0f}, angle_z{0.0f}, turn_speed{TANK_DEFAULT_TURN_SPEED},
+        dir_x{0.0f}, dir_y{0.0f}, dir_z{0.0f} {
+        Sphere::get_direction(this->angle_xy, this->angle_z, this->dir_x, this->dir_y, this->dir_z);
+    }
+
+    float get_angle_xy() const {
+        return this->angle_xy;
+    }
+
+    float get_angle_z() const {
+        return this->angle_z;
+    }
+
+    float get_move_speed() const {
+        return this->move_speed;
+    }
+
+    float get_turn_speed() const {
+        return this->turn_speed;
+    }
+
+    float get_health() const {
+        return this->health;
+    }
+
+    int get_num_ammo() const {
+        return this->num_ammo;
+    }
+
+    float get_dir_x() const {
+        return this->dir_x;
+    }
+
+    float get_dir_y() const {
+        return this->dir_y;
+    }
+
+    float get_dir_z() const {
+        return this->dir_z;
+    }
+
+    bool get_is_alive() const {
+        return this->health > 0.0f;
+    }
+
+    bool set_is_alive(bool is_alive) {
+        if (is_alive) {
+            this->health = TANK_DEFAULT_HEALTH;
+        }
+        else {
+            this->health = 0.0f;
+        }
+        return true;
+    }
+
+    bool get_is_hit() const {
+        return this->timer_is_hit > 0.0f;
+    }
+
+    bool set_is_hit(bool is_hit) {
+        if (is_hit) {
+            this->timer_is_hit = TANK_DEFAULT_TIMER_IS_HIT;
+        }
+        else {
+            this->timer_is_hit = 0.0f;
+        }
+        return true;
+    }
+
+    bool reduce_health(float amount) {
+        if (this->health > 0.0f) {
+            this->health -= amount;
+            return true;
+        }
+        else {
+            return false;
+        }
+    }
+
+    bool turn(float angle_xy) {
+        if (angle_xy == 0.0f) {
+            return false;
+        }
+        this->angle_xy += angle_xy * this->turn_speed;
+        Sphere::get_direction(this->angle_xy, this->angle_z, this->dir_x, this->dir_y, this->dir_z);
+        return true;
+    }
+
+    #define TANK_R_TO_BARREL_Z_RATIO            (0.54f)
+    // Returns false, leaving ammo untouched, if the tank cannot fire right now
+    bool fire(Ammo & ammo) {
+        if (this->get_is_alive() == false || this->timer_is_cooling_fire > 0.0f || this->num_ammo <= 0) {
+            return false;
+        }
+        this->timer_is_cooling_fire = TANK_DEFAULT_TIMER_IS_COOLING_FIRE;
+        this->num_ammo --;
+        ammo = Ammo(this->x, this->y, this->z + this->r * TANK_R_TO_BARREL_Z_RATIO, this->r / 4.0f, this->angle_xy, this->angle_z, this->move_speed * 5.0f);
+        ammo.advance(this->r + ammo.get_r());
+        return true;
+    }
+
+    bool refreash(float time) {
+        if (this->get_is_alive() == false) {
+            return false;
+        }
+        if (this->timer_is_hit > 0.0f) {
+            this->timer_is_hit -= time;
+        }
+        if (this->timer_is_cooling_fire > 0.0f) {
+            this->timer_is_cooling_fire -= time;
+        }
+        if (this->timer_is_loading_ammo > 0.0f) {
+            this->timer_is_loading_ammo -= time;
+        }
+        else {
+            if (this->num_ammo < this->MAX_NUM_AMMO) {
+                this->num_ammo ++;
+                this->timer_is_loading_ammo = TANK_DEFAULT_TIMER_IS_LOADING_AMMO;
+            }
+        }
+        return true;
+    }
+
+    #define TANK_R_TO_SIZE_RATIO                (0.35f)
+    glm::mat4 get_model_matrix() const {
+        glm::mat4 scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(this->r * TANK_R_TO_SIZE_RATIO, this->r * TANK_R_TO_SIZE_RATIO, this->r * TANK_R_TO_SIZE_RATIO));
+        glm::mat4 trans_mat = glm::translate(glm::mat4(), glm::vec3(this->x, this->y, this->z));
+        glm::mat4 rotat_mat = glm::rotate( glm::mat4(1.0f), this->angle_xy, glm::vec3(0, 0, 1) );
+        glm::mat4 model_mat = trans_mat * rotat_mat * scale_mat;
+
+        return model_mat;
+    }
+
+    bool get_render_sphere(RenderSphere_s & rs) const {
+        rs.x = this->x;
+        rs.y = this->y;
+        rs.z = this->z;
+        rs.scale = this->r * TANK_R_TO_SIZE_RATIO;
+        rs.angle_xy = this->angle_xy;
+        rs.angle_z = 0.0f;
+        rs.is_hit = this->get_is_hit();
+        rs.is_alive = this->get_is_alive();
+        return true;
+    }
+};
+typedef struct TankAction_s {
+    float turn_angle_xy;
+    float advance_dist;
+    int is_firing;
+}TankAction_s;
+
+#endif
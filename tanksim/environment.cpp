@@ -0,0 +1,950 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <algorithm>
+
+#include "environment.hpp"
+
+static int env_get_tank_idx(Environment_s const & env, Tank const & tank) {
+    return static_cast<int>(&tank - &env.tank_vec[0]);
+}
+
+// While the parallel projectile step commits its hits, every entity whose
+// position or liveness changes is logged here, see env_commit_ammo_hit
+static bool env_mark_dirty(Environment_s & env, Sphere const & s) {
+    if (env.is_logging_dirty) {
+        env.dirty_sphere_vec.push_back(s);
+    }
+    return true;
+}
+
+static bool env_damage_obst(Environment_s & env, Obst & obst, float amount) {
+    bool is_activated = obst.get_is_activated();
+    obst.reduce_health(amount);
+    if (is_activated && obst.get_is_activated() == false) {
+        env_mark_dirty(env, obst);
+        env.obst_bvh.set_is_active(static_cast<int>(&obst - &env.obst_vec[0]), false);
+    }
+    return true;
+}
+
+static bool env_damage_tank(Environment_s & env, Tank & tank, float amount) {
+    bool is_alive = tank.get_is_alive();
+    tank.reduce_health(amount);
+    if (is_alive && tank.get_is_alive() == false) {
+        env_mark_dirty(env, tank);
+    }
+    return true;
+}
+
+static bool env_move_tank(Environment_s & env, Tank & tank, float dir_x, float dir_y, float dir_z, float dist) {
+    env_mark_dirty(env, tank);
+    tank.move(dir_x, dir_y, dir_z, dist);
+    env_mark_dirty(env, tank);
+    int tank_idx = env_get_tank_idx(env, tank);
+    env.tank_soa.set(tank_idx, tank);
+    return env.tank_grid.update(tank_idx, tank);
+}
+
+// Moves the tank and takes the move back if it leaves the arena or runs into
+// a live obstacle. Overlaps with other tanks are left for env_solve_tank_contacts.
+bool tank_move_and_check(Tank & tank, float dir_x, float dir_y, float dir_z, float dist, Environment_s & env) {
+    if (tank.get_is_alive() == false) {
+        return false;
+    }
+    env_move_tank(env, tank, dir_x, dir_y, dir_z, dist);
+    if (tank.check_is_out_of_bound(env.scenario.bound)) {
+        env_move_tank(env, tank, dir_x, dir_y, dir_z, -dist);
+        return false;
+    }
+    if (env.obst_bvh.query(tank, env.grid_query_vec)) {
+        Obst & obst = env.obst_vec[env.grid_query_vec[0]];
+        obst.set_is_hit(true);
+        env_damage_obst(env, obst, 0.00001);
+        env_move_tank(env, tank, dir_x, dir_y, dir_z, -dist);
+        return false;
+    }
+    return true;
+}
+
+// Unit xy normal from a to b and the penetration left once they are pushed
+// ENV_SOLVER_SLOP apart; coincident centres are split along x, lower index first
+static float env_get_contact_normal(Sphere const & a, Sphere const & b, float & normal_x, float & normal_y) {
+    float x_diff = b.get_x() - a.get_x();
+    float y_diff = b.get_y() - a.get_y();
+    float dist = sqrt(x_diff * x_diff + y_diff * y_diff);
+    normal_x = 1.0f;
+    normal_y = 0.0f;
+    if (dist > 0.0f) {
+        normal_x = x_diff / dist;
+        normal_y = y_diff / dist;
+    }
+    return a.get_r() + b.get_r() + ENV_SOLVER_SLOP - dist;
+}
+
+// Pushes the tank out of every live obstacle it overlaps and back into the
+// arena; obstacles and walls do not give way
+static bool env_project_tank_static(Environment_s & env, Tank & tank) {
+    std::vector<int> & candidate_vec = env.grid_query_vec;
+    env.obst_bvh.query(tank, candidate_vec);
+    for (int candidate_idx = 0; candidate_idx < candidate_vec.size(); candidate_idx ++) {
+        Obst & obst = env.obst_vec[candidate_vec[candidate_idx]];
+        // an earlier push may already have cleared this one
+        if (Sphere::check_is_collided(obst, tank)) {
+            float normal_x = 0.0f;
+            float normal_y = 0.0f;
+            float depth = env_get_contact_normal(obst, tank, normal_x, normal_y);
+            obst.set_is_hit(true);
+            env_move_tank(env, tank, normal_x, normal_y, 0.0f, depth);
+        }
+    }
+    Bound_s const & bound = env.scenario.bound;
+    float pos[3] = {tank.get_x(), tank.get_y(), tank.get_z()};
+    float bound_min[3] = {bound.x_min, bound.y_min, bound.z_min};
+    float bound_max[3] = {bound.x_max, bound.y_max, bound.z_max};
+    for (int axis = 0; axis < 3; axis ++) {
+        float dir[3] = {0.0f, 0.0f, 0.0f};
+        dir[axis] = 1.0f;
+        if (pos[axis] < bound_min[axis]) {
+            env_move_tank(env, tank, dir[0], dir[1], dir[2], bound_min[axis] - pos[axis]);
+        }
+        else if (pos[axis] > bound_max[axis]) {
+            env_move_tank(env, tank, dir[0], dir[1], dir[2], bound_max[axis] - pos[axis]);
+        }
+    }
+    return true;
+}
+
+static int env_find_island(std::vector<int> & island_vec, int tank_idx) {
+    while (island_vec[tank_idx] != tank_idx) {
+        island_vec[tank_idx] = island_vec[island_vec[tank_idx]];
+        tank_idx = island_vec[tank_idx];
+    }
+    return tank_idx;
+}
+
+static bool env_compare_contact(TankContact_s const & a, TankContact_s const & b) {
+    if (a.island_idx != b.island_idx) {
+        return a.island_idx < b.island_idx;
+    }
+    if (a.tank_idx_a != b.tank_idx_a) {
+        return a.tank_idx_a < b.tank_idx_a;
+    }
+    return a.tank_idx_b < b.tank_idx_b;
+}
+
+// Separates overlapping live tanks once per tick, after every move of the tick.
+// Contacts are gathered once, with a margin so tanks pushed into a neighbour
+// during the solve are covered too, and grouped into islands of touching
+// tanks. Each island then runs at most ENV_SOLVER_ITERATIONS Jacobi
+// relaxations: every contact pushes its pair apart by half the overlap, each
+// tank moves by the average of its pushes and is projected out of obstacles
+// and walls. The result depends on positions only, not on the tank order, and
+// the cost is bounded by contacts times iterations.
+bool env_solve_tank_contacts(Environment_s & env) {
+    PROF_SCOPE(PROF_PHASE_CONTACTS);
+    TRACE_ZONE("contacts");
+    int num_tanks = static_cast<int>(env.tank_vec.size());
+    std::vector<TankContact_s> & contact_vec = env.tank_contact_vec;
+    std::vector<int> & island_vec = env.tank_island_vec;
+    contact_vec.clear();
+    island_vec.resize(num_tanks);
+    for (int tank_idx = 0; tank_idx < num_tanks; tank_idx ++) {
+        island_vec[tank_idx] = tank_idx;
+    }
+
+    std::vector<int> & candidate_vec = env.grid_query_vec;
+    for (int tank_idx = 0; tank_idx < num_tanks; tank_idx ++) {
+        Tank & tank = env.tank_vec[tank_idx];
+        if (tank.get_is_alive() == false) {
+            continue;
+        }
+        Sphere reach(tank.get_x(), tank.get_y(), tank.get_z(), tank.get_r() + ENV_SOLVER_MARGIN);
+        env.tank_grid.query(reach, candidate_vec);
+        env.tank_soa.filter_collided(reach, candidate_vec);
+        for (int candidate_idx = 0; candidate_idx < candidate_vec.size(); candidate_idx ++) {
+            int other_idx = candidate_vec[candidate_idx];
+            Tank & other = env.tank_vec[other_idx];
+            if (other_idx <= tank_idx || other.get_is_alive() == false) {
+                continue;
+            }
+            TankContact_s contact;
+            contact.tank_idx_a = tank_idx;
+            contact.tank_idx_b = other_idx;
+            contact.island_idx = -1;
+            contact_vec.push_back(contact);
+            int island_a = env_find_island(island_vec, tank_idx);
+            int island_b = env_find_island(island_vec, other_idx);
+            // the lowest tank index names the island
+            island_vec[std::max(island_a, island_b)] = std::min(island_a, island_b);
+            if (Sphere::check_is_collided(tank, other)) {
+                tank.set_is_hit(true);
+                other.set_is_hit(true);
+                env_damage_tank(env, tank, 0.00001);
+                env_damage_tank(env, other, 0.00001);
+            }
+        }
+    }
+    if (contact_vec.empty()) {
+        return true;
+    }
+    for (int contact_idx = 0; contact_idx < contact_vec.size(); contact_idx ++) {
+        contact_vec[contact_idx].island_idx = env_find_island(island_vec, contact_vec[contact_idx].tank_idx_a);
+    }
+    std::sort(contact_vec.begin(), contact_vec.end(), env_compare_contact);
+
+    // x push, y push, push count per tank
+    std::vector<float> & push_vec = env.tank_push_vec;
+    push_vec.assign(num_tanks * 3, 0.0f);
+    int island_begin = 0;
+    while (island_begin < contact_vec.size()) {
+        int island_end = island_begin;
+        while (island_end < contact_vec.size() && contact_vec[island_end].island_idx == contact_vec[island_begin].island_idx) {
+            island_end ++;
+        }
+        for (int itr_idx = 0; itr_idx < ENV_SOLVER_ITERATIONS; itr_idx ++) {
+            bool is_active = false;
+            for (int contact_idx = island_begin; contact_idx < island_end; contact_idx ++) {
+                TankContact_s const & contact = contact_vec[contact_idx];
+                Tank const & tank_a = env.tank_vec[contact.tank_idx_a];
+                Tank const & tank_b = env.tank_vec[contact.tank_idx_b];
+                if (Sphere::check_is_collided(tank_a, tank_b) == false) {
+                    continue;
+                }
+                float normal_x = 0.0f;
+                float normal_y = 0.0f;
+                float half_depth = env_get_contact_normal(tank_a, tank_b, normal_x, normal_y) * 0.5f;
+                push_vec[contact.tank_idx_a * 3] -= normal_x * half_depth;
+                push_vec[contact.tank_idx_a * 3 + 1] -= normal_y * half_depth;
+                push_vec[contact.tank_idx_a * 3 + 2] += 1.0f;
+                push_vec[contact.tank_idx_b * 3] += normal_x * half_depth;
+                push_vec[contact.tank_idx_b * 3 + 1] += normal_y * half_depth;
+                push_vec[contact.tank_idx_b * 3 + 2] += 1.0f;
+                is_active = true;
+            }
+            if (is_active == false) {
+                break;
+            }
+            for (int contact_idx = island_begin; contact_idx < island_end; contact_idx ++) {
+                int const pair_idx[2] = {contact_vec[contact_idx].tank_idx_a, contact_vec[contact_idx].tank_idx_b};
+                for (int side = 0; side < 2; side ++) {
+                    float * push = &push_vec[pair_idx[side] * 3];
+                    if (push[2] == 0.0f) {
+                        continue;
+                    }
+                    float push_x = push[0] / push[2];
+                    float push_y = push[1] / push[2];
+                    float push_dist = sqrt(push_x * push_x + push_y * push_y);
+                    push[0] = 0.0f;
+                    push[1] = 0.0f;
+                    push[2] = 0.0f;
+                    Tank & tank = env.tank_vec[pair_idx[side]];
+                    if (push_dist > 0.0f) {
+                        env_move_tank(env, tank, push_x / push_dist, push_y / push_dist, 0.0f, push_dist);
+                    }
+                    env_project_tank_static(env, tank);
+                }
+            }
+        }
+        island_begin = island_end;
+    }
+    return true;
+}
+
+// Bounding sphere of the step of length dist along the unit direction dir that ended at s
+static Sphere env_get_sweep_reach(Sphere const & s, float dir_x, float dir_y, float dir_z, float dist) {
+    return Sphere(
+        s.get_x() - dir_x * dist * 0.5f,
+        s.get_y() - dir_y * dist * 0.5f,
+        s.get_z() - dir_z * dist * 0.5f,
+        s.get_r() + dist * 0.5f);
+}
+
+static Sphere env_get_sweep_reach(Ammo const & ammo, float dist) {
+    return env_get_sweep_reach(ammo, ammo.get_dir_x(), ammo.get_dir_y(), ammo.get_dir_z(), dist);
+}
+
+// Sweeps the step of length dist that s just took along the unit direction
+// dir, ending at its current position, so fast shots cannot tunnel through
+// thin targets at low tick rates. Finds the earliest hit among live obstacles
+// and tanks (obstacles win ties). Read-only, so it may run on any thread with
+// its own candidate_vec.
+static bool env_sweep_sphere(Sphere const & s, float dir_x, float dir_y, float dir_z, float dist, Environment_s const & env, std::vector<int> & candidate_vec, ProjectileHit_s & hit) {
+    hit.obst_idx = -1;
+    hit.tank_idx = -1;
+    Sphere start(s.get_x() - dir_x * dist, s.get_y() - dir_y * dist, s.get_z() - dir_z * dist, s.get_r());
+    Sphere reach = env_get_sweep_reach(s, dir_x, dir_y, dir_z, dist);
+
+    hit.toi = dist;
+    hit.is_in_bound = Sphere::get_sweep_bound_toi(start, dir_x, dir_y, dir_z, dist, env.scenario.bound, hit.toi) ? 0 : 1;
+    bool is_hit = false;
+    float toi = 0.0f;
+
+    env.obst_bvh.query(reach, candidate_vec);
+    for (int candidate_idx = 0; candidate_idx < candidate_vec.size(); candidate_idx ++) {
+        if (Sphere::get_sweep_toi(start, dir_x, dir_y, dir_z, dist, env.obst_vec[candidate_vec[candidate_idx]], toi)) {
+            if (is_hit ? toi < hit.toi : toi <= hit.toi) {
+                hit.toi = toi;
+                hit.obst_idx = candidate_vec[candidate_idx];
+                is_hit = true;
+            }
+        }
+    }
+    env.tank_grid.query(reach, candidate_vec);
+    env.tank_soa.filter_collided(reach, candidate_vec);
+    for (int candidate_idx = 0; candidate_idx < candidate_vec.size(); candidate_idx ++) {
+        Tank const & tank = env.tank_vec[candidate_vec[candidate_idx]];
+        if (tank.get_is_alive() && Sphere::get_sweep_toi(start, dir_x, dir_y, dir_z, dist, tank, toi)) {
+            if (is_hit ? toi < hit.toi : toi <= hit.toi) {
+                hit.toi = toi;
+                hit.obst_idx = -1;
+                hit.tank_idx = candidate_vec[candidate_idx];
+                is_hit = true;
+            }
+        }
+    }
+    return is_hit;
+}
+
+static bool env_sweep_projectile(Ammo const & ammo, float dist, Environment_s const & env, std::vector<int> & candidate_vec, ProjectileHit_s & hit) {
+    return env_sweep_sphere(ammo, ammo.get_dir_x(), ammo.get_dir_y(), ammo.get_dir_z(), dist, env, candidate_vec, hit);
+}
+
+// Rewinds the projectile to the impact point and applies the hit; false once it is spent
+static bool env_apply_ammo_hit(Ammo & ammo, float dist, ProjectileHit_s const & hit, Environment_s & env) {
+    if (hit.obst_idx >= 0 || hit.tank_idx >= 0 || hit.is_in_bound == 0) {
+        ammo.advance(hit.toi - dist);
+    }
+    if (hit.obst_idx >= 0) {
+        Obst & obst = env.obst_vec[hit.obst_idx];
+        obst.set_is_hit(true);
+        env_damage_obst(env, obst, 1.0f);
+        ammo.set_is_fired(false);
+        return false;
+    }
+    if (hit.tank_idx >= 0) {
+        Tank & tank_collided = env.tank_vec[hit.tank_idx];
+        float dir_x_collided = 0.0f;
+        float dir_y_collided = 0.0f;
+        float dir_z_collided = 0.0f;
+        float dist_collided = 0.0f;
+        Sphere::get_relation(ammo, tank_collided, dir_x_collided, dir_y_collided, dir_z_collided, dist_collided);
+        tank_collided.set_is_hit(true);
+        env_damage_tank(env, tank_collided, 1.0f);
+        tank_move_and_check(tank_collided, dir_x_collided, dir_y_collided, dir_z_collided, ammo.get_r(), env);
+        ammo.set_is_fired(false);
+        return false;
+    }
+    if (hit.is_in_bound == 0) {
+        ammo.set_is_fired(false);
+        return false;
+    }
+    return true;
+}
+
+// Stops the drop at the impact point, which it reached after falling hit.toi of its dist
+static bool env_apply_rain_hit(int drop_idx, float dist, ProjectileHit_s const & hit, Environment_s & env) {
+    if (hit.obst_idx < 0 && hit.tank_idx < 0 && hit.is_in_bound != 0) {
+        return true;
+    }
+    env.rain.set_spent(drop_idx, env.rain.get_sphere(drop_idx).get_z() + (dist - hit.toi));
+    if (hit.obst_idx >= 0) {
+        Obst & obst = env.obst_vec[hit.obst_idx];
+        obst.set_is_hit(true);
+        env_damage_obst(env, obst, 1.0f);
+    }
+    else if (hit.tank_idx >= 0) {
+        Tank & tank = env.tank_vec[hit.tank_idx];
+        tank.set_is_hit(true);
+        env_damage_tank(env, tank, 1.0f);
+    }
+    return false;
+}
+
+bool ammo_move_and_check(Ammo & ammo, float dist, Environment_s & env) {
+    if (ammo.get_is_fired() == false) {
+        return false;
+    }
+    ammo.advance(dist);
+    return ammo_check(ammo, dist, env);
+}
+
+bool ammo_check(Ammo & ammo, float dist, Environment_s & env) {
+    if (ammo.get_is_fired() == false) {
+        return false;
+    }
+    ProjectileHit_s hit;
+    env_sweep_projectile(ammo, dist, env, env.grid_query_vec, hit);
+    return env_apply_ammo_hit(ammo, dist, hit, env);
+}
+
+// Same expression the original layout used, so the default scenario is unchanged
+static float env_rand_float(float lo, float hi) {
+    return lo + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (hi - lo)));
+}
+
+// Picks a candidate centre for a sphere of radius r, fully inside the arena
+static bool env_sample_spawn(Scenario_s const & scenario, int spawn, float r, std::vector<float> const & cluster_xy_vec, float & x, float & y) {
+    Bound_s const & bound = scenario.bound;
+    if (spawn == SCENARIO_SPAWN_CLUSTERED && cluster_xy_vec.empty() == false) {
+        int cluster_idx = rand() % (cluster_xy_vec.size() / 2);
+        // sum of three uniforms, a cheap bell shape around the centre
+        float x_offs = env_rand_float(-1.0f, 1.0f) + env_rand_float(-1.0f, 1.0f) + env_rand_float(-1.0f, 1.0f);
+        float y_offs = env_rand_float(-1.0f, 1.0f) + env_rand_float(-1.0f, 1.0f) + env_rand_float(-1.0f, 1.0f);
+        x = cluster_xy_vec[cluster_idx * 2] + x_offs * scenario.obst_cluster_r / 3.0f;
+        y = cluster_xy_vec[cluster_idx * 2 + 1] + y_offs * scenario.obst_cluster_r / 3.0f;
+        x = std::min(std::max(x, bound.x_min + r), bound.x_max - r);
+        y = std::min(std::max(y, bound.y_min + r), bound.y_max - r);
+    }
+    else {
+        x = env_rand_float(bound.x_min + r, bound.x_max - r);
+        y = env_rand_float(bound.y_min + r, bound.y_max - r);
+    }
+    return true;
+}
+
+// Dart throwing against a grid of everything placed so far. A try only looks at
+// the neighbouring cells, so a layout costs O(num * place_max_try) as long as
+// the arena is not packed close to the jamming limit. Returns how many fit.
+static int env_place_spheres(Scenario_s const & scenario, int spawn, int num, float r, float z, SpatialGrid & place_grid, std::vector<Sphere> & placed_vec, std::vector<Sphere> & out_vec) {
+    std::vector<float> cluster_xy_vec;
+    if (spawn == SCENARIO_SPAWN_CLUSTERED) {
+        for (int cluster_idx = 0; cluster_idx < scenario.num_obst_cluster; cluster_idx ++) {
+            cluster_xy_vec.push_back(env_rand_float(scenario.bound.x_min, scenario.bound.x_max));
+            cluster_xy_vec.push_back(env_rand_float(scenario.bound.y_min, scenario.bound.y_max));
+        }
+    }
+    std::vector<int> candidate_vec;
+    int num_placed = 0;
+    for (int idx = 0; idx < num; idx ++) {
+        for (int try_idx = 0; try_idx < scenario.place_max_try; try_idx ++) {
+            float x = 0.0f;
+            float y = 0.0f;
+            env_sample_spawn(scenario, spawn, r, cluster_xy_vec, x, y);
+            Sphere s(x, y, z, r);
+            place_grid.query(s, candidate_vec);
+            bool is_free = true;
+            for (int candidate_idx = 0; candidate_idx < candidate_vec.size() && is_free; candidate_idx ++) {
+                Sphere const & placed = placed_vec[candidate_vec[candidate_idx]];
+                // placement ignores height, nothing may stand on top of anything else
+                is_free = Sphere::check_is_collided(s, Sphere(placed.get_x(), placed.get_y(), z, placed.get_r())) == false;
+            }
+            if (is_free) {
+                place_grid.insert(static_cast<int>(placed_vec.size()), s);
+                placed_vec.push_back(s);
+                out_vec.push_back(s);
+                num_placed ++;
+                break;
+            }
+        }
+    }
+    if (num_placed < num) {
+        fprintf(stderr, "Scenario: placed %d of %d spheres of radius %.2f, the arena is too crowded\n", num_placed, num, r);
+    }
+    return num_placed;
+}
+
+// Cell size for a grid over the arena, capped so huge arenas keep a sane cell count
+#define ENV_GRID_MAX_CELLS_PER_AXIS         (1024)
+static float env_get_grid_cell_size(Bound_s const & bound, float min_cell_size) {
+    float extent = std::max(bound.x_max - bound.x_min, bound.y_max - bound.y_min);
+    return std::max(min_cell_size, extent / ENV_GRID_MAX_CELLS_PER_AXIS);
+}
+
+bool env_init(Environment_s & env) {
+    return env_init(env, ENV_DEFAULT_RNG_SEED);
+}
+
+bool env_init(Environment_s & env, unsigned int rng_seed) {
+    Scenario_s scenario;
+    scenario_set_default(scenario);
+    scenario.rng_seed = rng_seed;
+    return env_init(env, scenario);
+}
+
+bool env_init(Environment_s & env, Scenario_s const & scenario) {
+    TRACE_ZONE("env_init");
+    if (scenario_validate(scenario) == false) {
+        return false;
+    }
+    env.is_terminated = 0;
+    env.p_input = NULL;
+    env.p_clock = NULL;
+    env.p_workers = NULL;
+    env.is_logging_dirty = 0;
+    env.tick_time = 1.0f / ENV_DEFAULT_TICK_RATE;
+    env.max_catch_up_ticks = ENV_DEFAULT_MAX_CATCH_UP_TICKS;
+    env.tick_idx = 0;
+    env.sim_time = 0.0;
+    env.scenario = scenario;
+
+    env.ammo_pool.init(scenario.ammo_pool_capacity);
+    env.obst_vec.clear();
+    env.tank_vec.clear();
+
+    srand(scenario.rng_seed);
+
+    SpatialGrid place_grid;
+    place_grid.init(scenario.bound.x_min, scenario.bound.x_max, scenario.bound.y_min, scenario.bound.y_max,
+        env_get_grid_cell_size(scenario.bound, 2.0f * std::max(scenario.obst_r, scenario.tank_r)));
+    std::vector<Sphere> placed_vec;
+    std::vector<Sphere> out_vec;
+
+    // tanks first, so they are never crowded out by obstacles
+    if (scenario.tank_spawn == SCENARIO_SPAWN_LEGACY) {
+        // the original two tanks, any further ones, or those whose fixed spot
+        // the bound leaves out, are placed uniformly
+        float const legacy_xy[2] = {-5.0f, 5.0f};
+        for (int tank_idx = 0; tank_idx < scenario.num_tank && tank_idx < 2; tank_idx ++) {
+            Sphere tank(legacy_xy[tank_idx], legacy_xy[tank_idx], 0.0f, scenario.tank_r);
+            if (Sphere::check_is_out_of_bound(tank, scenario.bound)) {
+                continue;
+            }
+            out_vec.push_back(tank);
+            place_grid.insert(static_cast<int>(placed_vec.size()), out_vec.back());
+            placed_vec.push_back(out_vec.back());
+        }
+        env_place_spheres(scenario, SCENARIO_SPAWN_UNIFORM, scenario.num_tank - static_cast<int>(out_vec.size()), scenario.tank_r, 0.0f, place_grid, placed_vec, out_vec);
+    }
+    else {
+        env_place_spheres(scenario, scenario.tank_spawn, scenario.num_tank, scenario.tank_r, 0.0f, place_grid, placed_vec, out_vec);
+    }
+    for (int tank_idx = 0; tank_idx < out_vec.size(); tank_idx ++) {
+        env.tank_vec.push_back(Tank(out_vec[tank_idx].get_x(), out_vec[tank_idx].get_y(), out_vec[tank_idx].get_z(), out_vec[tank_idx].get_r()));
+    }
+
+    out_vec.clear();
+    if (scenario.obst_spawn == SCENARIO_SPAWN_LEGACY) {
+        // uniform and free to overlap, as the game always did
+        for (int obst_idx = 0; obst_idx < scenario.num_obst; obst_idx ++) {
+            float x = env_rand_float(scenario.bound.x_min, scenario.bound.x_max);
+            float y = env_rand_float(scenario.bound.y_min, scenario.bound.y_max);
+            out_vec.push_back(Sphere(x, y, scenario.obst_r, scenario.obst_r));
+        }
+    }
+    else {
+        env_place_spheres(scenario, scenario.obst_spawn, scenario.num_obst, scenario.obst_r, scenario.obst_r, place_grid, placed_vec, out_vec);
+    }
+    for (int obst_idx = 0; obst_idx < out_vec.size(); obst_idx ++) {
+        env.obst_vec.push_back(Obst(out_vec[obst_idx].get_x(), out_vec[obst_idx].get_y(), out_vec[obst_idx].get_z(), out_vec[obst_idx].get_r()));
+    }
+
+    // rain has its own PRNG streams, it never touches rand()
+    env.rain.init(scenario);
+    env.rain_batch_vec.assign(env.rain.get_num_blocks(), RainBatch_s());
+
+    return env_build_broadphase(env);
+}
+
+bool env_build_broadphase(Environment_s & env) {
+    Bound_s const & bound = env.scenario.bound;
+    float cell_size = env_get_grid_cell_size(bound, SPATIAL_GRID_DEFAULT_CELL_SIZE);
+    std::vector<Sphere> obst_sphere_vec(env.obst_vec.begin(), env.obst_vec.end());
+    env.obst_bvh.build(obst_sphere_vec);
+    env.obst_top_z = bound.z_min;
+    for (int obst_idx = 0; obst_idx < env.obst_vec.size(); obst_idx ++) {
+        Obst const & obst = env.obst_vec[obst_idx];
+        env.obst_bvh.set_is_active(obst_idx, obst.get_is_activated());
+        env.obst_top_z = std::max(env.obst_top_z, obst.get_z() + obst.get_r());
+    }
+    env.tank_grid.init(bound.x_min, bound.x_max, bound.y_min, bound.y_max, cell_size);
+    env.tank_soa.clear();
+    for (int tank_idx = 0; tank_idx < env.tank_vec.size(); tank_idx ++) {
+        env.tank_grid.insert(tank_idx, env.tank_vec[tank_idx]);
+        env.tank_soa.push_back(env.tank_vec[tank_idx]);
+    }
+    return true;
+}
+
+bool env_refresh(Environment_s & env, float time) {
+    PROF_SCOPE(PROF_PHASE_REFRESH);
+    TRACE_ZONE("refresh");
+    for (int obst_idx = 0; obst_idx < env.obst_vec.size(); obst_idx ++) {
+        Obst & obst = env.obst_vec[obst_idx];
+        if (obst.get_is_activated()) {
+            obst.refreash(time);
+        }
+    }
+
+    for (int tank_idx = 0; tank_idx < env.tank_vec.size(); tank_idx ++) {
+        Tank & tank = env.tank_vec[tank_idx];
+        if (tank.get_is_alive()) {
+            tank.refreash(time);
+        }
+    }
+
+    return true;
+}
+
+
+// Moves every fired entry along its cached heading in one tight pass, no trig.
+// Projectiles never steer, so moving them all before the collision checks gives
+// the same result as moving each right before its own check.
+static void env_advance_ammo(Ammo * ammo_buf, int ammo_cnt, float delta_time) {
+    for (int ammo_idx = 0; ammo_idx < ammo_cnt; ammo_idx ++) {
+        Ammo & ammo = ammo_buf[ammo_idx];
+        if (ammo.get_is_fired()) {
+            ammo.advance(ammo.get_move_speed() * delta_time);
+        }
+    }
+}
+
+// Parallel half of the projectile step: advances ammo_buf and sweeps every
+// entry against the current world, writing env.hit_vec[i] for ammo_buf[i].
+// Partitions are contiguous and each owns its slice of hit_vec and its own
+// candidate buffer, so the workers share nothing writable.
+static bool env_sweep_projectiles_parallel(Environment_s & env, Ammo * ammo_buf, int ammo_cnt, float delta_time) {
+    int num_partitions = std::min(env.p_workers->get_num_threads() * ENV_PARTITIONS_PER_THREAD, (ammo_cnt + ENV_PARALLEL_MIN_BATCH - 1) / ENV_PARALLEL_MIN_BATCH);
+    int partition_size = (ammo_cnt + num_partitions - 1) / num_partitions;
+    env.hit_vec.resize(ammo_cnt);
+    if (env.worker_query_vec.size() < num_partitions) {
+        env.worker_query_vec.resize(num_partitions);
+    }
+    Environment_s const & env_const = env;
+    env.p_workers->run(num_partitions, [&](int partition_idx) {
+        TRACE_ZONE("ammo_partition");
+        int begin = partition_idx * partition_size;
+        int end = std::min(ammo_cnt, begin + partition_size);
+        std::vector<int> & candidate_vec = env.worker_query_vec[partition_idx];
+        for (int ammo_idx = begin; ammo_idx < end; ammo_idx ++) {
+            Ammo & ammo = ammo_buf[ammo_idx];
+            if (ammo.get_is_fired()) {
+                float dist = ammo.get_move_speed() * delta_time;
+                ammo.advance(dist);
+                env_sweep_projectile(ammo, dist, env_const, candidate_vec, env.hit_vec[ammo_idx]);
+            }
+        }
+    });
+    env.dirty_sphere_vec.clear();
+    env.is_logging_dirty = 1;
+    return true;
+}
+
+// Serial half of the projectile step. A hit found by the parallel sweep is
+// applied as is, unless an earlier commit of this tick moved, killed or
+// deactivated something the step could reach; then the step is swept again
+// against the current world. Either way the result equals the serial tick.
+static bool env_check_is_dirty(Environment_s const & env, Sphere const & reach) {
+    if (env.dirty_sphere_vec.empty()) {
+        return false;
+    }
+    for (int dirty_idx = 0; dirty_idx < env.dirty_sphere_vec.size(); dirty_idx ++) {
+        if (Sphere::check_is_collided(reach, env.dirty_sphere_vec[dirty_idx])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool env_commit_ammo_hit(Ammo & ammo, float dist, ProjectileHit_s const & hit, Environment_s & env) {
+    if (ammo.get_is_fired() == false) {
+        return false;
+    }
+    if (env_check_is_dirty(env, env_get_sweep_reach(ammo, dist))) {
+        return ammo_check(ammo, dist, env);
+    }
+    return env_apply_ammo_hit(ammo, dist, hit, env);
+}
+
+static bool env_get_is_parallel(Environment_s const & env, int projectile_cnt) {
+    return env.p_workers != NULL && env.p_workers->get_num_threads() > 1 && projectile_cnt >= ENV_PARALLEL_MIN_BATCH * 2;
+}
+
+// Drops fall straight down, so a drop whose step ended above low_z cannot
+// have touched anything; only the rest are swept. The sweep reads the world
+// as left by the projectile step, so it is read-only and blocks run in parallel.
+static bool env_fall_rain_block(Environment_s & env, int block_idx, float delta_time, float low_z) {
+    TRACE_ZONE("rain_block");
+    RainBatch_s & batch = env.rain_batch_vec[block_idx];
+    env.rain.respawn(block_idx, env.scenario);
+    batch.drop_idx_vec.clear();
+    env.rain.fall(block_idx, delta_time, low_z, batch.drop_idx_vec);
+    batch.hit_vec.resize(batch.drop_idx_vec.size());
+    Environment_s const & env_const = env;
+    for (int batch_idx = 0; batch_idx < batch.drop_idx_vec.size(); batch_idx ++) {
+        int drop_idx = batch.drop_idx_vec[batch_idx];
+        float dist = env.rain.get_speed(drop_idx) * delta_time;
+        env_sweep_sphere(env.rain.get_sphere(drop_idx), 0.0f, 0.0f, -1.0f, dist, env_const, batch.candidate_vec, batch.hit_vec[batch_idx]);
+    }
+    return true;
+}
+
+// Rain step: respawn, fall and sweep per block, then commit the hits serially
+// in drop order. A drop whose reach touches something an earlier commit of
+// this tick killed is swept again, so the outcome matches a drop-by-drop pass.
+static bool env_step_rain(Environment_s & env, float delta_time) {
+    PROF_SCOPE(PROF_PHASE_RAIN);
+    TRACE_ZONE("rain");
+    float top_z = env.obst_top_z;
+    for (int tank_idx = 0; tank_idx < env.tank_vec.size(); tank_idx ++) {
+        top_z = std::max(top_z, env.tank_vec[tank_idx].get_z() + env.tank_vec[tank_idx].get_r());
+    }
+    float low_z = std::max(top_z + env.rain.get_max_r(), env.scenario.bound.z_min);
+
+    int num_blocks = env.rain.get_num_blocks();
+    if (env_get_is_parallel(env, env.rain.size()) && num_blocks > 1) {
+        env.p_workers->run(num_blocks, [&](int block_idx) {
+            env_fall_rain_block(env, block_idx, delta_time, low_z);
+        });
+    }
+    else {
+        for (int block_idx = 0; block_idx < num_blocks; block_idx ++) {
+            env_fall_rain_block(env, block_idx, delta_time, low_z);
+        }
+    }
+
+    env.dirty_sphere_vec.clear();
+    env.is_logging_dirty = 1;
+    for (int block_idx = 0; block_idx < num_blocks; block_idx ++) {
+        RainBatch_s const & batch = env.rain_batch_vec[block_idx];
+        for (int batch_idx = 0; batch_idx < batch.drop_idx_vec.size(); batch_idx ++) {
+            int drop_idx = batch.drop_idx_vec[batch_idx];
+            float dist = env.rain.get_speed(drop_idx) * delta_time;
+            Sphere drop = env.rain.get_sphere(drop_idx);
+            ProjectileHit_s hit = batch.hit_vec[batch_idx];
+            if (env_check_is_dirty(env, env_get_sweep_reach(drop, 0.0f, 0.0f, -1.0f, dist))) {
+                env_sweep_sphere(drop, 0.0f, 0.0f, -1.0f, dist, env, env.grid_query_vec, hit);
+            }
+            env_apply_rain_hit(drop_idx, dist, hit, env);
+        }
+    }
+    env.is_logging_dirty = 0;
+    return true;
+}
+
+// Applies every tank's action for this tick; shots fired go into the ammo pool
+static bool env_step_tanks(Environment_s & env, float delta_time) {
+    PROF_SCOPE(PROF_PHASE_TANKS);
+    TRACE_ZONE("tanks");
+    if (env.p_input != NULL) {
+        env.p_input->begin_tick(delta_time);
+    }
+    TankAction_s tank_act;
+    for (int tank_idx = 0; tank_idx < env.tank_vec.size(); tank_idx ++) {
+        Tank & tank = env.tank_vec[tank_idx];
+
+        if (env.p_input == NULL || env.p_input->get_tank_act(tank_act, tank_idx, delta_time) == false) {
+            tank_act.turn_angle_xy = 0.0f;
+            tank_act.advance_dist = 0.0f;
+            tank_act.is_firing = 0;
+        }
+        tank.turn(tank_act.turn_angle_xy * delta_time);
+        tank_move_and_check(tank, tank.get_dir_x(), tank.get_dir_y(), tank.get_dir_z(), tank_act.advance_dist * delta_time, env);
+        // a full pool holds the shot back instead of wasting the tank's ammo
+        Ammo ammo;
+        if (tank_act.is_firing == 1 && env.ammo_pool.get_is_full() == false && tank.fire(ammo)) {
+            env.ammo_pool.alloc(ammo);
+        }
+    }
+    return true;
+}
+
+// Moves every live shot and applies its hits, freeing the spent ones
+static bool env_step_ammo(Environment_s & env, float delta_time) {
+    PROF_SCOPE(PROF_PHASE_AMMO);
+    TRACE_ZONE("ammo");
+    bool is_parallel = env_get_is_parallel(env, env.ammo_pool.size());
+    if (is_parallel) {
+        env_sweep_projectiles_parallel(env, env.ammo_pool.data(), env.ammo_pool.size(), delta_time);
+        // hit_order_vec[i] is the hit_vec entry of the shot now at dense position i
+        env.hit_order_vec.resize(env.ammo_pool.size());
+        for (int ammo_idx = 0; ammo_idx < env.hit_order_vec.size(); ammo_idx ++) {
+            env.hit_order_vec[ammo_idx] = ammo_idx;
+        }
+    }
+    else {
+        env_advance_ammo(env.ammo_pool.data(), env.ammo_pool.size(), delta_time);
+    }
+    int ammo_idx = 0;
+    while (ammo_idx < env.ammo_pool.size()) {
+        Ammo & ammo = env.ammo_pool[ammo_idx];
+        if (is_parallel) {
+            env_commit_ammo_hit(ammo, ammo.get_move_speed() * delta_time, env.hit_vec[env.hit_order_vec[ammo_idx]], env);
+        }
+        else {
+            ammo_check(ammo, ammo.get_move_speed() * delta_time, env);
+        }
+        if (ammo.get_is_fired()) {
+            ammo_idx ++;
+        }
+        else {
+            // the last live shot moves into ammo_idx and is processed next
+            if (is_parallel) {
+                env.hit_order_vec[ammo_idx] = env.hit_order_vec[env.ammo_pool.size() - 1];
+            }
+            env.ammo_pool.free_at(ammo_idx);
+        }
+    }
+    env.is_logging_dirty = 0;
+    return true;
+}
+
+bool env_tick(Environment_s & env, float delta_time) {
+    PROF_SCOPE(PROF_PHASE_TICK);
+    TRACE_ZONE("env_tick");
+    env_refresh(env, delta_time);
+    env_step_tanks(env, delta_time);
+    env_step_ammo(env, delta_time);
+    env_step_rain(env, delta_time);
+
+    // tanks driven or shot into each other this tick are separated in one go
+    env_solve_tank_contacts(env);
+
+    env.tick_idx ++;
+    env.sim_time += delta_time;
+    return true;
+}
+
+template <typename T>
+static void env_fill_render_sphere_vec(std::vector<RenderSphere_s> & rs_vec, T const * src_buf, int src_cnt, bool is_alive_only) {
+    // clear() keeps the capacity, so after warm-up no allocation happens here
+    rs_vec.clear();
+    RenderSphere_s rs;
+    for (int src_idx = 0; src_idx < src_cnt; src_idx ++) {
+        src_buf[src_idx].get_render_sphere(rs);
+        if (is_alive_only == false || rs.is_alive) {
+            rs_vec.push_back(rs);
+        }
+    }
+}
+
+bool env_fill_render_snapshot(Environment_s const & env, RenderSnapshot_s & snapshot) {
+    snapshot.tick_idx = env.tick_idx;
+    env_fill_render_sphere_vec(snapshot.obst_vec, env.obst_vec.data(), env.obst_vec.size(), false);
+    env_fill_render_sphere_vec(snapshot.tank_vec, env.tank_vec.data(), env.tank_vec.size(), false);
+    env_fill_render_sphere_vec(snapshot.ammo_vec, env.ammo_pool.data(), env.ammo_pool.size(), true);
+    snapshot.rain_vec.clear();
+    RenderSphere_s rs;
+    for (int drop_idx = 0; drop_idx < env.rain.size(); drop_idx ++) {
+        if (env.rain.get_is_falling(drop_idx)) {
+            env.rain.get_render_sphere(drop_idx, rs);
+            snapshot.rain_vec.push_back(rs);
+        }
+    }
+    return true;
+}
+
+bool env_publish_snapshot(Environment_s & env) {
+    PROF_SCOPE(PROF_PHASE_PUBLISH);
+    TRACE_ZONE("publish");
+    env_fill_render_snapshot(env, env.snapshot_buf.get_back());
+    env.snapshot_buf.publish();
+    return true;
+}
+
+bool env_check_line_of_sight(Environment_s const & env, Sphere const & from, Sphere const & to) {
+    float x_diff = to.get_x() - from.get_x();
+    float y_diff = to.get_y() - from.get_y();
+    float z_diff = to.get_z() - from.get_z();
+    float dist = sqrt(x_diff * x_diff + y_diff * y_diff + z_diff * z_diff);
+    if (dist == 0.0f) {
+        return true;
+    }
+    int obst_idx = -1;
+    float toi = 0.0f;
+    Sphere ray(from.get_x(), from.get_y(), from.get_z(), 0.0f);
+    return env.obst_bvh.raycast(ray, x_diff / dist, y_diff / dist, z_diff / dist, dist, obst_idx, toi) == false;
+}
+
+#define ENV_HASH_OFFSET_BASIS              (14695981039346656037ull)
+#define ENV_HASH_PRIME                      (1099511628211ull)
+static unsigned long long env_hash_bytes(unsigned long long hash, void const * p_data, int size) {
+    unsigned char const * p_byte = static_cast<unsigned char const *>(p_data);
+    for (int byte_idx = 0; byte_idx < size; byte_idx ++) {
+        hash = (hash ^ p_byte[byte_idx]) * ENV_HASH_PRIME;
+    }
+    return hash;
+}
+
+static unsigned long long env_hash_float(unsigned long long hash, float value) {
+    return env_hash_bytes(hash, &value, sizeof(value));
+}
+
+static unsigned long long env_hash_sphere(unsigned long long hash, Sphere const & s) {
+    hash = env_hash_float(hash, s.get_x());
+    hash = env_hash_float(hash, s.get_y());
+    hash = env_hash_float(hash, s.get_z());
+    return env_hash_float(hash, s.get_r());
+}
+
+unsigned long long env_get_state_hash(Environment_s const & env) {
+    unsigned long long hash = ENV_HASH_OFFSET_BASIS;
+    unsigned long long tick_idx = env.tick_idx;
+    hash = env_hash_bytes(hash, &tick_idx, sizeof(tick_idx));
+    for (int obst_idx = 0; obst_idx < env.obst_vec.size(); obst_idx ++) {
+        Obst const & obst = env.obst_vec[obst_idx];
+        hash = env_hash_sphere(hash, obst);
+        hash = env_hash_float(hash, obst.get_health());
+    }
+    for (int tank_idx = 0; tank_idx < env.tank_vec.size(); tank_idx ++) {
+        Tank const & tank = env.tank_vec[tank_idx];
+        int num_ammo = tank.get_num_ammo();
+        hash = env_hash_sphere(hash, tank);
+        hash = env_hash_float(hash, tank.get_angle_xy());
+        hash = env_hash_float(hash, tank.get_health());
+        hash = env_hash_bytes(hash, &num_ammo, sizeof(num_ammo));
+    }
+    // dense pool order is part of the state, it decides the order of the next tick's checks
+    for (int ammo_idx = 0; ammo_idx < env.ammo_pool.size(); ammo_idx ++) {
+        hash = env_hash_sphere(hash, env.ammo_pool[ammo_idx]);
+    }
+    for (int drop_idx = 0; drop_idx < env.rain.size(); drop_idx ++) {
+        int is_falling = env.rain.get_is_falling(drop_idx) ? 1 : 0;
+        hash = env_hash_sphere(hash, env.rain.get_sphere(drop_idx));
+        hash = env_hash_bytes(hash, &is_falling, sizeof(is_falling));
+    }
+    return hash;
+}
+
+double SteadyClock::get_time() {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// The OS sleep can overshoot by a scheduler quantum, so wake up a little early
+// and yield for the remainder.
+#define STEADY_CLOCK_YIELD_MARGIN           (0.00025)
+bool SteadyClock::sleep_until(double wake_time) {
+    double coarse_wake_time = wake_time - STEADY_CLOCK_YIELD_MARGIN;
+    double curr_time = this->get_time();
+    if (curr_time < coarse_wake_time) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(coarse_wake_time - curr_time));
+    }
+    while (this->get_time() < wake_time) {
+        std::this_thread::yield();
+    }
+    return true;
+}
+
+void env_proc_main(Environment_s * p_arg) {
+    trace_set_thread_name("sim");
+    SteadyClock default_clock;
+    SimClock & clock = (p_arg != NULL && p_arg->p_clock != NULL) ? *p_arg->p_clock : default_clock;
+    double last_time = clock.get_time();
+    double accumulator = 0.0;
+
+    while (p_arg != NULL && p_arg->is_terminated == 0) {
+        Environment_s & env = *p_arg;
+
+        // Accumulate wall time and consume it in fixed steps
+        double curr_time = clock.get_time();
+        accumulator += curr_time - last_time;
+        last_time = curr_time;
+
+        int num_ticks = 0;
+        while (accumulator >= env.tick_time && num_ticks < env.max_catch_up_ticks) {
+            env_tick(env, env.tick_time);
+            accumulator -= env.tick_time;
+            num_ticks ++;
+        }
+        // Too far behind (debugger, overloaded host): drop the backlog instead of spiralling
+        if (accumulator >= env.tick_time) {
+            accumulator = 0.0;
+        }
+
+        env_publish_snapshot(env);
+
+        clock.sleep_until(curr_time + env.tick_time - accumulator);
+    }
+}
@@ -0,0 +1,163 @@
+#ifndef TANKSIM_ENVIRONMENT_HPP
+#define TANKSIM_ENVIRONMENT_HPP
+
+#include <vector>
+
+#include <common/triple_buffer.hpp>
+#include <common/slab_pool.hpp>
+#include <common/worker_pool.hpp>
+#include <common/trace_recorder.hpp>
+
+#include "sphere.hpp"
+#include "entity.hpp"
+#include "spatial_grid.hpp"
+#include "sphere_bvh.hpp"
+#include "scenario.hpp"
+#include "rain.hpp"
+
+// Where tank actions come from: the keyboard in the game, a script in the
+// headless driver. begin_tick runs once at the start of every tick, then
+// get_tank_act is polled once per tank, both from the sim thread.
+class TankInputSource {
+    public:
+    virtual ~TankInputSource() {}
+    virtual bool begin_tick(float delta_time) { return true; }
+    virtual bool get_tank_act(TankAction_s & tank_act, int tank_idx, float delta_time) = 0;
+};
+
+// Wall clock used by env_proc_main to pace fixed ticks, in seconds
+class SimClock {
+    public:
+    virtual ~SimClock() {}
+    virtual double get_time() = 0;
+    virtual bool sleep_until(double wake_time) = 0;
+};
+
+// std::chrono::steady_clock based SimClock, the default
+class SteadyClock : public SimClock {
+    public:
+    double get_time();
+    bool sleep_until(double wake_time);
+};
+
+// Everything the render loop needs for one frame. The sim thread fills one
+// after each wake-up and hands it over through Environment_s::snapshot_buf.
+typedef struct RenderSnapshot_s {
+    unsigned long tick_idx;
+    std::vector<RenderSphere_s> obst_vec;
+    std::vector<RenderSphere_s> tank_vec;
+    std::vector<RenderSphere_s> ammo_vec;
+    std::vector<RenderSphere_s> rain_vec;
+} RenderSnapshot_s;
+
+// Outcome of sweeping one projectile step, see ammo_check
+typedef struct ProjectileHit_s {
+    int obst_idx;       // -1 if no obstacle was hit
+    int tank_idx;       // -1 if no tank was hit
+    int is_in_bound;    // 0 if the step left the arena first
+    float toi;          // distance along the step to the impact or bound crossing
+} ProjectileHit_s;
+
+// Pair of live tanks close enough to touch during the contact solve, a < b
+typedef struct TankContact_s {
+    int tank_idx_a;
+    int tank_idx_b;
+    int island_idx;     // lowest tank index of the connected group
+} TankContact_s;
+
+// Scratch of one rain block: the drops that fell low enough to reach
+// something this tick, their sweep results and a broadphase buffer
+typedef struct RainBatch_s {
+    std::vector<int> drop_idx_vec;
+    std::vector<ProjectileHit_s> hit_vec;
+    std::vector<int> candidate_vec;
+} RainBatch_s;
+
+#define ENV_DEFAULT_TICK_RATE               (120.0f)
+#define ENV_DEFAULT_MAX_CATCH_UP_TICKS      (5)
+#define ENV_DEFAULT_RNG_SEED                (0u)
+// tank contact solver, see env_solve_tank_contacts
+#define ENV_SOLVER_ITERATIONS               (8)
+#define ENV_SOLVER_MARGIN                   (0.5f)      // extra reach when gathering contacts
+#define ENV_SOLVER_SLOP                     (0.001f)    // separated tanks end this far apart
+// projectiles per partition of the parallel sweep, fewer than two batches run serially
+#define ENV_PARALLEL_MIN_BATCH              (128)
+#define ENV_PARTITIONS_PER_THREAD           (4)
+
+typedef struct Environment_s {
+    int is_terminated;
+
+    // fixed timestep, see env_proc_main
+    float tick_time;
+    int max_catch_up_ticks;
+    unsigned long tick_idx;
+    double sim_time;
+
+    // layout, arena bounds and RNG seed this world was built from; fixed after env_init
+    Scenario_s scenario;
+
+    std::vector<Obst> obst_vec;
+    SlabPool<Ammo> ammo_pool;
+    std::vector<Tank> tank_vec;
+    RainSystem rain;
+    std::vector<RainBatch_s> rain_batch_vec;
+
+    // broadphase and narrowphase mirrors, kept in sync with obst_vec and tank_vec;
+    // obstacles never move, destroyed ones are masked out of obst_bvh
+    SphereBvh obst_bvh;
+    SpatialGrid tank_grid;
+    SphereSoA tank_soa;
+    std::vector<int> grid_query_vec;
+    // highest obstacle top, drops above it plus their radius cannot hit one
+    float obst_top_z;
+
+    // tank contact solver scratch
+    std::vector<TankContact_s> tank_contact_vec;
+    std::vector<int> tank_island_vec;
+    std::vector<float> tank_push_vec;
+
+    // parallel projectile step, see env_tick; results do not depend on the thread count
+    std::vector<ProjectileHit_s> hit_vec;
+    std::vector<int> hit_order_vec;
+    std::vector< std::vector<int> > worker_query_vec;
+    // spheres whose position or liveness changed while hits were being committed
+    int is_logging_dirty;
+    std::vector<Sphere> dirty_sphere_vec;
+
+    // sim -> render hand-over, the render loop must not touch the vectors above
+    TripleBuffer<RenderSnapshot_s> snapshot_buf;
+
+    // injected by the host, all may be NULL (no input / SteadyClock / serial tick)
+    TankInputSource * p_input;
+    SimClock * p_clock;
+    WorkerPool * p_workers;
+} Environment_s;
+
+bool tank_move_and_check(Tank & tank, float dir_x, float dir_y, float dir_z, float dist, Environment_s & env);
+// Pushes overlapping live tanks apart, see env_tick
+bool env_solve_tank_contacts(Environment_s & env);
+// *_check sweep the step of length dist that ended at the current position;
+// env_tick moves all projectiles beforehand
+bool ammo_move_and_check(Ammo & ammo, float dist, Environment_s & env);
+bool ammo_check(Ammo & ammo, float dist, Environment_s & env);
+
+bool env_init(Environment_s & env);
+bool env_init(Environment_s & env, unsigned int rng_seed);
+bool env_init(Environment_s & env, Scenario_s const & scenario);
+// Rebuilds the obstacle BVH and the tank grid and SoA from obst_vec and tank_vec; call after filling them by hand
+bool env_build_broadphase(Environment_s & env);
+bool env_refresh(Environment_s & env, float time);
+// Advances the simulation by exactly one fixed step of delta_time seconds
+bool env_tick(Environment_s & env, float delta_time);
+// Copies what the render loop draws out of the sim state; allocates only until the vectors have grown
+bool env_fill_render_snapshot(Environment_s const & env, RenderSnapshot_s & snapshot);
+bool env_publish_snapshot(Environment_s & env);
+// True if no live obstacle blocks the segment between the two centres
+bool env_check_line_of_sight(Environment_s const & env, Sphere const & from, Sphere const & to);
+// FNV-1a hash over the exact bits of the whole simulation state, for comparing runs
+unsigned long long env_get_state_hash(Environment_s const & env);
+
+// Sim thread entry: runs fixed ticks paced by env.p_clock until env.is_terminated
+void env_proc_main(Environment_s * p_arg);
+
+#endif
@@ -0,0 +1,139 @@
+#ifndef TANKSIM_INPUT_QUEUE_HPP
+#define TANKSIM_INPUT_QUEUE_HPP
+
+#include <stdio.h>
+#include <algorithm>
+#include <atomic>
+
+#include <common/spsc_ring.hpp>
+#include <common/log_histogram.hpp>
+
+#include "environment.hpp"
+
+// Logical tank keys, independent of the windowing library
+#define TANK_KEY_FORWARD                    (0)
+#define TANK_KEY_BACKWARD                   (1)
+#define TANK_KEY_LEFT                       (2)
+#define TANK_KEY_RIGHT                      (3)
+#define TANK_KEY_FIRE                       (4)
+#define TANK_KEY_NUM                        (5)
+
+// One key transition, stamped by the input thread with its SimClock time
+typedef struct InputEvent_s {
+    int user_idx;
+    int key;
+    int is_pressed;
+    double time;
+} InputEvent_s;
+
+// TankInputSource fed by key transitions from another thread.
+// The input thread calls push_key() (typically from a window key callback);
+// the sim thread drains the ring once at the start of every tick and turns the
+// resulting key state into per-tank actions, so the sim never polls the window.
+class QueuedTankInputSource : public TankInputSource {
+    #define INPUT_QUEUE_DEFAULT_CAPACITY        (256)
+    #define INPUT_QUEUE_MAX_NUM_USERS           (4)
+    // The fire key has to be held this long (in sim time) before a shot goes out;
+    // releasing it drains the hold timer at the same rate
+    #define TANK_ACT_FIRE_HOLD_TIME             (0.1f)
+
+    SimClock & clock;
+    SpscRing<InputEvent_s> event_ring;
+    std::atomic<unsigned long> num_dropped;
+
+    // owned by the sim thread
+    int key_state[INPUT_QUEUE_MAX_NUM_USERS][TANK_KEY_NUM];
+    float timer_fire_hold[INPUT_QUEUE_MAX_NUM_USERS];
+    bool is_latency_logged;
+    LogHistogram latency_hist;                      // ns
+
+    public:
+    QueuedTankInputSource(SimClock & clock) : clock(clock), num_dropped{0ul}, is_latency_logged{false} {
+        this->event_ring.init(INPUT_QUEUE_DEFAULT_CAPACITY);
+        for (int user_idx = 0; user_idx < INPUT_QUEUE_MAX_NUM_USERS; user_idx ++) {
+            std::fill(this->key_state[user_idx], this->key_state[user_idx] + TANK_KEY_NUM, 0);
+            this->timer_fire_hold[user_idx] = 0.0f;
+        }
+    }
+
+    bool set_is_latency_logged(bool is_latency_logged) {
+        this->is_latency_logged = is_latency_logged;
+        return true;
+    }
+
+    // Input thread side. Drops the event, and counts it, if the ring is full.
+    bool push_key(int user_idx, int key, bool is_pressed) {
+        InputEvent_s event;
+        event.user_idx = user_idx;
+        event.key = key;
+        event.is_pressed = is_pressed ? 1 : 0;
+        event.time = this->clock.get_time();
+        if (this->event_ring.push(event) == false) {
+            this->num_dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    // Sim thread side
+    bool begin_tick(float delta_time) {
+        InputEvent_s event;
+        double drain_time = this->is_latency_logged ? this->clock.get_time() : 0.0;
+        while (this->event_ring.pop(event)) {
+            if (event.user_idx >= 0 && event.user_idx < INPUT_QUEUE_MAX_NUM_USERS && event.key >= 0 && event.key < TANK_KEY_NUM) {
+                this->key_state[event.user_idx][event.key] = event.is_pressed;
+            }
+            if (this->is_latency_logged) {
+                this->latency_hist.add(static_cast<unsigned long long>(std::max(drain_time - event.time, 0.0) * 1e9));
+            }
+        }
+        return true;
+    }
+
+    bool get_tank_act(TankAction_s & tank_act, int user_idx, float delta_time) {
+        tank_act.turn_angle_xy = 0.0f;
+        tank_act.advance_dist = 0.0f;
+        tank_act.is_firing = 0;
+        if (user_idx < 0 || user_idx >= INPUT_QUEUE_MAX_NUM_USERS) {
+            return false;
+        }
+
+        int const * keys = this->key_state[user_idx];
+        if (keys[TANK_KEY_FORWARD]) {
+            tank_act.advance_dist = 1.0f;
+        }
+        if (keys[TANK_KEY_BACKWARD]) {
+            tank_act.advance_dist = -1.0f;
+        }
+        if (keys[TANK_KEY_LEFT]) {
+            tank_act.turn_angle_xy = 1.0f;
+        }
+        if (keys[TANK_KEY_RIGHT]) {
+            tank_act.turn_angle_xy = -1.0f;
+        }
+
+        float & timer_fire_hold = this->timer_fire_hold[user_idx];
+        if (keys[TANK_KEY_FIRE]) {
+            timer_fire_hold += delta_time;
+        }
+        else if (timer_fire_hold > 0.0f) {
+            timer_fire_hold = std::max(0.0f, timer_fire_hold - delta_time);
+        }
+        if (timer_fire_hold > TANK_ACT_FIRE_HOLD_TIME) {
+            timer_fire_hold = 0.0f;
+            tank_act.is_firing = 1;
+        }
+        return true;
+    }
+
+    // Key-to-tick latencies in ns; only safe to read once the sim thread has stopped
+    LogHistogram const & get_latency_hist() const {
+        return this->latency_hist;
+    }
+
+    unsigned long get_num_dropped() const {
+        return this->num_dropped.load(std::memory_order_relaxed);
+    }
+};
+
+#endif
@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <algorithm>
+
+#include "net_client.hpp"
+
+NetClient::NetClient() : is_welcomed{0}, tank_idx{-1}, tick_time{0.0f}, snapshot_idx{-1}, num_snapshots{0} {
+    this->sent_act.turn_angle_xy = 0.0f;
+    this->sent_act.advance_dist = 0.0f;
+    this->sent_act.is_firing = 0;
+}
+
+bool NetClient::connect(char const * addr) {
+    this->close();
+    this->is_welcomed = 0;
+    this->tank_idx = -1;
+    this->snapshot_idx = -1;
+    return this->conn.open(net_connect(addr));
+}
+
+bool NetClient::close() {
+    return this->conn.close();
+}
+
+bool NetClient::receive() {
+    if (this->conn.receive() == false) {
+        return false;
+    }
+    int type = 0;
+    NetReader reader;
+    while (this->conn.pop_msg(type, reader)) {
+        if (type == NET_MSG_WELCOME) {
+            unsigned int version = 0;
+            unsigned int tank_idx = 0;
+            bool is_read = reader.get_u32(version) && reader.get_u32(tank_idx) && reader.get_f32(this->tick_time) &&
+                reader.get_f32(this->bound.x_min) && reader.get_f32(this->bound.x_max) &&
+                reader.get_f32(this->bound.y_min) && reader.get_f32(this->bound.y_max) &&
+                reader.get_f32(this->bound.z_min) && reader.get_f32(this->bound.z_max);
+            if (is_read == false || version != NET_PROTOCOL_VERSION) {
+                fprintf(stderr, "Server speaks protocol version %u, expected %u\n", version, NET_PROTOCOL_VERSION);
+                this->close();
+                return false;
+            }
+            this->tank_idx = tank_idx == NET_NO_TANK ? -1 : static_cast<int>(tank_idx);
+            this->is_welcomed = 1;
+        }
+        else if (type == NET_MSG_SNAPSHOT) {
+            // decode into the older slot, the newer one is the baseline
+            int next_idx = this->snapshot_idx == 0 ? 1 : 0;
+            NetSnapshot_s const * p_baseline = this->get_snapshot();
+            if (net_decode_snapshot(reader, p_baseline, this->snapshot_vec[next_idx]) == false) {
+                // the stream cannot recover from a lost baseline
+                fprintf(stderr, "Bad snapshot after tick %lu\n", p_baseline != NULL ? p_baseline->tick_idx : 0ul);
+                this->close();
+                return false;
+            }
+            this->snapshot_idx = next_idx;
+            this->num_snapshots ++;
+        }
+    }
+    return this->conn.get_is_open();
+}
+
+bool NetClient::wait_welcome(int timeout_ms) {
+    int fd = this->conn.get_fd();
+    while (this->receive() && this->is_welcomed == 0) {
+        if (net_wait_readable(&fd, 1, timeout_ms) == false) {
+            fprintf(stderr, "No welcome from the server\n");
+            return false;
+        }
+    }
+    return this->is_welcomed != 0;
+}
+
+bool NetClient::send_action(TankAction_s const & tank_act) {
+    bool is_changed = tank_act.turn_angle_xy != this->sent_act.turn_angle_xy || tank_act.advance_dist != this->sent_act.advance_dist;
+    if (is_changed == false && tank_act.is_firing == 0) {
+        return true;
+    }
+    NetWriter writer = this->conn.get_writer();
+    size_t size_pos = writer.begin_msg(NET_MSG_ACTION);
+    writer.put_f32(tank_act.turn_angle_xy);
+    writer.put_f32(tank_act.advance_dist);
+    writer.put_u8(tank_act.is_firing ? 1 : 0);
+    writer.end_msg(size_pos);
+    this->sent_act = tank_act;
+    return this->conn.flush();
+}
+
+void net_client_proc_main(Environment_s * p_env, NetClient * p_client) {
+    trace_set_thread_name("net client");
+    SteadyClock clock;
+    Environment_s & env = *p_env;
+    unsigned long published_num_snapshots = 0;
+    double next_time = clock.get_time();
+    while (env.is_terminated == 0) {
+        if (p_client->receive() == false) {
+            fprintf(stderr, "Disconnected from the server\n");
+            break;
+        }
+        TankAction_s tank_act;
+        if (env.p_input != NULL) {
+            env.p_input->begin_tick(env.tick_time);
+            if (env.p_input->get_tank_act(tank_act, 0, env.tick_time) && p_client->get_tank_idx() >= 0) {
+                p_client->send_action(tank_act);
+            }
+        }
+
+        if (p_client->get_num_snapshots() != published_num_snapshots) {
+            TRACE_ZONE("publish");
+            net_dequantize_snapshot(*p_client->get_snapshot(), p_client->get_bound(), env.snapshot_buf.get_back());
+            env.snapshot_buf.publish();
+            published_num_snapshots = p_client->get_num_snapshots();
+        }
+
+        // after a stall, carry on from now instead of catching up
+        next_time = std::max(next_time + env.tick_time, clock.get_time() - env.tick_time);
+        clock.sleep_until(next_time);
+    }
+}
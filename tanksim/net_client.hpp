@@ -0,0 +1,72 @@
+#ifndef TANKSIM_NET_CLIENT_HPP
+#define TANKSIM_NET_CLIENT_HPP
+
+#include "environment.hpp"
+#include "net_protocol.hpp"
+
+// Client side of net_protocol.hpp: sends this player's actions and decodes
+// the snapshots the server streams back. Not thread-safe, one thread drives it.
+class NetClient {
+    NetConnection conn;
+    int is_welcomed;
+    int tank_idx;                                   // -1 for a spectator
+    float tick_time;
+    Bound_s bound;
+    TankAction_s sent_act;
+
+    // the newest decoded snapshot and the one before, which the next delta may not need
+    NetSnapshot_s snapshot_vec[2];
+    int snapshot_idx;                               // newest, -1 before the first
+    unsigned long num_snapshots;
+
+    public:
+    NetClient();
+
+    bool connect(char const * addr);
+    bool close();
+    bool get_is_open() const {
+        return this->conn.get_is_open();
+    }
+    int get_fd() const {
+        return this->conn.get_fd();
+    }
+    bool get_is_welcomed() const {
+        return this->is_welcomed != 0;
+    }
+    int get_tank_idx() const {
+        return this->tank_idx;
+    }
+    float get_tick_time() const {
+        return this->tick_time;
+    }
+    Bound_s const & get_bound() const {
+        return this->bound;
+    }
+    unsigned long get_num_snapshots() const {
+        return this->num_snapshots;
+    }
+    unsigned long long get_num_bytes_received() const {
+        return this->conn.get_num_bytes_received();
+    }
+
+    // Blocks until the server's welcome, which sets the tank, tick time and arena
+    bool wait_welcome(int timeout_ms);
+    // Reads and decodes whatever has arrived; returns false once the
+    // connection is gone, or a snapshot failed to decode, which closes it
+    bool receive();
+    // Newest snapshot, NULL before the first
+    NetSnapshot_s const * get_snapshot() const {
+        return this->snapshot_idx >= 0 ? &this->snapshot_vec[this->snapshot_idx] : NULL;
+    }
+    // Sends tank_act if it differs from the last one sent or fires
+    bool send_action(TankAction_s const & tank_act);
+};
+
+// Client thread entry for the game: every env.tick_time polls user 0 of
+// env.p_input, sends its action and publishes each new snapshot to
+// env.snapshot_buf, until env.is_terminated or the server goes away.
+// Stands in for env_proc_main, env itself is never ticked; call after
+// wait_welcome and copy the server's tick time and arena into env first.
+void net_client_proc_main(Environment_s * p_env, NetClient * p_client);
+
+#endif
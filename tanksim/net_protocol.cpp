@@ -0,0 +1,553 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <string>
+#include <algorithm>
+
+#if !defined(_WIN32)
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#endif
+
+#include "net_protocol.hpp"
+
+#define NET_FIELD_NUM                       (7)
+#define NET_LISTEN_BACKLOG                  (1024)
+#define NET_RECEIVE_CHUNK_SIZE              (64 << 10)
+
+bool NetWriter::put_f32(float value) {
+    unsigned int bits = 0;
+    memcpy(&bits, &value, sizeof(bits));
+    return this->put_u32(bits);
+}
+
+bool NetWriter::end_msg(size_t size_pos) {
+    unsigned int size = static_cast<unsigned int>(this->buf.size() - size_pos - 4);
+    for (int byte_idx = 0; byte_idx < 4; byte_idx ++) {
+        this->buf[size_pos + byte_idx] = static_cast<unsigned char>((size >> (byte_idx * 8)) & 0xff);
+    }
+    return true;
+}
+
+bool NetReader::get_f32(float & value) {
+    unsigned int bits = 0;
+    if (this->get_u32(bits) == false) {
+        return false;
+    }
+    memcpy(&value, &bits, sizeof(value));
+    return true;
+}
+
+static unsigned short net_quantize_range(float value, float lo, float hi) {
+    float t = hi > lo ? (value - lo) / (hi - lo) : 0.0f;
+    t = std::min(std::max(t, 0.0f), 1.0f);
+    return static_cast<unsigned short>(t * 65535.0f + 0.5f);
+}
+
+static float net_dequantize_range(unsigned short value, float lo, float hi) {
+    return lo + (hi - lo) * (value / 65535.0f);
+}
+
+static unsigned short net_quantize_angle(float angle) {
+    float const two_pi = 4.0f * MY_PI_HALF;
+    float turn = angle / two_pi;
+    turn -= std::floor(turn);
+    return static_cast<unsigned short>(static_cast<unsigned int>(turn * 65536.0f + 0.5f) & 0xffffu);
+}
+
+static float net_dequantize_angle(unsigned short value) {
+    return value * (4.0f * MY_PI_HALF / 65536.0f);
+}
+
+bool net_quantize_snapshot(RenderSnapshot_s const & render_snapshot, Bound_s const & bound, NetSnapshot_s & snapshot) {
+    std::vector<RenderSphere_s> const * src_vec[NET_LIST_NUM] = {
+        &render_snapshot.obst_vec, &render_snapshot.tank_vec, &render_snapshot.ammo_vec, &render_snapshot.rain_vec,
+    };
+    snapshot.tick_idx = render_snapshot.tick_idx;
+    for (int list = 0; list < NET_LIST_NUM; list ++) {
+        std::vector<RenderSphere_s> const & rs_vec = *src_vec[list];
+        std::vector<NetSphere_s> & ns_vec = snapshot.list_vec[list];
+        ns_vec.resize(rs_vec.size());
+        for (int sphere_idx = 0; sphere_idx < rs_vec.size(); sphere_idx ++) {
+            RenderSphere_s const & rs = rs_vec[sphere_idx];
+            NetSphere_s & ns = ns_vec[sphere_idx];
+            ns.x = net_quantize_range(rs.x, bound.x_min, bound.x_max);
+            ns.y = net_quantize_range(rs.y, bound.y_min, bound.y_max);
+            ns.z = net_quantize_range(rs.z, bound.z_min, bound.z_max);
+            ns.scale = static_cast<unsigned short>(std::min(std::max(rs.scale * NET_SCALE_STEPS + 0.5f, 0.0f), 65535.0f));
+            ns.angle_xy = net_quantize_angle(rs.angle_xy);
+            ns.angle_z = net_quantize_angle(rs.angle_z);
+            ns.flags = static_cast<unsigned char>((rs.is_hit ? NET_FLAG_IS_HIT : 0) | (rs.is_alive ? NET_FLAG_IS_ALIVE : 0));
+        }
+    }
+    return true;
+}
+
+bool net_dequantize_snapshot(NetSnapshot_s const & snapshot, Bound_s const & bound, RenderSnapshot_s & render_snapshot) {
+    std::vector<RenderSphere_s> * dst_vec[NET_LIST_NUM] = {
+        &render_snapshot.obst_vec, &render_snapshot.tank_vec, &render_snapshot.ammo_vec, &render_snapshot.rain_vec,
+    };
+    render_snapshot.tick_idx = snapshot.tick_idx;
+    for (int list = 0; list < NET_LIST_NUM; list ++) {
+        std::vector<NetSphere_s> const & ns_vec = snapshot.list_vec[list];
+        std::vector<RenderSphere_s> & rs_vec = *dst_vec[list];
+        rs_vec.resize(ns_vec.size());
+        for (int sphere_idx = 0; sphere_idx < ns_vec.size(); sphere_idx ++) {
+            NetSphere_s const & ns = ns_vec[sphere_idx];
+            RenderSphere_s & rs = rs_vec[sphere_idx];
+            rs.x = net_dequantize_range(ns.x, bound.x_min, bound.x_max);
+            rs.y = net_dequantize_range(ns.y, bound.y_min, bound.y_max);
+            rs.z = net_dequantize_range(ns.z, bound.z_min, bound.z_max);
+            rs.scale = ns.scale / NET_SCALE_STEPS;
+            rs.angle_xy = net_dequantize_angle(ns.angle_xy);
+            rs.angle_z = net_dequantize_angle(ns.angle_z);
+            rs.is_hit = (ns.flags & NET_FLAG_IS_HIT) ? 1 : 0;
+            rs.is_alive = (ns.flags & NET_FLAG_IS_ALIVE) ? 1 : 0;
+        }
+    }
+    return true;
+}
+
+// Fields of a NetSphere_s in mask bit order
+static bool net_get_fields(NetSphere_s const & ns, unsigned int * field_buf) {
+    field_buf[0] = ns.x;
+    field_buf[1] = ns.y;
+    field_buf[2] = ns.z;
+    field_buf[3] = ns.scale;
+    field_buf[4] = ns.angle_xy;
+    field_buf[5] = ns.angle_z;
+    field_buf[6] = ns.flags;
+    return true;
+}
+
+static bool net_set_fields(NetSphere_s & ns, unsigned int const * field_buf) {
+    ns.x = static_cast<unsigned short>(field_buf[0]);
+    ns.y = static_cast<unsigned short>(field_buf[1]);
+    ns.z = static_cast<unsigned short>(field_buf[2]);
+    ns.scale = static_cast<unsigned short>(field_buf[3]);
+    ns.angle_xy = static_cast<unsigned short>(field_buf[4]);
+    ns.angle_z = static_cast<unsigned short>(field_buf[5]);
+    ns.flags = static_cast<unsigned char>(field_buf[6]);
+    return true;
+}
+
+// Field by field, memcmp would also compare the padding
+static bool net_get_is_equal(NetSphere_s const & a, NetSphere_s const & b) {
+    return a.x == b.x && a.y == b.y && a.z == b.z && a.scale == b.scale && a.angle_xy == b.angle_xy && a.angle_z == b.angle_z && a.flags == b.flags;
+}
+
+unsigned long long net_get_snapshot_hash(NetSnapshot_s const & snapshot) {
+    unsigned long long hash = 0xcbf29ce484222325ull;
+    unsigned int field_buf[NET_FIELD_NUM];
+    for (int list = 0; list < NET_LIST_NUM; list ++) {
+        std::vector<NetSphere_s> const & ns_vec = snapshot.list_vec[list];
+        hash = (hash ^ ns_vec.size()) * 0x100000001b3ull;
+        for (int sphere_idx = 0; sphere_idx < ns_vec.size(); sphere_idx ++) {
+            net_get_fields(ns_vec[sphere_idx], field_buf);
+            for (int field = 0; field < NET_FIELD_NUM; field ++) {
+                hash = (hash ^ field_buf[field]) * 0x100000001b3ull;
+            }
+        }
+    }
+    return hash;
+}
+
+bool net_encode_snapshot(NetSnapshot_s const & snapshot, NetSnapshot_s const * p_baseline, NetWriter & writer) {
+    static NetSphere_s const zero_sphere = {0, 0, 0, 0, 0, 0, 0};
+    writer.put_u32(static_cast<unsigned int>(snapshot.tick_idx));
+    writer.put_u32(p_baseline != NULL ? static_cast<unsigned int>(p_baseline->tick_idx) : NET_NO_BASELINE);
+    writer.put_u64(net_get_snapshot_hash(snapshot));
+
+    unsigned int field_buf[NET_FIELD_NUM];
+    unsigned int base_field_buf[NET_FIELD_NUM];
+    for (int list = 0; list < NET_LIST_NUM; list ++) {
+        std::vector<NetSphere_s> const & ns_vec = snapshot.list_vec[list];
+        std::vector<NetSphere_s> const * p_base_vec = p_baseline != NULL ? &p_baseline->list_vec[list] : NULL;
+        int base_cnt = p_base_vec != NULL ? static_cast<int>(p_base_vec->size()) : 0;
+        int sphere_cnt = static_cast<int>(ns_vec.size());
+
+        // count first, so the decoder knows when the list ends
+        unsigned int num_changed = 0;
+        for (int sphere_idx = 0; sphere_idx < sphere_cnt; sphere_idx ++) {
+            NetSphere_s const & base = sphere_idx < base_cnt ? (*p_base_vec)[sphere_idx] : zero_sphere;
+            num_changed += sphere_idx < base_cnt && net_get_is_equal(ns_vec[sphere_idx], base) ? 0 : 1;
+        }
+        writer.put_varint(sphere_cnt);
+        writer.put_varint(num_changed);
+
+        int prev_idx = -1;
+        for (int sphere_idx = 0; sphere_idx < sphere_cnt; sphere_idx ++) {
+            NetSphere_s const & base = sphere_idx < base_cnt ? (*p_base_vec)[sphere_idx] : zero_sphere;
+            // entries past the baseline always go out, see net_decode_snapshot
+            if (sphere_idx < base_cnt && net_get_is_equal(ns_vec[sphere_idx], base)) {
+                continue;
+            }
+            net_get_fields(ns_vec[sphere_idx], field_buf);
+            net_get_fields(base, base_field_buf);
+            unsigned int mask = 0;
+            for (int field = 0; field < NET_FIELD_NUM; field ++) {
+                mask |= field_buf[field] != base_field_buf[field] ? (1u << field) : 0u;
+            }
+            writer.put_varint(sphere_idx - prev_idx - 1);
+            writer.put_u8(mask);
+            for (int field = 0; field < NET_FIELD_NUM; field ++) {
+                if (mask & (1u << field)) {
+                    if (field == NET_FIELD_NUM - 1) {
+                        writer.put_u8(field_buf[field]);
+                    }
+                    else {
+                        writer.put_u16(field_buf[field]);
+                    }
+                }
+            }
+            prev_idx = sphere_idx;
+        }
+    }
+    return true;
+}
+
+bool net_decode_snapshot(NetReader & reader, NetSnapshot_s const * p_baseline, NetSnapshot_s & snapshot) {
+    static NetSphere_s const zero_sphere = {0, 0, 0, 0, 0, 0, 0};
+    unsigned int tick_idx = 0;
+    unsigned int base_tick_idx = 0;
+    unsigned long long hash = 0;
+    if (reader.get_u32(tick_idx) == false || reader.get_u32(base_tick_idx) == false || reader.get_u64(hash) == false) {
+        return false;
+    }
+    if (base_tick_idx == NET_NO_BASELINE) {
+        p_baseline = NULL;
+    }
+    else if (p_baseline == NULL || static_cast<unsigned int>(p_baseline->tick_idx) != base_tick_idx) {
+        return false;
+    }
+    snapshot.tick_idx = tick_idx;
+
+    unsigned int field_buf[NET_FIELD_NUM];
+    for (int list = 0; list < NET_LIST_NUM; list ++) {
+        std::vector<NetSphere_s> & ns_vec = snapshot.list_vec[list];
+        std::vector<NetSphere_s> const * p_base_vec = p_baseline != NULL ? &p_baseline->list_vec[list] : NULL;
+        int base_cnt = p_base_vec != NULL ? static_cast<int>(p_base_vec->size()) : 0;
+        unsigned int sphere_cnt = 0;
+        unsigned int num_changed = 0;
+        if (reader.get_varint(sphere_cnt) == false || reader.get_varint(num_changed) == false || num_changed > sphere_cnt) {
+            return false;
+        }
+        // every entry takes at least a gap and a mask byte and every entry past
+        // the baseline is sent, so a corrupt count fails here before allocating
+        if (num_changed > reader.get_num_left() / 2 || sphere_cnt > static_cast<unsigned int>(base_cnt) + num_changed) {
+            return false;
+        }
+        ns_vec.resize(sphere_cnt);
+        for (int sphere_idx = 0; sphere_idx < sphere_cnt; sphere_idx ++) {
+            ns_vec[sphere_idx] = sphere_idx < base_cnt ? (*p_base_vec)[sphere_idx] : zero_sphere;
+        }
+
+        int prev_idx = -1;
+        for (unsigned int changed_idx = 0; changed_idx < num_changed; changed_idx ++) {
+            unsigned int gap = 0;
+            unsigned int mask = 0;
+            if (reader.get_varint(gap) == false || reader.get_u8(mask) == false) {
+                return false;
+            }
+            long sphere_idx = static_cast<long>(prev_idx) + 1 + gap;
+            if (sphere_idx >= sphere_cnt) {
+                return false;
+            }
+            NetSphere_s & ns = ns_vec[sphere_idx];
+            net_get_fields(ns, field_buf);
+            for (int field = 0; field < NET_FIELD_NUM; field ++) {
+                if (mask & (1u << field)) {
+                    bool is_read = field == NET_FIELD_NUM - 1 ? reader.get_u8(field_buf[field]) : reader.get_u16(field_buf[field]);
+                    if (is_read == false) {
+                        return false;
+                    }
+                }
+            }
+            net_set_fields(ns, field_buf);
+            prev_idx = static_cast<int>(sphere_idx);
+        }
+    }
+    return reader.get_is_at_end() && net_get_snapshot_hash(snapshot) == hash;
+}
+
+#if !defined(_WIN32)
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL                        (0)     // macOS: SIGPIPE is ignored per socket instead, see net_set_options
+#endif
+
+static bool net_set_options(int fd, bool is_tcp) {
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    int one = 1;
+    if (is_tcp) {
+        // snapshots go out once per tick, batching them would only add latency
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    }
+#if defined(SO_NOSIGPIPE)
+    setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &one, sizeof(one));
+#endif
+    return true;
+}
+
+// Fills a sockaddr for addr, see net_listen; returns its length, 0 if addr is malformed
+static socklen_t net_parse_addr(char const * addr, sockaddr_storage & storage) {
+    memset(&storage, 0, sizeof(storage));
+    if (strncmp(addr, "unix:", 5) == 0) {
+        sockaddr_un & sun = reinterpret_cast<sockaddr_un &>(storage);
+        if (strlen(addr + 5) >= sizeof(sun.sun_path)) {
+            return 0;
+        }
+        sun.sun_family = AF_UNIX;
+        strcpy(sun.sun_path, addr + 5);
+        return sizeof(sockaddr_un);
+    }
+    std::string host = "127.0.0.1";
+    char const * port_str = addr;
+    char const * p_colon = strrchr(addr, ':');
+    if (p_colon != NULL) {
+        host.assign(addr, p_colon - addr);
+        port_str = p_colon + 1;
+    }
+    int port = atoi(port_str);
+    sockaddr_in & sin = reinterpret_cast<sockaddr_in &>(storage);
+    sin.sin_family = AF_INET;
+    sin.sin_port = htons(static_cast<unsigned short>(port));
+    if (port <= 0 || port > 65535 || inet_pton(AF_INET, host.c_str(), &sin.sin_addr) != 1) {
+        return 0;
+    }
+    return sizeof(sockaddr_in);
+}
+
+int net_listen(char const * addr) {
+    sockaddr_storage storage;
+    socklen_t addr_len = net_parse_addr(addr, storage);
+    if (addr_len == 0) {
+        fprintf(stderr, "Bad address %s, expected unix:path or [host:]port\n", addr);
+        return -1;
+    }
+    int fd = socket(storage.ss_family, SOCK_STREAM, 0);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to create a socket for %s: %s\n", addr, strerror(errno));
+        return -1;
+    }
+    if (storage.ss_family == AF_UNIX) {
+        // a stale socket file from an earlier run would make bind fail
+        unlink(reinterpret_cast<sockaddr_un &>(storage).sun_path);
+    }
+    else {
+        int one = 1;
+        setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    }
+    if (bind(fd, reinterpret_cast<sockaddr *>(&storage), addr_len) != 0 || listen(fd, NET_LISTEN_BACKLOG) != 0) {
+        fprintf(stderr, "Failed to listen on %s: %s\n", addr, strerror(errno));
+        close(fd);
+        return -1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    return fd;
+}
+
+int net_connect(char const * addr) {
+    sockaddr_storage storage;
+    socklen_t addr_len = net_parse_addr(addr, storage);
+    if (addr_len == 0) {
+        fprintf(stderr, "Bad address %s, expected unix:path or [host:]port\n", addr);
+        return -1;
+    }
+    int fd = socket(storage.ss_family, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&storage), addr_len) != 0) {
+        fprintf(stderr, "Failed to connect to %s: %s\n", addr, strerror(errno));
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    net_set_options(fd, storage.ss_family != AF_UNIX);
+    return fd;
+}
+
+int net_accept(int listen_fd) {
+    sockaddr_storage storage;
+    socklen_t addr_len = sizeof(storage);
+    int fd = accept(listen_fd, reinterpret_cast<sockaddr *>(&storage), &addr_len);
+    if (fd < 0) {
+        return -1;
+    }
+    net_set_options(fd, storage.ss_family != AF_UNIX);
+    return fd;
+}
+
+bool net_close_socket(int fd) {
+    return fd >= 0 && close(fd) == 0;
+}
+
+bool net_wait_readable(int const * fd_buf, int fd_cnt, int timeout_ms) {
+    std::vector<pollfd> pollfd_vec(fd_cnt);
+    for (int fd_idx = 0; fd_idx < fd_cnt; fd_idx ++) {
+        pollfd_vec[fd_idx].fd = fd_buf[fd_idx];
+        pollfd_vec[fd_idx].events = POLLIN;
+        pollfd_vec[fd_idx].revents = 0;
+    }
+    return poll(pollfd_vec.data(), pollfd_vec.size(), timeout_ms) > 0;
+}
+
+static long net_send(int fd, unsigned char const * p_data, size_t size) {
+    long num_sent = send(fd, p_data, size, MSG_NOSIGNAL);
+    if (num_sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 0;
+    }
+    return num_sent;
+}
+
+// Bytes read, 0 if none are waiting, -1 on an error or the peer closing
+static long net_recv(int fd, unsigned char * p_data, size_t size) {
+    long num_received = recv(fd, p_data, size, 0);
+    if (num_received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 0;
+    }
+    return num_received == 0 ? -1 : num_received;
+}
+
+#else
+
+int net_listen(char const * addr) {
+    fprintf(stderr, "Networking is not supported on this platform\n");
+    return -1;
+}
+
+int net_connect(char const * addr) {
+    fprintf(stderr, "Networking is not supported on this platform\n");
+    return -1;
+}
+
+int net_accept(int listen_fd) {
+    return -1;
+}
+
+bool net_close_socket(int fd) {
+    return false;
+}
+
+bool net_wait_readable(int const * fd_buf, int fd_cnt, int timeout_ms) {
+    return false;
+}
+
+static long net_send(int fd, unsigned char const * p_data, size_t size) {
+    return -1;
+}
+
+static long net_recv(int fd, unsigned char * p_data, size_t size) {
+    return -1;
+}
+
+#endif
+
+bool NetConnection::open(int fd) {
+    this->close();
+    this->fd = fd;
+    this->in_pos = 0;
+    this->in_end = 0;
+    this->out_buf.clear();
+    this->out_pos = 0;
+    this->num_bytes_sent = 0;
+    this->num_bytes_received = 0;
+    return fd >= 0;
+}
+
+bool NetConnection::close() {
+    if (this->fd >= 0) {
+        net_close_socket(this->fd);
+        this->fd = -1;
+    }
+    return true;
+}
+
+bool NetConnection::flush() {
+    if (this->fd < 0) {
+        return false;
+    }
+    while (this->out_pos < this->out_buf.size()) {
+        long num_sent = net_send(this->fd, this->out_buf.data() + this->out_pos, this->out_buf.size() - this->out_pos);
+        if (num_sent < 0) {
+            this->close();
+            return false;
+        }
+        if (num_sent == 0) {
+            break;
+        }
+        this->out_pos += num_sent;
+        this->num_bytes_sent += num_sent;
+    }
+    if (this->out_pos == this->out_buf.size()) {
+        // clear() keeps the capacity for the next message
+        this->out_buf.clear();
+        this->out_pos = 0;
+    }
+    return true;
+}
+
+bool NetConnection::receive() {
+    if (this->fd < 0) {
+        return false;
+    }
+    // drop the messages pop_msg has handed out; moving the rest down only once
+    // it is past half the buffer keeps the copying linear in the bytes received
+    if (this->in_pos == this->in_end) {
+        this->in_pos = 0;
+        this->in_end = 0;
+    }
+    else if (this->in_pos > this->in_buf.size() / 2) {
+        memmove(this->in_buf.data(), this->in_buf.data() + this->in_pos, this->in_end - this->in_pos);
+        this->in_end -= this->in_pos;
+        this->in_pos = 0;
+    }
+    while (true) {
+        if (this->in_buf.size() - this->in_end < static_cast<size_t>(NET_RECEIVE_CHUNK_SIZE)) {
+            // doubling, so the zero fill of new storage is amortized over the bytes that fill it
+            this->in_buf.resize(std::max(2 * this->in_buf.size(), this->in_end + NET_RECEIVE_CHUNK_SIZE));
+        }
+        size_t num_free = this->in_buf.size() - this->in_end;
+        long num_received = net_recv(this->fd, this->in_buf.data() + this->in_end, num_free);
+        if (num_received < 0) {
+            this->close();
+            return false;
+        }
+        this->in_end += num_received;
+        this->num_bytes_received += num_received;
+        if (static_cast<size_t>(num_received) < num_free) {
+            return true;
+        }
+    }
+}
+
+bool NetConnection::pop_msg(int & type, NetReader & reader) {
+    size_t num_available = this->in_end - this->in_pos;
+    if (num_available < NET_MSG_HEADER_SIZE) {
+        return false;
+    }
+    NetReader header_reader(this->in_buf.data() + this->in_pos, NET_MSG_HEADER_SIZE);
+    unsigned int size = 0;
+    unsigned int msg_type = 0;
+    header_reader.get_u32(size);
+    header_reader.get_u8(msg_type);
+    if (size < 1 || size > NET_MAX_MSG_SIZE) {
+        // the stream cannot be resynchronized
+        this->close();
+        return false;
+    }
+    if (num_available < 4 + size) {
+        return false;
+    }
+    type = static_cast<int>(msg_type);
+    reader = NetReader(this->in_buf.data() + this->in_pos + NET_MSG_HEADER_SIZE, size - 1);
+    this->in_pos += 4 + size;
+    return true;
+}
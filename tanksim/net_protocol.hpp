@@ -0,0 +1,255 @@
+#ifndef TANKSIM_NET_PROTOCOL_HPP
+#define TANKSIM_NET_PROTOCOL_HPP
+
+#include <stddef.h>
+#include <vector>
+
+#include "environment.hpp"
+
+// Wire protocol between tanksim_headless --serve and its clients (the game
+// with TANK_CONNECT, tanksim_bots), over TCP on localhost or a Unix domain
+// stream socket. Every message is u32 size of the rest, u8 type, payload;
+// all integers little-endian.
+//   server -> client  NET_MSG_WELCOME   u32 version, u32 tank_idx (NET_NO_TANK for a spectator),
+//                                       f32 tick_time, 6 x f32 arena bound (x, y, z min / max)
+//                     NET_MSG_SNAPSHOT  see net_encode_snapshot
+//   client -> server  NET_MSG_ACTION    f32 turn_angle_xy, f32 advance_dist, u8 is_firing;
+//                                       held until the next one, a shot fires once; the
+//                                       server clamps both f32 to NET_ACTION_MAX and drops
+//                                       a client that sends a NaN or infinity
+// Snapshots are quantized to 16 bits per field and delta-coded against the
+// previous snapshot sent on the same connection. The stream is reliable and
+// in order, so that baseline is always the one the client decoded last and
+// no acks are needed.
+#define NET_PROTOCOL_VERSION                (2u)
+#define NET_MSG_WELCOME                     (1)
+#define NET_MSG_SNAPSHOT                    (2)
+#define NET_MSG_ACTION                      (3)
+#define NET_MSG_HEADER_SIZE                 (5)
+#define NET_MAX_MSG_SIZE                    (64 << 20)  // larger sizes are a corrupt stream
+#define NET_NO_TANK                         (0xffffffffu)
+#define NET_NO_BASELINE                     (0xffffffffu)
+#define NET_ACTION_MAX                      (1.0f)      // the range keyboard, script and bot actions use
+
+// RenderSnapshot_s lists, in wire order
+#define NET_LIST_OBST                       (0)
+#define NET_LIST_TANK                       (1)
+#define NET_LIST_AMMO                       (2)
+#define NET_LIST_RAIN                       (3)
+#define NET_LIST_NUM                        (4)
+
+// RenderSphere_s quantized: positions to 1/65535 of the arena extent, scale
+// to 1/256, angles to 1/65536 turn
+#define NET_FLAG_IS_HIT                     (0x1)
+#define NET_FLAG_IS_ALIVE                   (0x2)
+#define NET_SCALE_STEPS                     (256.0f)
+
+typedef struct NetSphere_s {
+    unsigned short x;
+    unsigned short y;
+    unsigned short z;
+    unsigned short scale;
+    unsigned short angle_xy;
+    unsigned short angle_z;
+    unsigned char flags;
+} NetSphere_s;
+
+typedef struct NetSnapshot_s {
+    unsigned long tick_idx;
+    std::vector<NetSphere_s> list_vec[NET_LIST_NUM];
+} NetSnapshot_s;
+
+// Appends little-endian values to a byte vector
+class NetWriter {
+    std::vector<unsigned char> & buf;
+
+    public:
+    explicit NetWriter(std::vector<unsigned char> & buf) : buf(buf) {}
+
+    size_t get_size() const {
+        return this->buf.size();
+    }
+    bool put_u8(unsigned int value) {
+        this->buf.push_back(static_cast<unsigned char>(value));
+        return true;
+    }
+    bool put_u16(unsigned int value) {
+        this->put_u8(value & 0xff);
+        return this->put_u8((value >> 8) & 0xff);
+    }
+    bool put_u32(unsigned int value) {
+        this->put_u16(value & 0xffff);
+        return this->put_u16((value >> 16) & 0xffff);
+    }
+    bool put_u64(unsigned long long value) {
+        this->put_u32(static_cast<unsigned int>(value & 0xffffffffull));
+        return this->put_u32(static_cast<unsigned int>(value >> 32));
+    }
+    bool put_f32(float value);
+    bool put_bytes(unsigned char const * p_data, size_t size) {
+        this->buf.insert(this->buf.end(), p_data, p_data + size);
+        return true;
+    }
+    // 7 bits per byte, high bit set on all but the last
+    bool put_varint(unsigned int value) {
+        while (value >= 0x80) {
+            this->put_u8((value & 0x7f) | 0x80);
+            value >>= 7;
+        }
+        return this->put_u8(value);
+    }
+    // Starts a message, returns where its size goes for end_msg
+    size_t begin_msg(int type) {
+        size_t size_pos = this->buf.size();
+        this->put_u32(0);
+        this->put_u8(type);
+        return size_pos;
+    }
+    bool end_msg(size_t size_pos);
+};
+
+// Reads little-endian values from a byte range; every getter returns false,
+// and leaves the reader failed, once it would read past the end
+class NetReader {
+    unsigned char const * p_data;
+    size_t size;
+    size_t pos;
+
+    public:
+    NetReader() : p_data{NULL}, size{0}, pos{0} {}
+    NetReader(unsigned char const * p_data, size_t size) : p_data{p_data}, size{size}, pos{0} {}
+
+    bool get_is_at_end() const {
+        return this->pos == this->size;
+    }
+    size_t get_num_left() const {
+        return this->pos < this->size ? this->size - this->pos : 0;
+    }
+    bool get_u8(unsigned int & value) {
+        if (this->pos >= this->size) {
+            this->pos = this->size + 1;
+            return false;
+        }
+        value = this->p_data[this->pos ++];
+        return true;
+    }
+    bool get_u16(unsigned int & value) {
+        unsigned int lo = 0, hi = 0;
+        if (this->get_u8(lo) == false || this->get_u8(hi) == false) {
+            return false;
+        }
+        value = lo | (hi << 8);
+        return true;
+    }
+    bool get_u32(unsigned int & value) {
+        unsigned int lo = 0, hi = 0;
+        if (this->get_u16(lo) == false || this->get_u16(hi) == false) {
+            return false;
+        }
+        value = lo | (hi << 16);
+        return true;
+    }
+    bool get_u64(unsigned long long & value) {
+        unsigned int lo = 0, hi = 0;
+        if (this->get_u32(lo) == false || this->get_u32(hi) == false) {
+            return false;
+        }
+        value = static_cast<unsigned long long>(lo) | (static_cast<unsigned long long>(hi) << 32);
+        return true;
+    }
+    bool get_f32(float & value);
+    bool get_varint(unsigned int & value) {
+        value = 0;
+        for (int shift = 0; shift < 35; shift += 7) {
+            unsigned int byte = 0;
+            if (this->get_u8(byte) == false) {
+                return false;
+            }
+            value |= (byte & 0x7f) << shift;
+            if ((byte & 0x80) == 0) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+bool net_quantize_snapshot(RenderSnapshot_s const & render_snapshot, Bound_s const & bound, NetSnapshot_s & snapshot);
+bool net_dequantize_snapshot(NetSnapshot_s const & snapshot, Bound_s const & bound, RenderSnapshot_s & render_snapshot);
+// FNV-1a over the quantized fields, sent with every snapshot so a client can check its decode
+unsigned long long net_get_snapshot_hash(NetSnapshot_s const & snapshot);
+
+// Snapshot payload: u32 tick_idx, u32 baseline tick_idx (NET_NO_BASELINE for
+// a key frame), u64 hash, then per list: varint count, varint number of
+// entries that differ from the baseline entry of the same index or lie past
+// its end, and for each of those varint index gap since the previous one
+// (at least two bytes per entry, which bounds the count), u8 mask of changed fields (x, y, z, scale, angle_xy,
+// angle_z, flags from bit 0 up) and the changed fields, u16 each, flags u8.
+bool net_encode_snapshot(NetSnapshot_s const & snapshot, NetSnapshot_s const * p_baseline, NetWriter & writer);
+// Fails if the payload names a baseline other than p_baseline, is malformed, or the hash does not match
+bool net_decode_snapshot(NetReader & reader, NetSnapshot_s const * p_baseline, NetSnapshot_s & snapshot);
+
+// Addresses are "unix:/path/to.sock" or "[host:]port", host defaulting to
+// 127.0.0.1. Both return a socket or -1 after printing why.
+int net_listen(char const * addr);
+int net_connect(char const * addr);
+// Next pending connection on a listening socket, -1 if none
+int net_accept(int listen_fd);
+bool net_close_socket(int fd);
+// Waits until one of the sockets is readable or timeout_ms passes
+bool net_wait_readable(int const * fd_buf, int fd_cnt, int timeout_ms);
+
+// Non-blocking message stream over one connected socket. Outgoing messages
+// are built in place with get_writer() and go out on flush(); whatever the
+// socket does not take stays queued. Incoming bytes are collected by
+// receive() and split into messages by pop_msg().
+class NetConnection {
+    int fd;
+    std::vector<unsigned char> in_buf;              // storage only, its size is the capacity
+    size_t in_pos;                                  // start of the first unread message
+    size_t in_end;                                  // end of the bytes received
+    std::vector<unsigned char> out_buf;
+    size_t out_pos;                                 // start of the first unsent byte
+    unsigned long long num_bytes_sent;
+    unsigned long long num_bytes_received;
+
+    NetConnection(NetConnection const &);
+    NetConnection & operator=(NetConnection const &);
+
+    public:
+    NetConnection() : fd{-1}, in_pos{0}, in_end{0}, out_pos{0}, num_bytes_sent{0}, num_bytes_received{0} {}
+    ~NetConnection() {
+        this->close();
+    }
+
+    // Takes ownership of a connected socket
+    bool open(int fd);
+    bool close();
+    bool get_is_open() const {
+        return this->fd >= 0;
+    }
+    int get_fd() const {
+        return this->fd;
+    }
+    NetWriter get_writer() {
+        return NetWriter(this->out_buf);
+    }
+    // Bytes written but not yet taken by the socket
+    size_t get_num_queued() const {
+        return this->out_buf.size() - this->out_pos;
+    }
+    unsigned long long get_num_bytes_sent() const {
+        return this->num_bytes_sent;
+    }
+    unsigned long long get_num_bytes_received() const {
+        return this->num_bytes_received;
+    }
+
+    // Both close the connection and return false on an error or, for receive, the peer closing
+    bool flush();
+    bool receive();
+    // Next complete message; reader stays valid until the next receive()
+    bool pop_msg(int & type, NetReader & reader);
+};
+
+#endif
@@ -0,0 +1,264 @@
+#include <stdio.h>
+#include <cmath>
+#include <algorithm>
+
+#include "net_server.hpp"
+#include "profiler.hpp"
+
+NetServer::NetServer(TankInputSource * p_fallback) :
+    p_fallback{p_fallback},
+    listen_fd{-1},
+    tick_time{0.0f},
+    num_encodings{0},
+    num_ticks{0},
+    num_key_frames{0},
+    num_skipped{0},
+    num_joined{0},
+    num_left{0},
+    num_client_ticks{0},
+    num_bytes{0}
+{
+    for (int baseline_idx = 0; baseline_idx < NET_SERVER_NUM_BASELINES; baseline_idx ++) {
+        this->baseline_vec[baseline_idx].tick_idx = 0;
+    }
+}
+
+NetServer::~NetServer() {
+    this->close();
+}
+
+bool NetServer::open(char const * addr, Environment_s const & env) {
+    this->close();
+    this->listen_fd = net_listen(addr);
+    if (this->listen_fd < 0) {
+        return false;
+    }
+    this->bound = env.scenario.bound;
+    this->tick_time = env.tick_time;
+    this->tank_client_vec.assign(env.tank_vec.size(), -1);
+    return true;
+}
+
+bool NetServer::close() {
+    for (int client_idx = 0; client_idx < this->client_vec.size(); client_idx ++) {
+        delete this->client_vec[client_idx];
+    }
+    this->client_vec.clear();
+    std::fill(this->tank_client_vec.begin(), this->tank_client_vec.end(), -1);
+    if (this->listen_fd >= 0) {
+        net_close_socket(this->listen_fd);
+        this->listen_fd = -1;
+    }
+    return true;
+}
+
+int NetServer::get_num_clients() const {
+    int num_clients = 0;
+    for (int client_idx = 0; client_idx < this->client_vec.size(); client_idx ++) {
+        num_clients += this->client_vec[client_idx] != NULL ? 1 : 0;
+    }
+    return num_clients;
+}
+
+bool NetServer::accept_clients() {
+    int fd = net_accept(this->listen_fd);
+    while (fd >= 0) {
+        Client_s * p_client = new Client_s;
+        p_client->conn.open(fd);
+        p_client->tank_idx = -1;
+        p_client->tank_act.turn_angle_xy = 0.0f;
+        p_client->tank_act.advance_dist = 0.0f;
+        p_client->tank_act.is_firing = 0;
+        p_client->is_fire_pending = 0;
+        p_client->baseline_tick_idx = -1;
+
+        // reuse a slot a client left
+        int client_idx = static_cast<int>(std::find(this->client_vec.begin(), this->client_vec.end(), static_cast<Client_s *>(NULL)) - this->client_vec.begin());
+        if (client_idx == this->client_vec.size()) {
+            this->client_vec.push_back(NULL);
+        }
+        this->client_vec[client_idx] = p_client;
+        std::vector<int>::iterator free_it = std::find(this->tank_client_vec.begin(), this->tank_client_vec.end(), -1);
+        if (free_it != this->tank_client_vec.end()) {
+            *free_it = client_idx;
+            p_client->tank_idx = static_cast<int>(free_it - this->tank_client_vec.begin());
+        }
+
+        NetWriter writer = p_client->conn.get_writer();
+        size_t size_pos = writer.begin_msg(NET_MSG_WELCOME);
+        writer.put_u32(NET_PROTOCOL_VERSION);
+        writer.put_u32(p_client->tank_idx >= 0 ? static_cast<unsigned int>(p_client->tank_idx) : NET_NO_TANK);
+        writer.put_f32(this->tick_time);
+        writer.put_f32(this->bound.x_min);
+        writer.put_f32(this->bound.x_max);
+        writer.put_f32(this->bound.y_min);
+        writer.put_f32(this->bound.y_max);
+        writer.put_f32(this->bound.z_min);
+        writer.put_f32(this->bound.z_max);
+        writer.end_msg(size_pos);
+        p_client->conn.flush();
+        this->num_joined ++;
+
+        fd = net_accept(this->listen_fd);
+    }
+    return true;
+}
+
+bool NetServer::drop_client(int client_idx) {
+    Client_s * p_client = this->client_vec[client_idx];
+    if (p_client->tank_idx >= 0) {
+        this->tank_client_vec[p_client->tank_idx] = -1;
+    }
+    delete p_client;
+    this->client_vec[client_idx] = NULL;
+    this->num_left ++;
+    return true;
+}
+
+bool NetServer::read_client(Client_s & client) {
+    if (client.conn.receive() == false) {
+        return false;
+    }
+    int type = 0;
+    NetReader reader;
+    while (client.conn.pop_msg(type, reader)) {
+        if (type != NET_MSG_ACTION) {
+            continue;
+        }
+        TankAction_s tank_act;
+        unsigned int is_firing = 0;
+        if (reader.get_f32(tank_act.turn_angle_xy) && reader.get_f32(tank_act.advance_dist) && reader.get_u8(is_firing)) {
+            // the sim trusts its actions, a NaN would reach the spatial grid as a position
+            if (std::isfinite(tank_act.turn_angle_xy) == false || std::isfinite(tank_act.advance_dist) == false) {
+                client.conn.close();
+                return false;
+            }
+            tank_act.turn_angle_xy = std::min(std::max(tank_act.turn_angle_xy, -NET_ACTION_MAX), NET_ACTION_MAX);
+            tank_act.advance_dist = std::min(std::max(tank_act.advance_dist, -NET_ACTION_MAX), NET_ACTION_MAX);
+            client.tank_act = tank_act;
+            client.is_fire_pending |= is_firing ? 1 : 0;
+        }
+    }
+    return client.conn.get_is_open();
+}
+
+bool NetServer::poll() {
+    if (this->listen_fd < 0) {
+        return false;
+    }
+    this->accept_clients();
+    for (int client_idx = 0; client_idx < this->client_vec.size(); client_idx ++) {
+        if (this->client_vec[client_idx] != NULL && this->read_client(*this->client_vec[client_idx]) == false) {
+            this->drop_client(client_idx);
+        }
+    }
+    return true;
+}
+
+bool NetServer::begin_tick(float delta_time) {
+    this->poll();
+    if (this->p_fallback != NULL) {
+        return this->p_fallback->begin_tick(delta_time);
+    }
+    return true;
+}
+
+bool NetServer::get_tank_act(TankAction_s & tank_act, int tank_idx, float delta_time) {
+    int client_idx = tank_idx >= 0 && tank_idx < this->tank_client_vec.size() ? this->tank_client_vec[tank_idx] : -1;
+    if (client_idx < 0) {
+        return this->p_fallback != NULL && this->p_fallback->get_tank_act(tank_act, tank_idx, delta_time);
+    }
+    Client_s & client = *this->client_vec[client_idx];
+    tank_act = client.tank_act;
+    tank_act.is_firing = client.is_fire_pending;
+    client.is_fire_pending = 0;
+    return true;
+}
+
+bool NetServer::broadcast(Environment_s const & env) {
+    if (this->listen_fd < 0) {
+        return false;
+    }
+    unsigned long long start_ns = prof_get_ns();
+    long tick_idx = static_cast<long>(env.tick_idx);
+    env_fill_render_snapshot(env, this->render_snapshot);
+    NetSnapshot_s & snapshot = this->baseline_vec[env.tick_idx % NET_SERVER_NUM_BASELINES];
+    net_quantize_snapshot(this->render_snapshot, this->bound, snapshot);
+    unsigned long long quantize_end_ns = prof_get_ns();
+
+    this->num_encodings = 0;
+    unsigned long long encode_ns = 0;
+    for (int client_idx = 0; client_idx < this->client_vec.size(); client_idx ++) {
+        Client_s * p_client = this->client_vec[client_idx];
+        if (p_client == NULL) {
+            continue;
+        }
+        this->num_client_ticks ++;
+        if (p_client->conn.flush() == false) {
+            this->drop_client(client_idx);
+            continue;
+        }
+        if (p_client->conn.get_num_queued() > 0) {
+            this->num_skipped ++;
+            continue;
+        }
+
+        // a baseline that has rotated out of the ring means a key frame
+        long baseline_tick_idx = p_client->baseline_tick_idx;
+        if (baseline_tick_idx >= 0 && (baseline_tick_idx + NET_SERVER_NUM_BASELINES <= tick_idx || baseline_tick_idx >= tick_idx)) {
+            baseline_tick_idx = -1;
+        }
+        int encoding_idx = 0;
+        while (encoding_idx < this->num_encodings && this->encoding_vec[encoding_idx].baseline_tick_idx != baseline_tick_idx) {
+            encoding_idx ++;
+        }
+        if (encoding_idx == this->num_encodings) {
+            unsigned long long encode_start_ns = prof_get_ns();
+            if (this->num_encodings == this->encoding_vec.size()) {
+                this->encoding_vec.push_back(Encoding_s());
+            }
+            Encoding_s & encoding = this->encoding_vec[this->num_encodings ++];
+            encoding.baseline_tick_idx = baseline_tick_idx;
+            encoding.byte_vec.clear();
+            NetWriter writer(encoding.byte_vec);
+            size_t size_pos = writer.begin_msg(NET_MSG_SNAPSHOT);
+            net_encode_snapshot(snapshot, baseline_tick_idx >= 0 ? &this->baseline_vec[baseline_tick_idx % NET_SERVER_NUM_BASELINES] : NULL, writer);
+            writer.end_msg(size_pos);
+            encode_ns += prof_get_ns() - encode_start_ns;
+        }
+
+        std::vector<unsigned char> const & byte_vec = this->encoding_vec[encoding_idx].byte_vec;
+        p_client->conn.get_writer().put_bytes(byte_vec.data(), byte_vec.size());
+        this->msg_size_hist.add(byte_vec.size());
+        this->num_bytes += byte_vec.size();
+        this->num_key_frames += baseline_tick_idx < 0 ? 1 : 0;
+        p_client->baseline_tick_idx = tick_idx;
+        if (p_client->conn.flush() == false) {
+            this->drop_client(client_idx);
+        }
+    }
+    unsigned long long end_ns = prof_get_ns();
+
+    this->quantize_hist.add(quantize_end_ns - start_ns);
+    this->encode_hist.add(encode_ns);
+    this->send_hist.add(end_ns - quantize_end_ns - encode_ns);
+    this->num_ticks ++;
+    return true;
+}
+
+bool NetServer::print_stats(FILE * file) const {
+    fprintf(file, "server: %lu ticks, %lu clients joined, %lu left, %d connected\n", this->num_ticks, this->num_joined, this->num_left, this->get_num_clients());
+    fprintf(file, "%-10s %10s %10s %10s %10s\n", "per tick", "mean us", "p50 us", "p99 us", "max us");
+    LogHistogram const * hist_vec[3] = {&this->quantize_hist, &this->encode_hist, &this->send_hist};
+    char const * name_vec[3] = {"quantize", "encode", "send"};
+    for (int hist_idx = 0; hist_idx < 3; hist_idx ++) {
+        LogHistogram const & hist = *hist_vec[hist_idx];
+        fprintf(file, "%-10s %10.2f %10.2f %10.2f %10.2f\n", name_vec[hist_idx],
+            hist.get_mean() * 1e-3, hist.get_percentile(0.5) * 1e-3, hist.get_percentile(0.99) * 1e-3, hist.get_max() * 1e-3);
+    }
+    fprintf(file, "snapshots: %llu sent, %lu key frames, %lu skipped for a full socket\n", this->msg_size_hist.get_num_samples(), this->num_key_frames, this->num_skipped);
+    fprintf(file, "bytes per snapshot: mean %.1f, p50 < %llu, p99 < %llu, max %llu\n",
+        this->msg_size_hist.get_mean(), this->msg_size_hist.get_percentile(0.5), this->msg_size_hist.get_percentile(0.99), this->msg_size_hist.get_max());
+    fprintf(file, "bytes per client per tick: %.1f\n", this->num_client_ticks > 0 ? static_cast<double>(this->num_bytes) / this->num_client_ticks : 0.0);
+    return true;
+}
@@ -0,0 +1,87 @@
+#ifndef TANKSIM_NET_SERVER_HPP
+#define TANKSIM_NET_SERVER_HPP
+
+#include <stdio.h>
+#include <vector>
+
+#include <common/log_histogram.hpp>
+
+#include "environment.hpp"
+#include "net_protocol.hpp"
+
+// Authoritative server side of net_protocol.hpp. As the TankInputSource of
+// the sim it accepts clients and reads their actions at the start of every
+// tick; broadcast() then sends every client the new state. A client drives the
+// lowest tank no other client has, or watches if all are taken; tanks without
+// a client are left to the fallback source, if any.
+// A client whose socket still holds unsent bytes skips ticks until it drains,
+// so a slow reader gets fewer, larger deltas instead of a growing backlog.
+class NetServer : public TankInputSource {
+    #define NET_SERVER_NUM_BASELINES            (32)    // snapshots kept to delta against, by tick
+
+    typedef struct Client_s {
+        NetConnection conn;
+        int tank_idx;                               // -1 for a spectator
+        TankAction_s tank_act;
+        int is_fire_pending;
+        long baseline_tick_idx;                     // last snapshot sent, -1 before the first
+    } Client_s;
+
+    // Encoded snapshot of this tick for one baseline, shared by every client on it
+    typedef struct Encoding_s {
+        long baseline_tick_idx;
+        std::vector<unsigned char> byte_vec;
+    } Encoding_s;
+
+    TankInputSource * p_fallback;
+    int listen_fd;
+    Bound_s bound;
+    float tick_time;
+    std::vector<Client_s *> client_vec;
+    std::vector<int> tank_client_vec;               // client index driving each tank, -1 if none
+
+    RenderSnapshot_s render_snapshot;
+    NetSnapshot_s baseline_vec[NET_SERVER_NUM_BASELINES];
+    std::vector<Encoding_s> encoding_vec;
+    int num_encodings;
+
+    // per-tick costs in ns and per-message sizes in bytes
+    LogHistogram quantize_hist;
+    LogHistogram encode_hist;
+    LogHistogram send_hist;
+    LogHistogram msg_size_hist;
+    unsigned long num_ticks;
+    unsigned long num_key_frames;
+    unsigned long num_skipped;
+    unsigned long num_joined;
+    unsigned long num_left;
+    unsigned long num_client_ticks;                 // clients connected, summed over ticks
+    unsigned long long num_bytes;
+
+    NetServer(NetServer const &);
+    NetServer & operator=(NetServer const &);
+
+    bool accept_clients();
+    bool drop_client(int client_idx);
+    bool read_client(Client_s & client);
+
+    public:
+    explicit NetServer(TankInputSource * p_fallback);
+    ~NetServer();
+
+    // env must already be initialized, its arena and tick time go to every client
+    bool open(char const * addr, Environment_s const & env);
+    bool close();
+    int get_num_clients() const;
+    // Accepts pending clients and reads their actions; begin_tick does this every tick
+    bool poll();
+
+    bool begin_tick(float delta_time);
+    bool get_tank_act(TankAction_s & tank_act, int tank_idx, float delta_time);
+
+    // Sends the state env_tick left to every client, call once per tick
+    bool broadcast(Environment_s const & env);
+    bool print_stats(FILE * file) const;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include <algorithm>
+
+#include "profiler.hpp"
+
+typedef struct ProfPhase_s {
+    char const * name;
+    int is_sim;         // runs on the sim thread, so the test count is its own
+} ProfPhase_s;
+
+static ProfPhase_s const g_prof_phase_vec[PROF_PHASE_NUM] = {
+    {"tick", 1},
+    {"refresh", 1},
+    {"tanks", 1},
+    {"ammo", 1},
+    {"rain", 1},
+    {"contacts", 1},
+    {"publish", 1},
+    {"controls", 0},
+};
+
+PhaseHistogram::PhaseHistogram() {
+    for (int bucket_idx = 0; bucket_idx < LOG_HISTOGRAM_NUM_BUCKETS; bucket_idx ++) {
+        this->bucket_vec[bucket_idx].store(0ull, std::memory_order_relaxed);
+    }
+    this->num_samples.store(0ull, std::memory_order_relaxed);
+    this->sum_ns.store(0ull, std::memory_order_relaxed);
+    this->max_ns.store(0ull, std::memory_order_relaxed);
+    this->num_tests.store(0ull, std::memory_order_relaxed);
+}
+
+bool PhaseHistogram::add(unsigned long long ns, unsigned long long num_tests) {
+    // single writer: plain load + store, no locked instructions
+    std::atomic<unsigned long long> & bucket = this->bucket_vec[LogHistogram::get_bucket_idx(ns)];
+    bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    this->sum_ns.store(this->sum_ns.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed);
+    this->num_tests.store(this->num_tests.load(std::memory_order_relaxed) + num_tests, std::memory_order_relaxed);
+    if (ns > this->max_ns.load(std::memory_order_relaxed)) {
+        this->max_ns.store(ns, std::memory_order_relaxed);
+    }
+    // published last, so a reader never sees more samples than bucket counts
+    this->num_samples.store(this->num_samples.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return true;
+}
+
+bool PhaseHistogram::get_snapshot(Snapshot_s & snapshot) const {
+    snapshot.num_samples = this->num_samples.load(std::memory_order_acquire);
+    for (int bucket_idx = 0; bucket_idx < LOG_HISTOGRAM_NUM_BUCKETS; bucket_idx ++) {
+        snapshot.bucket_vec[bucket_idx] = this->bucket_vec[bucket_idx].load(std::memory_order_relaxed);
+    }
+    snapshot.sum_ns = this->sum_ns.load(std::memory_order_relaxed);
+    snapshot.max_ns = this->max_ns.load(std::memory_order_relaxed);
+    snapshot.num_tests = this->num_tests.load(std::memory_order_relaxed);
+    return true;
+}
+
+unsigned long long prof_get_percentile(PhaseHistogram::Snapshot_s const & snapshot, PhaseHistogram::Snapshot_s const * p_prev_snapshot, double fraction) {
+    unsigned long long num_samples = snapshot.num_samples - (p_prev_snapshot != NULL ? p_prev_snapshot->num_samples : 0ull);
+    if (num_samples == 0) {
+        return 0ull;
+    }
+    unsigned long long rank = std::min(static_cast<unsigned long long>(fraction * num_samples), num_samples - 1);
+    unsigned long long cnt = 0;
+    for (int bucket_idx = 0; bucket_idx < LOG_HISTOGRAM_NUM_BUCKETS; bucket_idx ++) {
+        cnt += snapshot.bucket_vec[bucket_idx] - (p_prev_snapshot != NULL ? p_prev_snapshot->bucket_vec[bucket_idx] : 0ull);
+        if (cnt > rank) {
+            return std::min(LogHistogram::get_bucket_end(bucket_idx), snapshot.max_ns);
+        }
+    }
+    return snapshot.max_ns;
+}
+
+unsigned long long prof_get_ns() {
+    // steady_clock is clock_gettime(CLOCK_MONOTONIC) on Linux, a vDSO call with no syscall
+    return static_cast<unsigned long long>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+char const * prof_get_phase_name(int phase) {
+    return g_prof_phase_vec[phase].name;
+}
+
+#if defined(TANKSIM_PROFILE)
+
+static PhaseHistogram g_prof_hist_vec[PROF_PHASE_NUM];
+// what the previous windowed prof_print saw, owned by the printing thread
+static PhaseHistogram::Snapshot_s g_prof_prev_snapshot_vec[PROF_PHASE_NUM];
+static std::atomic<int> g_prof_num_threads(0);
+ProfTestSlot_s g_prof_test_slot_vec[PROF_MAX_THREADS];
+
+int prof_get_thread_slot() {
+    static thread_local int slot = -1;
+    if (slot < 0) {
+        slot = g_prof_num_threads.fetch_add(1) % PROF_MAX_THREADS;
+    }
+    return slot;
+}
+
+unsigned long long prof_get_num_tests() {
+    unsigned long long num_tests = 0;
+    for (int slot = 0; slot < PROF_MAX_THREADS; slot ++) {
+        num_tests += g_prof_test_slot_vec[slot].num_tests.load(std::memory_order_relaxed);
+    }
+    return num_tests;
+}
+
+bool prof_add_sample(int phase, unsigned long long ns, unsigned long long num_tests) {
+    return g_prof_hist_vec[phase].add(ns, g_prof_phase_vec[phase].is_sim ? num_tests : 0ull);
+}
+
+bool prof_print(FILE * file, bool is_window) {
+    fprintf(file, "%-10s %10s %10s %10s %10s %10s %10s %12s\n", "phase", "calls", "mean us", "p50 us", "p95 us", "p99 us", "max us", "tests/call");
+    PhaseHistogram::Snapshot_s snapshot;
+    for (int phase = 0; phase < PROF_PHASE_NUM; phase ++) {
+        g_prof_hist_vec[phase].get_snapshot(snapshot);
+        PhaseHistogram::Snapshot_s * p_prev_snapshot = is_window ? &g_prof_prev_snapshot_vec[phase] : NULL;
+        unsigned long long num_samples = snapshot.num_samples;
+        unsigned long long sum_ns = snapshot.sum_ns;
+        unsigned long long num_tests = snapshot.num_tests;
+        if (p_prev_snapshot != NULL) {
+            num_samples -= p_prev_snapshot->num_samples;
+            sum_ns -= p_prev_snapshot->sum_ns;
+            num_tests -= p_prev_snapshot->num_tests;
+        }
+        if (num_samples > 0) {
+            // the max cannot be subtracted, a window reports the end of its highest bucket instead
+            unsigned long long max_ns = prof_get_percentile(snapshot, p_prev_snapshot, 1.0);
+            fprintf(file, "%-10s %10llu %10.2f %10.2f %10.2f %10.2f %10.2f",
+                g_prof_phase_vec[phase].name, num_samples, sum_ns * 1e-3 / num_samples,
+                prof_get_percentile(snapshot, p_prev_snapshot, 0.5) * 1e-3, prof_get_percentile(snapshot, p_prev_snapshot, 0.95) * 1e-3,
+                prof_get_percentile(snapshot, p_prev_snapshot, 0.99) * 1e-3, max_ns * 1e-3);
+            if (g_prof_phase_vec[phase].is_sim) {
+                fprintf(file, " %12.1f\n", static_cast<double>(num_tests) / num_samples);
+            }
+            else {
+                fprintf(file, " %12s\n", "-");
+            }
+        }
+        if (is_window) {
+            g_prof_prev_snapshot_vec[phase] = snapshot;
+        }
+    }
+    return true;
+}
+
+#else
+
+unsigned long long prof_get_num_tests() {
+    return 0ull;
+}
+
+bool prof_add_sample(int, unsigned long long, unsigned long long) {
+    return false;
+}
+
+bool prof_print(FILE *, bool) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef TANKSIM_PROFILER_HPP
+#define TANKSIM_PROFILER_HPP
+
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+
+#include <common/log_histogram.hpp>
+
+// Per-phase timers for the simulation, built with -DTANKSIM_PROFILE (the
+// TANKSIM_PROFILE CMake option). Without it PROF_SCOPE and PROF_COUNT_TESTS
+// expand to nothing and the sim carries no timing code at all.
+//
+// PROF_SCOPE(phase) times the rest of the enclosing block into the histogram
+// of that phase. Every phase is timed from one thread at a time, so a
+// histogram has a single writer and needs no locks or read-modify-writes; any
+// thread may read it while it is being written.
+// PROF_COUNT_TESTS(n) counts narrowphase collision tests; a sim phase is
+// charged with every test any thread ran while it was open.
+
+#define PROF_PHASE_TICK                     (0)     // the whole env_tick
+#define PROF_PHASE_REFRESH                  (1)
+#define PROF_PHASE_TANKS                    (2)     // tank actions and moves
+#define PROF_PHASE_AMMO                     (3)
+#define PROF_PHASE_RAIN                     (4)
+#define PROF_PHASE_CONTACTS                 (5)     // tank contact solver
+#define PROF_PHASE_PUBLISH                  (6)     // render snapshot
+#define PROF_PHASE_CONTROLS                 (7)     // computeMatricesFromInputs, render thread
+#define PROF_PHASE_NUM                      (8)
+
+// Durations in ns in the buckets of LogHistogram, with atomic counters so
+// another thread can read them while the owner writes
+class PhaseHistogram {
+    std::atomic<unsigned long long> bucket_vec[LOG_HISTOGRAM_NUM_BUCKETS];
+    std::atomic<unsigned long long> num_samples;
+    std::atomic<unsigned long long> sum_ns;
+    std::atomic<unsigned long long> max_ns;
+    std::atomic<unsigned long long> num_tests;
+
+    public:
+    // Plain copy of the counters, see get_snapshot
+    typedef struct Snapshot_s {
+        unsigned long long bucket_vec[LOG_HISTOGRAM_NUM_BUCKETS];
+        unsigned long long num_samples;
+        unsigned long long sum_ns;
+        unsigned long long max_ns;
+        unsigned long long num_tests;
+    } Snapshot_s;
+
+    PhaseHistogram();
+
+    // Single writer only
+    bool add(unsigned long long ns, unsigned long long num_tests);
+    bool get_snapshot(Snapshot_s & snapshot) const;
+};
+
+// Upper edge of the bucket holding the given fraction of the samples in
+// snapshot - prev_snapshot, capped at the maximum, in ns; prev_snapshot may be NULL
+unsigned long long prof_get_percentile(PhaseHistogram::Snapshot_s const & snapshot, PhaseHistogram::Snapshot_s const * p_prev_snapshot, double fraction);
+
+unsigned long long prof_get_ns();
+char const * prof_get_phase_name(int phase);
+bool prof_add_sample(int phase, unsigned long long ns, unsigned long long num_tests);
+// Collision tests counted by all threads so far
+unsigned long long prof_get_num_tests();
+
+// Prints count, mean, p50 / p95 / p99 / max and collision tests per call of
+// every phase that ran. With is_window only the samples since the previous
+// windowed print are reported, the totals are never reset. Call from one
+// thread. Returns false, printing nothing, if profiling is compiled out.
+bool prof_print(FILE * file, bool is_window);
+
+#if defined(TANKSIM_PROFILE)
+
+#define PROF_MAX_THREADS                    (64)
+
+// Per-thread test counter on its own cache line; threads past PROF_MAX_THREADS
+// share slots and may lose counts, the timings are unaffected
+typedef struct ProfTestSlot_s {
+    std::atomic<unsigned long long> num_tests;
+    char pad[64 - sizeof(std::atomic<unsigned long long>)];
+} ProfTestSlot_s;
+
+extern ProfTestSlot_s g_prof_test_slot_vec[PROF_MAX_THREADS];
+int prof_get_thread_slot();
+
+inline bool prof_count_tests(unsigned long long num) {
+    std::atomic<unsigned long long> & num_tests = g_prof_test_slot_vec[prof_get_thread_slot()].num_tests;
+    num_tests.store(num_tests.load(std::memory_order_relaxed) + num, std::memory_order_relaxed);
+    return true;
+}
+
+class ProfScope {
+    int phase;
+    unsigned long long start_ns;
+    unsigned long long start_num_tests;
+
+    public:
+    explicit ProfScope(int phase) : phase{phase} {
+        this->start_num_tests = prof_get_num_tests();
+        this->start_ns = prof_get_ns();
+    }
+    ~ProfScope() {
+        unsigned long long end_ns = prof_get_ns();
+        prof_add_sample(this->phase, end_ns - this->start_ns, prof_get_num_tests() - this->start_num_tests);
+    }
+};
+
+#define PROF_CONCAT_IMPL(a, b)              a##b
+#define PROF_CONCAT(a, b)                   PROF_CONCAT_IMPL(a, b)
+#define PROF_SCOPE(phase)                   ProfScope PROF_CONCAT(prof_scope_, __LINE__)(phase)
+#define PROF_COUNT_TESTS(num)               prof_count_tests(num)
+
+#else
+
+#define PROF_SCOPE(phase)
+#define PROF_COUNT_TESTS(num)
+
+#endif
+
+#endif
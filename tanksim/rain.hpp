@@ -0,0 +1,175 @@
+#ifndef TANKSIM_RAIN_HPP
+#define TANKSIM_RAIN_HPP
+
+#include <vector>
+#include <algorithm>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#include <common/xoshiro.hpp>
+
+#include "sphere.hpp"
+#include "entity.hpp"
+#include "scenario.hpp"
+
+// Rain drops as packed arrays. Drops fall straight down from the top of the
+// arena and never steer, so a drop is just a position, a speed and a radius.
+// Drops are split into fixed blocks of RAIN_BLOCK_SIZE; each block owns a
+// PRNG stream and its list of spent drops, so blocks can be stepped on any
+// thread and the result does not depend on the thread count.
+class RainSystem {
+    #define RAIN_BLOCK_SIZE                     (4096)
+
+    std::vector<float> x_vec;
+    std::vector<float> y_vec;
+    std::vector<float> z_vec;
+    std::vector<float> speed_vec;
+    std::vector<float> r_vec;
+    std::vector<int> is_falling_vec;
+    std::vector<Xoshiro128> rng_vec;
+    // per block, spent drops waiting for respawn in ascending order
+    std::vector< std::vector<int> > spent_vec;
+    float max_r;
+
+    public:
+    RainSystem() : max_r{0.0f} {}
+
+    // All drops start spent and are spawned by the first respawn
+    bool init(Scenario_s const & scenario) {
+        int num = scenario.num_rain;
+        this->x_vec.assign(num, 0.0f);
+        this->y_vec.assign(num, 0.0f);
+        this->z_vec.assign(num, 0.0f);
+        this->speed_vec.assign(num, 0.0f);
+        this->r_vec.assign(num, 0.0f);
+        this->is_falling_vec.assign(num, 0);
+        int num_blocks = (num + RAIN_BLOCK_SIZE - 1) / RAIN_BLOCK_SIZE;
+        this->rng_vec.resize(num_blocks);
+        this->spent_vec.assign(num_blocks, std::vector<int>());
+        for (int block_idx = 0; block_idx < num_blocks; block_idx ++) {
+            this->rng_vec[block_idx].seed(scenario.rng_seed, block_idx);
+            for (int idx = this->get_block_begin(block_idx); idx < this->get_block_end(block_idx); idx ++) {
+                this->spent_vec[block_idx].push_back(idx);
+            }
+        }
+        this->max_r = scenario.rain_r;
+        return true;
+    }
+
+    int size() const {
+        return static_cast<int>(this->z_vec.size());
+    }
+
+    int get_num_blocks() const {
+        return static_cast<int>(this->rng_vec.size());
+    }
+
+    int get_block_begin(int block_idx) const {
+        return block_idx * RAIN_BLOCK_SIZE;
+    }
+
+    int get_block_end(int block_idx) const {
+        return std::min(this->size(), (block_idx + 1) * RAIN_BLOCK_SIZE);
+    }
+
+    float get_max_r() const {
+        return this->max_r;
+    }
+
+    float get_speed(int idx) const {
+        return this->speed_vec[idx];
+    }
+
+    bool get_is_falling(int idx) const {
+        return this->is_falling_vec[idx] != 0;
+    }
+
+    Sphere get_sphere(int idx) const {
+        return Sphere(this->x_vec[idx], this->y_vec[idx], this->z_vec[idx], this->r_vec[idx]);
+    }
+
+    // Stops the drop at height z; it is respawned at the next respawn of its block
+    bool set_spent(int idx, float z) {
+        this->z_vec[idx] = z;
+        this->is_falling_vec[idx] = 0;
+        this->spent_vec[idx / RAIN_BLOCK_SIZE].push_back(idx);
+        return true;
+    }
+
+    // Puts every spent drop of the block back at the top of the arena
+    bool respawn(int block_idx, Scenario_s const & scenario) {
+        std::vector<int> & spent = this->spent_vec[block_idx];
+        Xoshiro128 & rng = this->rng_vec[block_idx];
+        for (int spent_idx = 0; spent_idx < spent.size(); spent_idx ++) {
+            int idx = spent[spent_idx];
+            this->speed_vec[idx] = rng.next_float(scenario.rain_speed_min, scenario.rain_speed_max);
+            this->x_vec[idx] = rng.next_float(scenario.bound.x_min, scenario.bound.x_max);
+            this->y_vec[idx] = rng.next_float(scenario.bound.y_min, scenario.bound.y_max);
+            this->z_vec[idx] = scenario.bound.z_max;
+            this->r_vec[idx] = scenario.rain_r;
+            this->is_falling_vec[idx] = 1;
+        }
+        spent.clear();
+        return true;
+    }
+
+    // Moves every drop of the block down by speed * delta_time and appends
+    // those now lower than low_z to low_idx_vec, in ascending order. Every drop
+    // of the block must be falling, i.e. respawn() ran first.
+    bool fall(int block_idx, float delta_time, float low_z, std::vector<int> & low_idx_vec) {
+        float * z_buf = this->z_vec.data();
+        float const * speed_buf = this->speed_vec.data();
+        int i = this->get_block_begin(block_idx);
+        int end = this->get_block_end(block_idx);
+#if defined(__AVX2__)
+        __m256 dt_8 = _mm256_set1_ps(delta_time);
+        __m256 low_z_8 = _mm256_set1_ps(low_z);
+        for (; i + 8 <= end; i += 8) {
+            __m256 z = _mm256_sub_ps(_mm256_loadu_ps(z_buf + i), _mm256_mul_ps(_mm256_loadu_ps(speed_buf + i), dt_8));
+            _mm256_storeu_ps(z_buf + i, z);
+            unsigned int low_mask = static_cast<unsigned int>(_mm256_movemask_ps(_mm256_cmp_ps(z, low_z_8, _CMP_LT_OQ)));
+            for (int lane = 0; low_mask != 0; lane ++, low_mask >>= 1) {
+                if (low_mask & 1u) {
+                    low_idx_vec.push_back(i + lane);
+                }
+            }
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        __m128 dt_4 = _mm_set1_ps(delta_time);
+        __m128 low_z_4 = _mm_set1_ps(low_z);
+        for (; i + 4 <= end; i += 4) {
+            __m128 z = _mm_sub_ps(_mm_loadu_ps(z_buf + i), _mm_mul_ps(_mm_loadu_ps(speed_buf + i), dt_4));
+            _mm_storeu_ps(z_buf + i, z);
+            unsigned int low_mask = static_cast<unsigned int>(_mm_movemask_ps(_mm_cmplt_ps(z, low_z_4)));
+            for (int lane = 0; low_mask != 0; lane ++, low_mask >>= 1) {
+                if (low_mask & 1u) {
+                    low_idx_vec.push_back(i + lane);
+                }
+            }
+        }
+#endif
+        // scalar fallback and tail
+        for (; i < end; i ++) {
+            z_buf[i] -= speed_buf[i] * delta_time;
+            if (z_buf[i] < low_z) {
+                low_idx_vec.push_back(i);
+            }
+        }
+        return true;
+    }
+
+    bool get_render_sphere(int idx, RenderSphere_s & rs) const {
+        rs.x = this->x_vec[idx];
+        rs.y = this->y_vec[idx];
+        rs.z = this->z_vec[idx];
+        rs.scale = this->r_vec[idx] * AMMO_R_TO_SIZE_RATIO;
+        rs.angle_xy = AMMO_ROTATE_OFFS_ANGLE_XY;
+        rs.angle_z = -MY_PI_HALF;
+        rs.is_hit = 0;
+        rs.is_alive = this->is_falling_vec[idx];
+        return true;
+    }
+};
+
+#endif
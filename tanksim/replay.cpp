@@ -0,0 +1,105 @@
+#include <stdio.h>
+
+#include "replay.hpp"
+
+bool RecordingTankInputSource::open(char const * path, Environment_s const & env, TankInputSource * p_src) {
+    this->close();
+    this->file = fopen(path, "wb");
+    if (this->file == NULL) {
+        fprintf(stderr, "Failed to open %s for recording\n", path);
+        return false;
+    }
+    this->p_src = p_src;
+
+    ReplayHeader_s header;
+    header.magic = REPLAY_MAGIC;
+    header.version = REPLAY_VERSION;
+    header.rng_seed = env.scenario.rng_seed;
+    header.num_tanks = static_cast<unsigned int>(env.tank_vec.size());
+    header.tick_time = env.tick_time;
+    fwrite(&header.magic, sizeof(header.magic), 1, this->file);
+    fwrite(&header.version, sizeof(header.version), 1, this->file);
+    fwrite(&header.rng_seed, sizeof(header.rng_seed), 1, this->file);
+    fwrite(&header.num_tanks, sizeof(header.num_tanks), 1, this->file);
+    fwrite(&header.tick_time, sizeof(header.tick_time), 1, this->file);
+    return true;
+}
+
+bool RecordingTankInputSource::close() {
+    if (this->file != NULL) {
+        fclose(this->file);
+        this->file = NULL;
+    }
+    return true;
+}
+
+bool RecordingTankInputSource::begin_tick(float delta_time) {
+    if (this->p_src != NULL) {
+        return this->p_src->begin_tick(delta_time);
+    }
+    return true;
+}
+
+bool RecordingTankInputSource::get_tank_act(TankAction_s & tank_act, int tank_idx, float delta_time) {
+    bool is_valid = this->p_src != NULL && this->p_src->get_tank_act(tank_act, tank_idx, delta_time);
+    if (is_valid == false) {
+        tank_act.turn_angle_xy = 0.0f;
+        tank_act.advance_dist = 0.0f;
+        tank_act.is_firing = 0;
+    }
+    if (this->file != NULL) {
+        unsigned char is_firing = tank_act.is_firing ? 1 : 0;
+        fwrite(&tank_act.turn_angle_xy, sizeof(tank_act.turn_angle_xy), 1, this->file);
+        fwrite(&tank_act.advance_dist, sizeof(tank_act.advance_dist), 1, this->file);
+        fwrite(&is_firing, sizeof(is_firing), 1, this->file);
+    }
+    return true;
+}
+
+bool ReplayTankInputSource::load(char const * path) {
+    FILE * file = fopen(path, "rb");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open replay %s\n", path);
+        return false;
+    }
+    bool is_header_read =
+        fread(&this->header.magic, sizeof(this->header.magic), 1, file) == 1 &&
+        fread(&this->header.version, sizeof(this->header.version), 1, file) == 1 &&
+        fread(&this->header.rng_seed, sizeof(this->header.rng_seed), 1, file) == 1 &&
+        fread(&this->header.num_tanks, sizeof(this->header.num_tanks), 1, file) == 1 &&
+        fread(&this->header.tick_time, sizeof(this->header.tick_time), 1, file) == 1;
+    if (is_header_read == false || this->header.magic != REPLAY_MAGIC || this->header.version != REPLAY_VERSION) {
+        fprintf(stderr, "%s is not a version %u replay\n", path, REPLAY_VERSION);
+        fclose(file);
+        return false;
+    }
+
+    this->act_vec.clear();
+    TankAction_s tank_act;
+    unsigned char is_firing = 0;
+    while (fread(&tank_act.turn_angle_xy, sizeof(tank_act.turn_angle_xy), 1, file) == 1 &&
+           fread(&tank_act.advance_dist, sizeof(tank_act.advance_dist), 1, file) == 1 &&
+           fread(&is_firing, sizeof(is_firing), 1, file) == 1) {
+        tank_act.is_firing = is_firing;
+        this->act_vec.push_back(tank_act);
+    }
+    fclose(file);
+
+    // drop a partly written last tick
+    this->act_vec.resize(this->get_num_ticks() * this->header.num_tanks);
+    this->tick_cursor = -1;
+    return true;
+}
+
+bool ReplayTankInputSource::begin_tick(float delta_time) {
+    this->tick_cursor ++;
+    return this->tick_cursor < this->get_num_ticks();
+}
+
+bool ReplayTankInputSource::get_tank_act(TankAction_s & tank_act, int tank_idx, float delta_time) {
+    if (this->tick_cursor < 0 || this->tick_cursor >= this->get_num_ticks() || tank_idx < 0 || tank_idx >= this->header.num_tanks) {
+        return false;
+    }
+    tank_act = this->act_vec[this->tick_cursor * this->header.num_tanks + tank_idx];
+    return true;
+}
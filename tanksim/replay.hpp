@@ -0,0 +1,65 @@
+#ifndef TANKSIM_REPLAY_HPP
+#define TANKSIM_REPLAY_HPP
+
+#include <stdio.h>
+#include <vector>
+
+#include "environment.hpp"
+
+// Replay file layout, native byte order:
+//   header:  u32 magic, u32 version, u32 rng_seed, u32 num_tanks, f32 tick_time
+//   records: one per tank per tick, in tank order: f32 turn_angle_xy, f32 advance_dist, u8 is_firing
+// Records are appended as the sim runs, so a file cut short by a crash still
+// replays up to its last complete tick.
+#define REPLAY_MAGIC                        (0x524b4e54u)   // "TNKR"
+#define REPLAY_VERSION                      (1u)
+#define REPLAY_RECORD_SIZE                  (9)
+
+typedef struct ReplayHeader_s {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int rng_seed;
+    unsigned int num_tanks;
+    float tick_time;
+} ReplayHeader_s;
+
+// Wraps the live input source and appends every action it hands to the sim.
+// Actions the source declines are recorded as the idle action env_tick uses.
+class RecordingTankInputSource : public TankInputSource {
+    TankInputSource * p_src;
+    FILE * file;
+
+    public:
+    RecordingTankInputSource() : p_src{NULL}, file{NULL} {}
+    ~RecordingTankInputSource() {
+        this->close();
+    }
+
+    // env must already be initialized, its seed, tick rate and tank count go in the header
+    bool open(char const * path, Environment_s const & env, TankInputSource * p_src);
+    bool close();
+    bool begin_tick(float delta_time);
+    bool get_tank_act(TankAction_s & tank_act, int tank_idx, float delta_time);
+};
+
+// Feeds a recorded session back, one tick of actions per begin_tick
+class ReplayTankInputSource : public TankInputSource {
+    ReplayHeader_s header;
+    std::vector<TankAction_s> act_vec;
+    long tick_cursor;
+
+    public:
+    ReplayTankInputSource() : tick_cursor{-1} {}
+
+    bool load(char const * path);
+    ReplayHeader_s const & get_header() const {
+        return this->header;
+    }
+    long get_num_ticks() const {
+        return this->header.num_tanks > 0 ? static_cast<long>(this->act_vec.size() / this->header.num_tanks) : 0;
+    }
+    bool begin_tick(float delta_time);
+    bool get_tank_act(TankAction_s & tank_act, int tank_idx, float delta_time);
+};
+
+#endif
@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <cstddef>
+
+#include "scenario.hpp"
+
+#define SCENARIO_FIELD_INT                  (0)
+#define SCENARIO_FIELD_UINT                 (1)
+#define SCENARIO_FIELD_FLOAT                (2)
+#define SCENARIO_FIELD_SPAWN                (3)
+
+typedef struct ScenarioField_s {
+    char const * name;
+    int type;
+    size_t offset;
+} ScenarioField_s;
+
+static ScenarioField_s const g_scenario_field_vec[] = {
+    {"bound_x_min",         SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, bound) + offsetof(Bound_s, x_min)},
+    {"bound_x_max",         SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, bound) + offsetof(Bound_s, x_max)},
+    {"bound_y_min",         SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, bound) + offsetof(Bound_s, y_min)},
+    {"bound_y_max",         SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, bound) + offsetof(Bound_s, y_max)},
+    {"bound_z_min",         SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, bound) + offsetof(Bound_s, z_min)},
+    {"bound_z_max",         SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, bound) + offsetof(Bound_s, z_max)},
+    {"rng_seed",            SCENARIO_FIELD_UINT,    offsetof(Scenario_s, rng_seed)},
+    {"num_obst",            SCENARIO_FIELD_INT,     offsetof(Scenario_s, num_obst)},
+    {"obst_r",              SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, obst_r)},
+    {"obst_spawn",          SCENARIO_FIELD_SPAWN,   offsetof(Scenario_s, obst_spawn)},
+    {"num_obst_cluster",    SCENARIO_FIELD_INT,     offsetof(Scenario_s, num_obst_cluster)},
+    {"obst_cluster_r",      SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, obst_cluster_r)},
+    {"num_tank",            SCENARIO_FIELD_INT,     offsetof(Scenario_s, num_tank)},
+    {"tank_r",              SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, tank_r)},
+    {"tank_spawn",          SCENARIO_FIELD_SPAWN,   offsetof(Scenario_s, tank_spawn)},
+    {"num_rain",            SCENARIO_FIELD_INT,     offsetof(Scenario_s, num_rain)},
+    {"rain_r",              SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, rain_r)},
+    {"rain_speed_min",      SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, rain_speed_min)},
+    {"rain_speed_max",      SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, rain_speed_max)},
+    {"bot_phase_time",      SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, bot_phase_time)},
+    {"bot_fire_time",       SCENARIO_FIELD_FLOAT,   offsetof(Scenario_s, bot_fire_time)},
+    {"ammo_pool_capacity",  SCENARIO_FIELD_INT,     offsetof(Scenario_s, ammo_pool_capacity)},
+    {"place_max_try",       SCENARIO_FIELD_INT,     offsetof(Scenario_s, place_max_try)},
+};
+#define SCENARIO_NUM_FIELDS                 (static_cast<int>(sizeof(g_scenario_field_vec) / sizeof(g_scenario_field_vec[0])))
+
+static char const * const g_scenario_spawn_name_vec[] = {"legacy", "uniform", "clustered"};
+
+bool scenario_set_default(Scenario_s & scenario) {
+    scenario.bound.x_min = BOUND_X_MIN;
+    scenario.bound.x_max = BOUND_X_MAX;
+    scenario.bound.y_min = BOUND_Y_MIN;
+    scenario.bound.y_max = BOUND_Y_MAX;
+    scenario.bound.z_min = BOUND_Z_MIN;
+    scenario.bound.z_max = BOUND_Z_MAX;
+    scenario.rng_seed = 0u;
+
+    scenario.num_obst = 20;
+    scenario.obst_r = 1.0f;
+    scenario.obst_spawn = SCENARIO_SPAWN_LEGACY;
+    scenario.num_obst_cluster = 8;
+    scenario.obst_cluster_r = 5.0f;
+
+    scenario.num_tank = 2;
+    scenario.tank_r = 2.0f;
+    scenario.tank_spawn = SCENARIO_SPAWN_LEGACY;
+
+    scenario.num_rain = 20;
+    scenario.rain_r = 0.5f;
+    scenario.rain_speed_min = 1.0f;
+    scenario.rain_speed_max = 5.0f;
+
+    scenario.bot_phase_time = 1.0f;
+    scenario.bot_fire_time = 0.25f;
+
+    scenario.ammo_pool_capacity = 1024;
+    scenario.place_max_try = 30;
+    return true;
+}
+
+bool scenario_set_preset(Scenario_s & scenario, char const * name) {
+    scenario_set_default(scenario);
+    if (strcmp(name, "default") == 0) {
+        return true;
+    }
+    if (strcmp(name, "stress") == 0) {
+        scenario.bound.x_min = -500.0f;
+        scenario.bound.x_max = 500.0f;
+        scenario.bound.y_min = -500.0f;
+        scenario.bound.y_max = 500.0f;
+        scenario.num_obst = 10000;
+        scenario.obst_spawn = SCENARIO_SPAWN_CLUSTERED;
+        scenario.num_obst_cluster = 200;
+        scenario.obst_cluster_r = 20.0f;
+        scenario.num_tank = 1000;
+        scenario.tank_spawn = SCENARIO_SPAWN_UNIFORM;
+        scenario.num_rain = 50000;
+        scenario.ammo_pool_capacity = 65536;
+        return true;
+    }
+    fprintf(stderr, "Unknown scenario preset %s\n", name);
+    return false;
+}
+
+static bool scenario_parse_spawn(char const * value, int & spawn) {
+    for (int spawn_idx = 0; spawn_idx < 3; spawn_idx ++) {
+        if (strcmp(value, g_scenario_spawn_name_vec[spawn_idx]) == 0) {
+            spawn = spawn_idx;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool scenario_validate(Scenario_s const & scenario) {
+    bool is_valid = true;
+    Bound_s const & bound = scenario.bound;
+    if (!(bound.x_min < bound.x_max) || !(bound.y_min < bound.y_max) || !(bound.z_min < bound.z_max)) {
+        fprintf(stderr, "Scenario bound is empty: x %g..%g, y %g..%g, z %g..%g\n", bound.x_min, bound.x_max, bound.y_min, bound.y_max, bound.z_min, bound.z_max);
+        is_valid = false;
+    }
+    if (scenario.num_obst < 0 || scenario.num_obst_cluster < 0 || scenario.num_tank < 0 || scenario.num_rain < 0) {
+        fprintf(stderr, "Scenario counts must not be negative: num_obst %d, num_obst_cluster %d, num_tank %d, num_rain %d\n",
+            scenario.num_obst, scenario.num_obst_cluster, scenario.num_tank, scenario.num_rain);
+        is_valid = false;
+    }
+    if (scenario.ammo_pool_capacity < 1 || scenario.place_max_try < 1) {
+        fprintf(stderr, "Scenario ammo_pool_capacity %d and place_max_try %d must be at least 1\n", scenario.ammo_pool_capacity, scenario.place_max_try);
+        is_valid = false;
+    }
+    if (!(scenario.obst_r > 0.0f) || !(scenario.obst_cluster_r > 0.0f) || !(scenario.tank_r > 0.0f) || !(scenario.rain_r > 0.0f)) {
+        fprintf(stderr, "Scenario radii must be positive: obst_r %g, obst_cluster_r %g, tank_r %g, rain_r %g\n",
+            scenario.obst_r, scenario.obst_cluster_r, scenario.tank_r, scenario.rain_r);
+        is_valid = false;
+    }
+    if (!(scenario.rain_speed_min <= scenario.rain_speed_max)) {
+        fprintf(stderr, "Scenario rain_speed_min %g is above rain_speed_max %g\n", scenario.rain_speed_min, scenario.rain_speed_max);
+        is_valid = false;
+    }
+    return is_valid;
+}
+
+bool scenario_set(Scenario_s & scenario, char const * assignment) {
+    char key[64];
+    char value[64];
+    // "key = value" with optional spaces, anything after the value is ignored
+    if (sscanf(assignment, " %63[^= \t] = %63s", key, value) != 2) {
+        fprintf(stderr, "Bad scenario assignment: %s\n", assignment);
+        return false;
+    }
+    for (int field_idx = 0; field_idx < SCENARIO_NUM_FIELDS; field_idx ++) {
+        ScenarioField_s const & field = g_scenario_field_vec[field_idx];
+        if (strcmp(key, field.name) != 0) {
+            continue;
+        }
+        char * p_field = reinterpret_cast<char *>(&scenario) + field.offset;
+        if (field.type == SCENARIO_FIELD_SPAWN) {
+            if (scenario_parse_spawn(value, *reinterpret_cast<int *>(p_field)) == false) {
+                fprintf(stderr, "Unknown spawn distribution %s for %s\n", value, key);
+                return false;
+            }
+            return true;
+        }
+        // the number must take the whole value, "abc" or "5x" is an error
+        char * p_end = value;
+        long int_value = 0;
+        unsigned long uint_value = 0;
+        float float_value = 0.0f;
+        if (field.type == SCENARIO_FIELD_INT) {
+            int_value = strtol(value, &p_end, 0);
+        }
+        else if (field.type == SCENARIO_FIELD_UINT) {
+            uint_value = strtoul(value, &p_end, 0);
+        }
+        else {
+            float_value = strtof(value, &p_end);
+        }
+        if (p_end == value || *p_end != '\0') {
+            fprintf(stderr, "Bad value %s for %s\n", value, key);
+            return false;
+        }
+        if (field.type == SCENARIO_FIELD_INT) {
+            *reinterpret_cast<int *>(p_field) = static_cast<int>(int_value);
+        }
+        else if (field.type == SCENARIO_FIELD_UINT) {
+            *reinterpret_cast<unsigned int *>(p_field) = static_cast<unsigned int>(uint_value);
+        }
+        else {
+            *reinterpret_cast<float *>(p_field) = float_value;
+        }
+        return true;
+    }
+    fprintf(stderr, "Unknown scenario key %s\n", key);
+    return false;
+}
+
+bool scenario_load_file(Scenario_s & scenario, char const * path) {
+    FILE * file = fopen(path, "r");
+    if (file == NULL) {
+        fprintf(stderr, "Failed to open scenario %s\n", path);
+        return false;
+    }
+    bool is_ok = true;
+    char line[256];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char * p_comment = strchr(line, '#');
+        if (p_comment != NULL) {
+            *p_comment = '\0';
+        }
+        char const * p_char = line;
+        while (*p_char != '\0' && isspace(static_cast<unsigned char>(*p_char))) {
+            p_char ++;
+        }
+        if (*p_char == '\0') {
+            continue;
+        }
+        is_ok = scenario_set(scenario, p_char) && is_ok;
+    }
+    fclose(file);
+    return is_ok;
+}
@@ -0,0 +1,57 @@
+#ifndef TANKSIM_SCENARIO_HPP
+#define TANKSIM_SCENARIO_HPP
+
+#include "sphere.hpp"
+
+// How entities of one kind are spread over the arena
+#define SCENARIO_SPAWN_LEGACY               (0)     // the original hand-placed / overlapping rand() layout
+#define SCENARIO_SPAWN_UNIFORM              (1)     // uniform, non-overlapping
+#define SCENARIO_SPAWN_CLUSTERED            (2)     // around random cluster centres, non-overlapping
+
+// Everything env_init needs to lay out a world. The default preset is the
+// original 20 obstacle / 20 rain drop / 2 tank game in a +-20 arena.
+//
+// Text form, one "key = value" per line, '#' starts a comment; keys are the
+// field names below, spawn fields take legacy / uniform / clustered.
+typedef struct Scenario_s {
+    Bound_s bound;
+    unsigned int rng_seed;
+
+    int num_obst;
+    float obst_r;
+    int obst_spawn;
+    int num_obst_cluster;
+    float obst_cluster_r;
+
+    int num_tank;
+    float tank_r;
+    int tank_spawn;
+
+    int num_rain;
+    float rain_r;
+    float rain_speed_min;
+    float rain_speed_max;
+
+    // scripted bot tanks: seconds per move phase and between shots
+    float bot_phase_time;
+    float bot_fire_time;
+
+    int ammo_pool_capacity;
+    // dart throws per entity before the generator gives up on it
+    int place_max_try;
+} Scenario_s;
+
+bool scenario_set_default(Scenario_s & scenario);
+// "default" or "stress" (10k obstacles, 1k bot tanks, 50k rain drops)
+bool scenario_set_preset(Scenario_s & scenario, char const * name);
+// Prints what is wrong and returns false for negative counts, an ammo pool or
+// placement budget under 1, an empty bound, non-positive radii or a rain
+// speed range the wrong way round
+bool scenario_validate(Scenario_s const & scenario);
+// One "key = value" or "key=value" assignment; leaves scenario unchanged if the
+// value does not parse. Neither checks the scenario as a whole, since a bound's
+// max may be set before its min; env_init calls scenario_validate.
+bool scenario_set(Scenario_s & scenario, char const * assignment);
+bool scenario_load_file(Scenario_s & scenario, char const * path);
+
+#endif
@@ -0,0 +1,123 @@
+#ifndef TANKSIM_SPATIAL_GRID_HPP
+#define TANKSIM_SPATIAL_GRID_HPP
+
+#include <vector>
+#include <algorithm>
+
+#include "sphere.hpp"
+
+// Uniform grid over the x/y plane of the arena, used as collision broadphase.
+// Each cell keeps the indices of the spheres whose center falls into it; centers
+// outside the arena are clamped into the border cells.
+class SpatialGrid {
+    #define SPATIAL_GRID_DEFAULT_CELL_SIZE      (4.0f)
+
+    float x_min;
+    float y_min;
+    float cell_size;
+    int num_cell_x;
+    int num_cell_y;
+    float max_r;
+    std::vector<std::vector<int> > cell_vec;
+    std::vector<int> cell_idx_vec;
+
+    int get_cell_x(float x) const {
+        int cell_x = static_cast<int>(floor((x - this->x_min) / this->cell_size));
+        return std::min(std::max(cell_x, 0), this->num_cell_x - 1);
+    }
+
+    int get_cell_y(float y) const {
+        int cell_y = static_cast<int>(floor((y - this->y_min) / this->cell_size));
+        return std::min(std::max(cell_y, 0), this->num_cell_y - 1);
+    }
+
+    int get_cell_idx(Sphere const & s) const {
+        return this->get_cell_y(s.get_y()) * this->num_cell_x + this->get_cell_x(s.get_x());
+    }
+
+    bool remove_from_cell(int idx, int cell_idx) {
+        std::vector<int> & cell = this->cell_vec[cell_idx];
+        int num_entries = static_cast<int>(cell.size());
+        for (int i = 0; i < num_entries; i ++) {
+            if (cell[i] == idx) {
+                cell[i] = cell.back();
+                cell.pop_back();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    public:
+    SpatialGrid() : x_min{0.0f}, y_min{0.0f}, cell_size{SPATIAL_GRID_DEFAULT_CELL_SIZE}, num_cell_x{1}, num_cell_y{1}, max_r{0.0f}, cell_vec(1) {}
+
+    bool init(float x_min, float x_max, float y_min, float y_max, float cell_size) {
+        this->x_min = x_min;
+        this->y_min = y_min;
+        this->cell_size = cell_size;
+        this->num_cell_x = std::max(1, static_cast<int>(ceil((x_max - x_min) / cell_size)));
+        this->num_cell_y = std::max(1, static_cast<int>(ceil((y_max - y_min) / cell_size)));
+        this->max_r = 0.0f;
+        this->cell_vec.assign(this->num_cell_x * this->num_cell_y, std::vector<int>());
+        this->cell_idx_vec.clear();
+        return true;
+    }
+
+    bool insert(int idx, Sphere const & s) {
+        if (idx >= static_cast<int>(this->cell_idx_vec.size())) {
+            this->cell_idx_vec.resize(idx + 1, -1);
+        }
+        if (this->cell_idx_vec[idx] >= 0) {
+            return this->update(idx, s);
+        }
+        int cell_idx = this->get_cell_idx(s);
+        this->cell_vec[cell_idx].push_back(idx);
+        this->cell_idx_vec[idx] = cell_idx;
+        this->max_r = std::max(this->max_r, s.get_r());
+        return true;
+    }
+
+    bool remove(int idx) {
+        if (idx >= static_cast<int>(this->cell_idx_vec.size()) || this->cell_idx_vec[idx] < 0) {
+            return false;
+        }
+        this->remove_from_cell(idx, this->cell_idx_vec[idx]);
+        this->cell_idx_vec[idx] = -1;
+        return true;
+    }
+
+    // Call after the sphere stored at idx has moved
+    bool update(int idx, Sphere const & s) {
+        if (idx >= static_cast<int>(this->cell_idx_vec.size()) || this->cell_idx_vec[idx] < 0) {
+            return false;
+        }
+        int cell_idx = this->get_cell_idx(s);
+        if (cell_idx != this->cell_idx_vec[idx]) {
+            this->remove_from_cell(idx, this->cell_idx_vec[idx]);
+            this->cell_vec[cell_idx].push_back(idx);
+            this->cell_idx_vec[idx] = cell_idx;
+        }
+        return true;
+    }
+
+    // Collects every index that may collide with s, sorted ascending so callers
+    // visit candidates in the same order as a linear scan
+    bool query(Sphere const & s, std::vector<int> & out_idx_vec) const {
+        out_idx_vec.clear();
+        float reach = s.get_r() + this->max_r;
+        int cell_x_lo = this->get_cell_x(s.get_x() - reach);
+        int cell_x_hi = this->get_cell_x(s.get_x() + reach);
+        int cell_y_lo = this->get_cell_y(s.get_y() - reach);
+        int cell_y_hi = this->get_cell_y(s.get_y() + reach);
+        for (int cell_y = cell_y_lo; cell_y <= cell_y_hi; cell_y ++) {
+            for (int cell_x = cell_x_lo; cell_x <= cell_x_hi; cell_x ++) {
+                std::vector<int> const & cell = this->cell_vec[cell_y * this->num_cell_x + cell_x];
+                out_idx_vec.insert(out_idx_vec.end(), cell.begin(), cell.end());
+            }
+        }
+        std::sort(out_idx_vec.begin(), out_idx_vec.end());
+        return out_idx_vec.empty() == false;
+    }
+};
+
+#endif
@@ -0,0 +1,341 @@
+#ifndef TANKSIM_SPHERE_HPP
+#define TANKSIM_SPHERE_HPP
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "profiler.hpp"
+
+#define MY_PI_HALF  (3.1415926f / 2.0f)
+// Arena of the default scenario, see Scenario_s for the bounds actually in use
+#define BOUND_X_MIN     (-20.0f)
+#define BOUND_X_MAX     ( 20.0f)
+#define BOUND_Y_MIN     (-20.0f)
+#define BOUND_Y_MAX     ( 20.0f)
+#define BOUND_Z_MIN     ( -2.0f)
+#define BOUND_Z_MAX     ( 20.0f)
+
+// Axis-aligned arena bounds; a sphere is out once its centre leaves them
+typedef struct Bound_s {
+    float x_min;
+    float x_max;
+    float y_min;
+    float y_max;
+    float z_min;
+    float z_max;
+} Bound_s;
+
+class Sphere {
+    protected:
+    float x;
+    float y;
+    float z;
+    float r;
+
+    public:
+    Sphere(float x, float y, float z, float r) : x{x}, y{y}, z{z}, r{r} {}
+
+    // Unit vector for a heading, matching the axes used by the model matrices
+    static bool get_direction(float angle_xy, float angle_z, float & dir_x, float & dir_y, float & dir_z) {
+        dir_x = cos(angle_z) * cos(angle_xy);
+        dir_y = cos(angle_z) * sin(angle_xy);
+        dir_z = sin(angle_z);
+        return true;
+    }
+
+    // Push direction from a to b and the distance between the centres.
+    // Same direction the former atan2 pair gave: the xy heading of the offset,
+    // tilted up by atan2(z_diff^2, xy_diff^2).
+    static bool get_relation(Sphere const & a, Sphere const & b, float & dir_x, float & dir_y, float & dir_z, float & dist) {
+        if (&a == &b) {
+            dir_x = 1.0f;
+            dir_y = 0.0f;
+            dir_z = 0.0f;
+            dist = 0.0f;
+            return false;
+        }
+        float x_diff = b.x - a.x;
+        float y_diff = b.y - a.y;
+        float z_diff = b.z - a.z;
+        float xy_diff_sq = x_diff * x_diff + y_diff * y_diff;
+        float z_diff_sq = z_diff * z_diff;
+        dist = sqrt(xy_diff_sq + z_diff_sq);
+
+        float cos_xy = 1.0f;
+        float sin_xy = 0.0f;
+        if (xy_diff_sq > 0.0f) {
+            float xy_dist = sqrt(xy_diff_sq);
+            cos_xy = x_diff / xy_dist;
+            sin_xy = y_diff / xy_dist;
+        }
+        float cos_z = 1.0f;
+        float sin_z = 0.0f;
+        float tilt_len = sqrt(xy_diff_sq * xy_diff_sq + z_diff_sq * z_diff_sq);
+        if (tilt_len > 0.0f) {
+            cos_z = xy_diff_sq / tilt_len;
+            sin_z = z_diff_sq / tilt_len;
+        }
+        dir_x = cos_z * cos_xy;
+        dir_y = cos_z * sin_xy;
+        dir_z = sin_z;
+        return true;
+    }
+
+    static bool check_is_out_of_bound(Sphere const &a, float x_min, float x_max, float y_min, float y_max, float z_min, float z_max) {
+        return (a.x < x_min) || (a.x > x_max) || (a.y < y_min) || (a.y > y_max) || (a.z < z_min) || (a.z > z_max);
+    }
+
+    static bool check_is_out_of_bound(Sphere const &a, Bound_s const & bound) {
+        return check_is_out_of_bound(a, bound.x_min, bound.x_max, bound.y_min, bound.y_max, bound.z_min, bound.z_max);
+    }
+
+    #define SPHERE_COLLISION_CHECK_TOLERANCE    (0.00001f)
+    static bool check_is_collided(Sphere const & a, Sphere const & b) {
+        if (&a == &b) {
+            return false;
+        }
+        PROF_COUNT_TESTS(1);
+        float x_diff = a.x - b.x;
+        float y_diff = a.y - b.y;
+        float z_diff = a.z - b.z;
+        float r_sum = a.r + b.r;
+        return (x_diff * x_diff + y_diff * y_diff + z_diff * z_diff) + SPHERE_COLLISION_CHECK_TOLERANCE < (r_sum * r_sum);
+    }
+
+    // Earliest distance toi in [0, dist] at which a, moving along the unit
+    // direction dir, touches b, using the same tolerance as check_is_collided.
+    // toi is 0 if they already overlap. Returns false if they never touch.
+    static bool get_sweep_toi(Sphere const & a, float dir_x, float dir_y, float dir_z, float dist, Sphere const & b, float & toi) {
+        if (&a == &b) {
+            return false;
+        }
+        PROF_COUNT_TESTS(1);
+        float x_diff = a.x - b.x;
+        float y_diff = a.y - b.y;
+        float z_diff = a.z - b.z;
+        float r_sum = a.r + b.r;
+        float c = (x_diff * x_diff + y_diff * y_diff + z_diff * z_diff) + SPHERE_COLLISION_CHECK_TOLERANCE - (r_sum * r_sum);
+        if (c < 0.0f) {
+            toi = 0.0f;
+            return true;
+        }
+        float b_half = x_diff * dir_x + y_diff * dir_y + z_diff * dir_z;
+        if (b_half >= 0.0f) {
+            // moving away
+            return false;
+        }
+        float disc = b_half * b_half - c;
+        if (disc < 0.0f) {
+            return false;
+        }
+        float t = -b_half - sqrt(disc);
+        if (t > dist) {
+            return false;
+        }
+        toi = std::max(t, 0.0f);
+        return true;
+    }
+
+    // Distance toi along the step at which the centre of a crosses the bounds.
+    // Returns false if the step ends inside, matching check_is_out_of_bound.
+    static bool get_sweep_bound_toi(Sphere const & a, float dir_x, float dir_y, float dir_z, float dist, Bound_s const & bound, float & toi) {
+        float pos[3] = {a.x, a.y, a.z};
+        float dir[3] = {dir_x, dir_y, dir_z};
+        float bound_min[3] = {bound.x_min, bound.y_min, bound.z_min};
+        float bound_max[3] = {bound.x_max, bound.y_max, bound.z_max};
+        bool is_out = false;
+        toi = dist;
+        for (int axis = 0; axis < 3; axis ++) {
+            float t = dist;
+            if (dir[axis] > 0.0f) {
+                t = (bound_max[axis] - pos[axis]) / dir[axis];
+            }
+            else if (dir[axis] < 0.0f) {
+                t = (bound_min[axis] - pos[axis]) / dir[axis];
+            }
+            if (t < toi) {
+                toi = std::max(t, 0.0f);
+                is_out = true;
+            }
+        }
+        return is_out;
+    }
+
+    float get_x() const {
+        return this->x;
+    }
+
+    float get_y() const {
+        return this->y;
+    }
+
+    float get_z() const {
+        return this->z;
+    }
+
+    float get_r() const {
+        return this->r;
+    }
+
+    bool get_relation(Sphere const & b, float & dir_x, float & dir_y, float & dir_z, float & dist) const {
+        return Sphere::get_relation(*this, b, dir_x, dir_y, dir_z, dist);
+    }
+
+    bool check_is_out_of_bound(float x_min, float x_max, float y_min, float y_max, float z_min, float z_max) const {
+        return Sphere::check_is_out_of_bound(*this, x_min, x_max, y_min, y_max, z_min, z_max);
+    }
+
+    bool check_is_out_of_bound(Bound_s const & bound) const {
+        return Sphere::check_is_out_of_bound(*this, bound);
+    }
+
+    bool check_is_collided(Sphere const & b) const {
+        return Sphere::check_is_collided(*this, b);
+    }
+
+    bool move(float angle_xy, float angle_z, float dist) {
+        float x_diff = dist * cos(angle_z) * cos(angle_xy);
+        float y_diff = dist * cos(angle_z) * sin(angle_xy);
+        float z_diff = dist * sin(angle_z);
+        this->x += x_diff;
+        this->y += y_diff;
+        this->z += z_diff;
+        return true;
+    }
+
+    // Trig-free move along a unit direction, see get_direction
+    bool move(float dir_x, float dir_y, float dir_z, float dist) {
+        this->x += dir_x * dist;
+        this->y += dir_y * dist;
+        this->z += dir_z * dist;
+        return true;
+    }
+
+    glm::mat4 get_model_matrix() const {
+        glm::mat4 scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(this->r, this->r, this->r));
+        glm::mat4 trans_mat = glm::translate(glm::mat4(), glm::vec3(this->x, this->y, this->z));
+        glm::mat4 rotat_mat = glm::rotate( glm::mat4(1.0f), 0.0f, glm::vec3(0, 0, 1) );
+        glm::mat4 model_mat = trans_mat * rotat_mat * scale_mat;
+        return model_mat;
+    }
+};
+
+// Structure-of-arrays mirror of sphere positions and radii, indexed like the
+// vector it mirrors. The narrowphase kernel tests one moving sphere against a
+// block of candidate indices at once and returns a hit bitmask; it evaluates
+// exactly the same float expression as Sphere::check_is_collided.
+class SphereSoA {
+    #define SPHERE_SOA_BLOCK_SIZE               (32)
+
+    std::vector<float> x_vec;
+    std::vector<float> y_vec;
+    std::vector<float> z_vec;
+    std::vector<float> r_vec;
+
+    public:
+    int size() const {
+        return static_cast<int>(this->x_vec.size());
+    }
+
+    bool clear() {
+        this->x_vec.clear();
+        this->y_vec.clear();
+        this->z_vec.clear();
+        this->r_vec.clear();
+        return true;
+    }
+
+    bool push_back(Sphere const & s) {
+        this->x_vec.push_back(s.get_x());
+        this->y_vec.push_back(s.get_y());
+        this->z_vec.push_back(s.get_z());
+        this->r_vec.push_back(s.get_r());
+        return true;
+    }
+
+    bool set(int idx, Sphere const & s) {
+        this->x_vec[idx] = s.get_x();
+        this->y_vec[idx] = s.get_y();
+        this->z_vec[idx] = s.get_z();
+        this->r_vec[idx] = s.get_r();
+        return true;
+    }
+
+    // Bit i of the result is set if a collides with the sphere at idx_buf[i], count <= SPHERE_SOA_BLOCK_SIZE
+    unsigned int check_is_collided(Sphere const & a, int const * idx_buf, int count) const {
+        unsigned int hit_mask = 0;
+        PROF_COUNT_TESTS(count);
+        int i = 0;
+#if defined(__AVX2__)
+        __m256 a_x = _mm256_set1_ps(a.get_x());
+        __m256 a_y = _mm256_set1_ps(a.get_y());
+        __m256 a_z = _mm256_set1_ps(a.get_z());
+        __m256 a_r = _mm256_set1_ps(a.get_r());
+        __m256 tolerance = _mm256_set1_ps(SPHERE_COLLISION_CHECK_TOLERANCE);
+        for (; i + 8 <= count; i += 8) {
+            __m256i idx = _mm256_loadu_si256(reinterpret_cast<__m256i const *>(idx_buf + i));
+            __m256 x_diff = _mm256_sub_ps(a_x, _mm256_i32gather_ps(&this->x_vec[0], idx, 4));
+            __m256 y_diff = _mm256_sub_ps(a_y, _mm256_i32gather_ps(&this->y_vec[0], idx, 4));
+            __m256 z_diff = _mm256_sub_ps(a_z, _mm256_i32gather_ps(&this->z_vec[0], idx, 4));
+            __m256 r_sum = _mm256_add_ps(a_r, _mm256_i32gather_ps(&this->r_vec[0], idx, 4));
+            __m256 dist_sq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x_diff, x_diff), _mm256_mul_ps(y_diff, y_diff)), _mm256_mul_ps(z_diff, z_diff));
+            __m256 is_hit = _mm256_cmp_ps(_mm256_add_ps(dist_sq, tolerance), _mm256_mul_ps(r_sum, r_sum), _CMP_LT_OQ);
+            hit_mask |= static_cast<unsigned int>(_mm256_movemask_ps(is_hit)) << i;
+        }
+#elif defined(__SSE2__) || defined(_M_X64)
+        __m128 a_x = _mm_set1_ps(a.get_x());
+        __m128 a_y = _mm_set1_ps(a.get_y());
+        __m128 a_z = _mm_set1_ps(a.get_z());
+        __m128 a_r = _mm_set1_ps(a.get_r());
+        __m128 tolerance = _mm_set1_ps(SPHERE_COLLISION_CHECK_TOLERANCE);
+        for (; i + 4 <= count; i += 4) {
+            int const * idx = idx_buf + i;
+            __m128 x_diff = _mm_sub_ps(a_x, _mm_setr_ps(this->x_vec[idx[0]], this->x_vec[idx[1]], this->x_vec[idx[2]], this->x_vec[idx[3]]));
+            __m128 y_diff = _mm_sub_ps(a_y, _mm_setr_ps(this->y_vec[idx[0]], this->y_vec[idx[1]], this->y_vec[idx[2]], this->y_vec[idx[3]]));
+            __m128 z_diff = _mm_sub_ps(a_z, _mm_setr_ps(this->z_vec[idx[0]], this->z_vec[idx[1]], this->z_vec[idx[2]], this->z_vec[idx[3]]));
+            __m128 r_sum = _mm_add_ps(a_r, _mm_setr_ps(this->r_vec[idx[0]], this->r_vec[idx[1]], this->r_vec[idx[2]], this->r_vec[idx[3]]));
+            __m128 dist_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x_diff, x_diff), _mm_mul_ps(y_diff, y_diff)), _mm_mul_ps(z_diff, z_diff));
+            __m128 is_hit = _mm_cmplt_ps(_mm_add_ps(dist_sq, tolerance), _mm_mul_ps(r_sum, r_sum));
+            hit_mask |= static_cast<unsigned int>(_mm_movemask_ps(is_hit)) << i;
+        }
+#endif
+        // scalar fallback and tail, same expression as Sphere::check_is_collided
+        for (; i < count; i ++) {
+            int idx = idx_buf[i];
+            float x_diff = a.get_x() - this->x_vec[idx];
+            float y_diff = a.get_y() - this->y_vec[idx];
+            float z_diff = a.get_z() - this->z_vec[idx];
+            float r_sum = a.get_r() + this->r_vec[idx];
+            if ((x_diff * x_diff + y_diff * y_diff + z_diff * z_diff) + SPHERE_COLLISION_CHECK_TOLERANCE < (r_sum * r_sum)) {
+                hit_mask |= 1u << i;
+            }
+        }
+        return hit_mask;
+    }
+
+    // Keeps only the candidates that collide with a, preserving their order
+    bool filter_collided(Sphere const & a, std::vector<int> & idx_vec) const {
+        int num_hit = 0;
+        int num_idx = static_cast<int>(idx_vec.size());
+        for (int block_begin = 0; block_begin < num_idx; block_begin += SPHERE_SOA_BLOCK_SIZE) {
+            int block_size = std::min(SPHERE_SOA_BLOCK_SIZE, num_idx - block_begin);
+            unsigned int hit_mask = this->check_is_collided(a, &idx_vec[block_begin], block_size);
+            for (int i = 0; hit_mask != 0; i ++, hit_mask >>= 1) {
+                if (hit_mask & 1u) {
+                    idx_vec[num_hit ++] = idx_vec[block_begin + i];
+                }
+            }
+        }
+        idx_vec.resize(num_hit);
+        return num_hit > 0;
+    }
+};
+
+#endif
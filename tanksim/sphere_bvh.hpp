@@ -0,0 +1,398 @@
+#ifndef TANKSIM_SPHERE_BVH_HPP
+#define TANKSIM_SPHERE_BVH_HPP
+
+#include <vector>
+#include <algorithm>
+#include <climits>
+#if defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#endif
+
+#include "sphere.hpp"
+
+// Bounding volume hierarchy over spheres that never move, i.e. the obstacles.
+// Built once by median splits along the widest axis into a 4-wide tree whose
+// nodes keep the boxes of their four children side by side, so one node visit
+// tests all four at once. A sphere that is switched off is masked instead of
+// refitted: every node counts the active spheres under each child and queries
+// skip children whose count dropped to zero.
+// All queries only report active spheres and use the exact float expressions of
+// Sphere::check_is_collided / Sphere::get_sweep_toi, so they agree with a
+// linear scan; ties go to the lowest index, as in a linear scan.
+class SphereBvh {
+    #define SPHERE_BVH_WIDTH                    (4)
+    #define SPHERE_BVH_LEAF_SIZE                (4)
+    #define SPHERE_BVH_STACK_SIZE               (128)
+    // child boxes are padded so rounding can never cull a touching sphere
+    #define SPHERE_BVH_BOX_PADDING              (0.0001f)
+    // stands in for 1 / 0 in the slab test, pushes the slab of that axis to infinity
+    #define SPHERE_BVH_INV_DIR_MAX              (1e30f)
+
+    typedef struct Node_s {
+        float bound_min_x[SPHERE_BVH_WIDTH];
+        float bound_min_y[SPHERE_BVH_WIDTH];
+        float bound_min_z[SPHERE_BVH_WIDTH];
+        float bound_max_x[SPHERE_BVH_WIDTH];
+        float bound_max_y[SPHERE_BVH_WIDTH];
+        float bound_max_z[SPHERE_BVH_WIDTH];
+        int child[SPHERE_BVH_WIDTH];        // >= 0: inner node, < 0: ~leaf index
+        int num_active[SPHERE_BVH_WIDTH];   // active spheres under the child, 0 for empty lanes
+        int parent;
+        int parent_lane;
+    } Node_s;
+
+    typedef struct Leaf_s {
+        int first;          // first slot
+        int count;
+        int node_idx;       // the node and lane pointing at this leaf
+        int lane;
+    } Leaf_s;
+
+    std::vector<Node_s> node_vec;
+    std::vector<Leaf_s> leaf_vec;
+    // per slot, in leaf order
+    std::vector<int> slot_idx_vec;
+    std::vector<float> slot_x_vec;
+    std::vector<float> slot_y_vec;
+    std::vector<float> slot_z_vec;
+    std::vector<float> slot_r_vec;
+    std::vector<int> slot_is_active_vec;
+    std::vector<int> slot_leaf_vec;
+    // per sphere index
+    std::vector<int> idx_slot_vec;
+
+    Sphere get_slot_sphere(int slot) const {
+        return Sphere(this->slot_x_vec[slot], this->slot_y_vec[slot], this->slot_z_vec[slot], this->slot_r_vec[slot]);
+    }
+
+    // Median split of the slots [begin, end) along the widest spread of centres
+    int split_range(std::vector<Sphere> const & sphere_vec, int begin, int end) {
+        float centre_min[3] = {1e30f, 1e30f, 1e30f};
+        float centre_max[3] = {-1e30f, -1e30f, -1e30f};
+        for (int slot = begin; slot < end; slot ++) {
+            Sphere const & s = sphere_vec[this->slot_idx_vec[slot]];
+            float centre[3] = {s.get_x(), s.get_y(), s.get_z()};
+            for (int axis = 0; axis < 3; axis ++) {
+                centre_min[axis] = std::min(centre_min[axis], centre[axis]);
+                centre_max[axis] = std::max(centre_max[axis], centre[axis]);
+            }
+        }
+        int split_axis = 0;
+        for (int axis = 1; axis < 3; axis ++) {
+            if (centre_max[axis] - centre_min[axis] > centre_max[split_axis] - centre_min[split_axis]) {
+                split_axis = axis;
+            }
+        }
+        int mid = (begin + end) / 2;
+        std::nth_element(this->slot_idx_vec.begin() + begin, this->slot_idx_vec.begin() + mid, this->slot_idx_vec.begin() + end, [&](int a, int b) {
+            float centre_a[3] = {sphere_vec[a].get_x(), sphere_vec[a].get_y(), sphere_vec[a].get_z()};
+            float centre_b[3] = {sphere_vec[b].get_x(), sphere_vec[b].get_y(), sphere_vec[b].get_z()};
+            return centre_a[split_axis] < centre_b[split_axis] || (centre_a[split_axis] == centre_b[split_axis] && a < b);
+        });
+        return mid;
+    }
+
+    // Two levels of median splits give the up to four children of a node
+    int build_node(std::vector<Sphere> const & sphere_vec, int begin, int end, int parent, int parent_lane) {
+        int range_vec[SPHERE_BVH_WIDTH + 1];
+        int num_ranges = 0;
+        int mid = this->split_range(sphere_vec, begin, end);
+        int const half_vec[3] = {begin, mid, end};
+        range_vec[0] = begin;
+        for (int half = 0; half < 2; half ++) {
+            if (half_vec[half + 1] - half_vec[half] > SPHERE_BVH_LEAF_SIZE) {
+                range_vec[++ num_ranges] = this->split_range(sphere_vec, half_vec[half], half_vec[half + 1]);
+            }
+            range_vec[++ num_ranges] = half_vec[half + 1];
+        }
+
+        int node_idx = static_cast<int>(this->node_vec.size());
+        this->node_vec.push_back(Node_s());
+        Node_s node;
+        node.parent = parent;
+        node.parent_lane = parent_lane;
+        for (int lane = 0; lane < SPHERE_BVH_WIDTH; lane ++) {
+            // empty lanes are inverted boxes no sphere can touch
+            node.bound_min_x[lane] = 1e30f;
+            node.bound_min_y[lane] = 1e30f;
+            node.bound_min_z[lane] = 1e30f;
+            node.bound_max_x[lane] = -1e30f;
+            node.bound_max_y[lane] = -1e30f;
+            node.bound_max_z[lane] = -1e30f;
+            node.child[lane] = 0;
+            node.num_active[lane] = 0;
+        }
+        for (int lane = 0; lane < num_ranges; lane ++) {
+            int range_begin = range_vec[lane];
+            int range_end = range_vec[lane + 1];
+            for (int slot = range_begin; slot < range_end; slot ++) {
+                Sphere const & s = sphere_vec[this->slot_idx_vec[slot]];
+                float r = s.get_r() + SPHERE_BVH_BOX_PADDING;
+                node.bound_min_x[lane] = std::min(node.bound_min_x[lane], s.get_x() - r);
+                node.bound_min_y[lane] = std::min(node.bound_min_y[lane], s.get_y() - r);
+                node.bound_min_z[lane] = std::min(node.bound_min_z[lane], s.get_z() - r);
+                node.bound_max_x[lane] = std::max(node.bound_max_x[lane], s.get_x() + r);
+                node.bound_max_y[lane] = std::max(node.bound_max_y[lane], s.get_y() + r);
+                node.bound_max_z[lane] = std::max(node.bound_max_z[lane], s.get_z() + r);
+            }
+            if (range_end - range_begin <= SPHERE_BVH_LEAF_SIZE) {
+                Leaf_s leaf;
+                leaf.first = range_begin;
+                leaf.count = range_end - range_begin;
+                leaf.node_idx = node_idx;
+                leaf.lane = lane;
+                node.child[lane] = ~static_cast<int>(this->leaf_vec.size());
+                this->leaf_vec.push_back(leaf);
+            }
+            else {
+                node.child[lane] = this->build_node(sphere_vec, range_begin, range_end, node_idx, lane);
+            }
+        }
+        this->node_vec[node_idx] = node;
+        return node_idx;
+    }
+
+    // Bit lane is set if s touches the box of that child and it has active spheres
+    unsigned int get_touched_mask(Node_s const & node, Sphere const & s) const {
+        unsigned int touched_mask = 0;
+#if defined(__SSE2__) || defined(_M_X64)
+        __m128 zero = _mm_setzero_ps();
+        __m128 x = _mm_set1_ps(s.get_x());
+        __m128 y = _mm_set1_ps(s.get_y());
+        __m128 z = _mm_set1_ps(s.get_z());
+        __m128 x_diff = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.bound_min_x), x), _mm_sub_ps(x, _mm_loadu_ps(node.bound_max_x))), zero);
+        __m128 y_diff = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.bound_min_y), y), _mm_sub_ps(y, _mm_loadu_ps(node.bound_max_y))), zero);
+        __m128 z_diff = _mm_max_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(node.bound_min_z), z), _mm_sub_ps(z, _mm_loadu_ps(node.bound_max_z))), zero);
+        __m128 dist_sq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x_diff, x_diff), _mm_mul_ps(y_diff, y_diff)), _mm_mul_ps(z_diff, z_diff));
+        __m128i is_empty = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const *>(node.num_active)), _mm_setzero_si128());
+        __m128 is_touched = _mm_andnot_ps(_mm_castsi128_ps(is_empty), _mm_cmple_ps(dist_sq, _mm_set1_ps(s.get_r() * s.get_r())));
+        touched_mask = static_cast<unsigned int>(_mm_movemask_ps(is_touched));
+#else
+        for (int lane = 0; lane < SPHERE_BVH_WIDTH; lane ++) {
+            float x_diff = std::max(std::max(node.bound_min_x[lane] - s.get_x(), s.get_x() - node.bound_max_x[lane]), 0.0f);
+            float y_diff = std::max(std::max(node.bound_min_y[lane] - s.get_y(), s.get_y() - node.bound_max_y[lane]), 0.0f);
+            float z_diff = std::max(std::max(node.bound_min_z[lane] - s.get_z(), s.get_z() - node.bound_max_z[lane]), 0.0f);
+            if (node.num_active[lane] > 0 && x_diff * x_diff + y_diff * y_diff + z_diff * z_diff <= s.get_r() * s.get_r()) {
+                touched_mask |= 1u << lane;
+            }
+        }
+#endif
+        return touched_mask;
+    }
+
+    // Slab test of start + dir * t, t in [0, max_t], against the child boxes
+    // grown by r. Bit lane is set for every box with active spheres the segment
+    // enters, entry_buf[lane] is where it enters.
+    unsigned int get_entry_mask(Node_s const & node, float const * start, float const * inv_dir, float r, float max_t, float * entry_buf) const {
+        unsigned int entry_mask = 0;
+        float const * bound_min[3] = {node.bound_min_x, node.bound_min_y, node.bound_min_z};
+        float const * bound_max[3] = {node.bound_max_x, node.bound_max_y, node.bound_max_z};
+#if defined(__SSE2__) || defined(_M_X64)
+        __m128 t_lo = _mm_setzero_ps();
+        __m128 t_hi = _mm_set1_ps(max_t);
+        __m128 r_4 = _mm_set1_ps(r);
+        for (int axis = 0; axis < 3; axis ++) {
+            __m128 start_4 = _mm_set1_ps(start[axis]);
+            __m128 inv_dir_4 = _mm_set1_ps(inv_dir[axis]);
+            __m128 t_a = _mm_mul_ps(_mm_sub_ps(_mm_sub_ps(_mm_loadu_ps(bound_min[axis]), r_4), start_4), inv_dir_4);
+            __m128 t_b = _mm_mul_ps(_mm_sub_ps(_mm_add_ps(_mm_loadu_ps(bound_max[axis]), r_4), start_4), inv_dir_4);
+            t_lo = _mm_max_ps(t_lo, _mm_min_ps(t_a, t_b));
+            t_hi = _mm_min_ps(t_hi, _mm_max_ps(t_a, t_b));
+        }
+        _mm_storeu_ps(entry_buf, t_lo);
+        __m128i is_empty = _mm_cmpeq_epi32(_mm_loadu_si128(reinterpret_cast<__m128i const *>(node.num_active)), _mm_setzero_si128());
+        __m128 is_entered = _mm_andnot_ps(_mm_castsi128_ps(is_empty), _mm_cmple_ps(t_lo, t_hi));
+        entry_mask = static_cast<unsigned int>(_mm_movemask_ps(is_entered));
+#else
+        for (int lane = 0; lane < SPHERE_BVH_WIDTH; lane ++) {
+            float t_lo = 0.0f;
+            float t_hi = max_t;
+            for (int axis = 0; axis < 3; axis ++) {
+                float t_a = (bound_min[axis][lane] - r - start[axis]) * inv_dir[axis];
+                float t_b = (bound_max[axis][lane] + r - start[axis]) * inv_dir[axis];
+                t_lo = std::max(t_lo, std::min(t_a, t_b));
+                t_hi = std::min(t_hi, std::max(t_a, t_b));
+            }
+            entry_buf[lane] = t_lo;
+            if (node.num_active[lane] > 0 && t_lo <= t_hi) {
+                entry_mask |= 1u << lane;
+            }
+        }
+#endif
+        return entry_mask;
+    }
+
+    public:
+    int size() const {
+        return static_cast<int>(this->idx_slot_vec.size());
+    }
+
+    // Builds over sphere_vec, index i of the results is sphere_vec[i]; all start active
+    bool build(std::vector<Sphere> const & sphere_vec) {
+        int num = static_cast<int>(sphere_vec.size());
+        this->node_vec.clear();
+        this->leaf_vec.clear();
+        this->slot_idx_vec.resize(num);
+        for (int idx = 0; idx < num; idx ++) {
+            this->slot_idx_vec[idx] = idx;
+        }
+        if (num > 0) {
+            this->build_node(sphere_vec, 0, num, -1, 0);
+        }
+        this->slot_x_vec.resize(num);
+        this->slot_y_vec.resize(num);
+        this->slot_z_vec.resize(num);
+        this->slot_r_vec.resize(num);
+        this->slot_is_active_vec.assign(num, 0);
+        this->slot_leaf_vec.resize(num);
+        this->idx_slot_vec.resize(num);
+        for (int slot = 0; slot < num; slot ++) {
+            Sphere const & s = sphere_vec[this->slot_idx_vec[slot]];
+            this->slot_x_vec[slot] = s.get_x();
+            this->slot_y_vec[slot] = s.get_y();
+            this->slot_z_vec[slot] = s.get_z();
+            this->slot_r_vec[slot] = s.get_r();
+            this->idx_slot_vec[this->slot_idx_vec[slot]] = slot;
+        }
+        for (int leaf_idx = 0; leaf_idx < this->leaf_vec.size(); leaf_idx ++) {
+            Leaf_s const & leaf = this->leaf_vec[leaf_idx];
+            for (int slot = leaf.first; slot < leaf.first + leaf.count; slot ++) {
+                this->slot_leaf_vec[slot] = leaf_idx;
+            }
+        }
+        for (int idx = 0; idx < num; idx ++) {
+            this->set_is_active(idx, true);
+        }
+        return true;
+    }
+
+    bool get_is_active(int idx) const {
+        return this->slot_is_active_vec[this->idx_slot_vec[idx]] != 0;
+    }
+
+    // Masks a sphere in or out of every query, updating the counts up to the root
+    bool set_is_active(int idx, bool is_active) {
+        int slot = this->idx_slot_vec[idx];
+        if ((this->slot_is_active_vec[slot] != 0) == is_active) {
+            return false;
+        }
+        this->slot_is_active_vec[slot] = is_active ? 1 : 0;
+        Leaf_s const & leaf = this->leaf_vec[this->slot_leaf_vec[slot]];
+        int node_idx = leaf.node_idx;
+        int lane = leaf.lane;
+        while (node_idx >= 0) {
+            Node_s & node = this->node_vec[node_idx];
+            node.num_active[lane] += is_active ? 1 : -1;
+            lane = node.parent_lane;
+            node_idx = node.parent;
+        }
+        return true;
+    }
+
+    // Active spheres that collide with s, ascending
+    bool query(Sphere const & s, std::vector<int> & out_idx_vec) const {
+        out_idx_vec.clear();
+        if (this->node_vec.empty()) {
+            return false;
+        }
+        int stack[SPHERE_BVH_STACK_SIZE];
+        int stack_size = 0;
+        stack[stack_size ++] = 0;
+        while (stack_size > 0) {
+            Node_s const & node = this->node_vec[stack[-- stack_size]];
+            unsigned int touched_mask = this->get_touched_mask(node, s);
+            for (int lane = 0; touched_mask != 0; lane ++, touched_mask >>= 1) {
+                if ((touched_mask & 1u) == 0) {
+                    continue;
+                }
+                if (node.child[lane] >= 0) {
+                    stack[stack_size ++] = node.child[lane];
+                    continue;
+                }
+                Leaf_s const & leaf = this->leaf_vec[~node.child[lane]];
+                for (int slot = leaf.first; slot < leaf.first + leaf.count; slot ++) {
+                    if (this->slot_is_active_vec[slot] && Sphere::check_is_collided(s, this->get_slot_sphere(slot))) {
+                        out_idx_vec.push_back(this->slot_idx_vec[slot]);
+                    }
+                }
+            }
+        }
+        std::sort(out_idx_vec.begin(), out_idx_vec.end());
+        return out_idx_vec.empty() == false;
+    }
+
+    // First active sphere touched by s moving along the unit direction dir for
+    // up to max_dist, see Sphere::get_sweep_toi; max_dist itself still counts.
+    // A radius of 0 casts a plain segment. Returns false, leaving idx and toi
+    // untouched, if nothing is hit.
+    bool raycast(Sphere const & s, float dir_x, float dir_y, float dir_z, float max_dist, int & idx, float & toi) const {
+        if (this->node_vec.empty()) {
+            return false;
+        }
+        float start[3] = {s.get_x(), s.get_y(), s.get_z()};
+        float dir[3] = {dir_x, dir_y, dir_z};
+        float inv_dir[3];
+        for (int axis = 0; axis < 3; axis ++) {
+            inv_dir[axis] = dir[axis] != 0.0f ? 1.0f / dir[axis] : SPHERE_BVH_INV_DIR_MAX;
+        }
+        int best_idx = INT_MAX;
+        float best_toi = max_dist;
+        // children still to visit, with the distance at which the segment enters them
+        int stack_child[SPHERE_BVH_STACK_SIZE];
+        float stack_entry[SPHERE_BVH_STACK_SIZE];
+        int stack_size = 0;
+        stack_child[stack_size] = 0;
+        stack_entry[stack_size ++] = 0.0f;
+        while (stack_size > 0) {
+            stack_size --;
+            int child = stack_child[stack_size];
+            // best_toi may have shrunk since the child was pushed
+            if (stack_entry[stack_size] > best_toi) {
+                continue;
+            }
+            if (child < 0) {
+                Leaf_s const & leaf = this->leaf_vec[~child];
+                for (int slot = leaf.first; slot < leaf.first + leaf.count; slot ++) {
+                    float slot_toi = 0.0f;
+                    if (this->slot_is_active_vec[slot] && Sphere::get_sweep_toi(s, dir_x, dir_y, dir_z, max_dist, this->get_slot_sphere(slot), slot_toi)) {
+                        int slot_idx = this->slot_idx_vec[slot];
+                        if (slot_toi < best_toi || (slot_toi == best_toi && slot_idx < best_idx)) {
+                            best_toi = slot_toi;
+                            best_idx = slot_idx;
+                        }
+                    }
+                }
+                continue;
+            }
+            Node_s const & node = this->node_vec[child];
+            float entry_buf[SPHERE_BVH_WIDTH];
+            unsigned int entry_mask = this->get_entry_mask(node, start, inv_dir, s.get_r(), best_toi, entry_buf);
+            // push far to near, so the nearest child is popped first
+            int lane_vec[SPHERE_BVH_WIDTH];
+            int num_lanes = 0;
+            for (int lane = 0; lane < SPHERE_BVH_WIDTH; lane ++) {
+                if ((entry_mask & (1u << lane)) == 0) {
+                    continue;
+                }
+                int pos = num_lanes ++;
+                while (pos > 0 && entry_buf[lane_vec[pos - 1]] < entry_buf[lane]) {
+                    lane_vec[pos] = lane_vec[pos - 1];
+                    pos --;
+                }
+                lane_vec[pos] = lane;
+            }
+            for (int lane_idx = 0; lane_idx < num_lanes; lane_idx ++) {
+                stack_child[stack_size] = node.child[lane_vec[lane_idx]];
+                stack_entry[stack_size ++] = entry_buf[lane_vec[lane_idx]];
+            }
+        }
+        if (best_idx == INT_MAX) {
+            return false;
+        }
+        idx = best_idx;
+        toi = best_toi;
+        return true;
+    }
+};
+
+#endif
@@ -0,0 +1,131 @@
+/*
+Load generator for tanksim_headless --serve.
+
+Connects num_clients clients from one process and keeps them busy for the
+given number of seconds: each decodes every snapshot the server sends and,
+when it has a tank, sends the scripted advance / turn left / advance / turn
+right cycle with a shot now and then. Prints the received bytes per client
+and the decode cost, to set against the server's own numbers.
+
+Usage:
+    tanksim_bots unix:path|[host:]port [num_clients] [seconds]
+*/
+
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <vector>
+
+#include <tanksim/net_client.hpp>
+#include <tanksim/profiler.hpp>
+#include <common/log_histogram.hpp>
+
+#define BOTS_DEFAULT_NUM_CLIENTS            (100)
+#define BOTS_DEFAULT_TIME                   (10.0)
+#define BOTS_WELCOME_TIMEOUT_MS             (5000)
+#define BOTS_TICK_PER_PHASE                 (30)
+#define BOTS_TICK_PER_FIRE                  (45)
+
+int main(int argc, char ** argv) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s unix:path|[host:]port [num_clients] [seconds]\n", argv[0]);
+        return -1;
+    }
+    char const * addr = argv[1];
+    int num_clients = argc > 2 ? atoi(argv[2]) : BOTS_DEFAULT_NUM_CLIENTS;
+    double run_time = argc > 3 ? atof(argv[3]) : BOTS_DEFAULT_TIME;
+
+    std::vector<NetClient> client_vec(num_clients);
+    for (int client_idx = 0; client_idx < num_clients; client_idx ++) {
+        if (client_vec[client_idx].connect(addr) == false || client_vec[client_idx].wait_welcome(BOTS_WELCOME_TIMEOUT_MS) == false) {
+            fprintf(stderr, "Client %d failed to join\n", client_idx);
+            return -1;
+        }
+    }
+    int num_tanks = 0;
+    for (int client_idx = 0; client_idx < num_clients; client_idx ++) {
+        num_tanks += client_vec[client_idx].get_tank_idx() >= 0 ? 1 : 0;
+    }
+    float tick_time = client_vec.empty() ? 1.0f : client_vec[0].get_tick_time();
+    printf("%d clients joined %s: %d driving a tank, %d watching, server at %.1f Hz\n", num_clients, addr, num_tanks, num_clients - num_tanks, 1.0 / tick_time);
+    fflush(stdout);
+
+    SteadyClock clock;
+    LogHistogram decode_hist;
+    std::vector<int> fd_vec(num_clients);
+    std::vector<unsigned long long> start_num_bytes_vec(num_clients);
+    for (int client_idx = 0; client_idx < num_clients; client_idx ++) {
+        start_num_bytes_vec[client_idx] = client_vec[client_idx].get_num_bytes_received();
+    }
+    double start_time = clock.get_time();
+    double next_act_time = start_time;
+    long act_idx = 0;
+    int num_lost = 0;
+    while (clock.get_time() - start_time < run_time && num_lost < num_clients) {
+        int fd_cnt = 0;
+        for (int client_idx = 0; client_idx < num_clients; client_idx ++) {
+            if (client_vec[client_idx].get_is_open()) {
+                fd_vec[fd_cnt ++] = client_vec[client_idx].get_fd();
+            }
+        }
+        int timeout_ms = std::max(0, static_cast<int>((next_act_time - clock.get_time()) * 1e3));
+        net_wait_readable(fd_vec.data(), fd_cnt, timeout_ms);
+
+        num_lost = 0;
+        for (int client_idx = 0; client_idx < num_clients; client_idx ++) {
+            NetClient & client = client_vec[client_idx];
+            if (client.get_is_open() == false) {
+                num_lost ++;
+                continue;
+            }
+            unsigned long num_snapshots = client.get_num_snapshots();
+            unsigned long long receive_start_ns = prof_get_ns();
+            if (client.receive() == false) {
+                num_lost ++;
+                continue;
+            }
+            if (client.get_num_snapshots() != num_snapshots) {
+                decode_hist.add(prof_get_ns() - receive_start_ns);
+            }
+        }
+
+        if (clock.get_time() >= next_act_time) {
+            for (int client_idx = 0; client_idx < num_clients; client_idx ++) {
+                NetClient & client = client_vec[client_idx];
+                int tank_idx = client.get_tank_idx();
+                if (client.get_is_open() == false || tank_idx < 0) {
+                    continue;
+                }
+                int phase = static_cast<int>((act_idx / BOTS_TICK_PER_PHASE + tank_idx) % 4);
+                TankAction_s tank_act;
+                tank_act.turn_angle_xy = phase == 1 ? 1.0f : (phase == 3 ? -1.0f : 0.0f);
+                tank_act.advance_dist = phase == 0 || phase == 2 ? 1.0f : 0.0f;
+                tank_act.is_firing = (act_idx + tank_idx) % BOTS_TICK_PER_FIRE == 0 ? 1 : 0;
+                client.send_action(tank_act);
+            }
+            act_idx ++;
+            next_act_time = std::max(next_act_time + tick_time, clock.get_time() - tick_time);
+        }
+    }
+    double elapsed_time = clock.get_time() - start_time;
+
+    unsigned long num_snapshots = 0;
+    unsigned long long num_bytes = 0;
+    for (int client_idx = 0; client_idx < num_clients; client_idx ++) {
+        num_snapshots += client_vec[client_idx].get_num_snapshots();
+        num_bytes += client_vec[client_idx].get_num_bytes_received() - start_num_bytes_vec[client_idx];
+        client_vec[client_idx].close();
+    }
+    double num_ticks = elapsed_time / tick_time;
+    printf("%.1f s: %lu snapshots, %.1f per client per second, %d clients lost\n",
+        elapsed_time, num_snapshots, num_clients > 0 ? num_snapshots / (num_clients * elapsed_time) : 0.0, num_lost);
+    printf("bytes per client: %.1f per snapshot, %.1f per tick, %.1f KB/s\n",
+        num_snapshots > 0 ? static_cast<double>(num_bytes) / num_snapshots : 0.0,
+        num_clients > 0 ? num_bytes / (num_clients * num_ticks) : 0.0,
+        num_clients > 0 ? num_bytes / (num_clients * elapsed_time * 1024.0) : 0.0);
+    printf("receive + decode: mean %.2f us, p50 < %.2f us, p99 < %.2f us, max %.2f us\n",
+        decode_hist.get_mean() * 1e-3, decode_hist.get_percentile(0.5) * 1e-3, decode_hist.get_percentile(0.99) * 1e-3, decode_hist.get_max() * 1e-3);
+
+    return 0;
+}
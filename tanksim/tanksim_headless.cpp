@@ -0,0 +1,293 @@
+/*
+Headless driver for the tank simulation.
+
+Runs a scripted scenario for a fixed number of ticks as fast as possible and
+reports the tick throughput, so the simulation can be benchmarked and
+soak-tested on machines without a display.
+
+--scenario takes a preset name (default, stress) or a scenario file, and each
+--set key=value overrides one field of it, see Scenario_s.
+
+With --replay it runs a recorded session instead, at its recorded seed and
+tick rate; pass the same scenario options it was recorded with. --hash-out
+writes the state hash after every tick, one per line, so two builds can be
+diffed tick by tick.
+
+In a build with the TANKSIM_PROFILE option the per-phase timings are printed
+on exit, and with --profile-every also for every window of that many ticks.
+
+With TANK_TRACE=path in the environment every tick and its phases are
+recorded and written on exit as a Chrome trace, see common/trace_recorder.hpp.
+
+--serve makes it an authoritative server on a TCP port or Unix socket, see
+tanksim/net_protocol.hpp: it ticks in real time instead of as fast as
+possible, each connected client drives one tank in place of the script, and
+after every tick all clients get a delta-compressed snapshot. --wait-clients
+holds the first tick until that many have connected. The tick cost and bytes
+per client per tick are printed on exit; tanksim_bots supplies the clients.
+
+Usage:
+    tanksim_headless [num_ticks] [tick_rate] [num_threads]
+        [--scenario preset|path] [--set key=value]...
+        [--record path] [--replay path] [--hash-out path]
+        [--profile-every num_ticks]
+        [--serve unix:path|[host:]port] [--wait-clients num_clients]
+*/
+
+// Include standard headers
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+#include <tanksim/environment.hpp>
+#include <tanksim/replay.hpp>
+#include <tanksim/profiler.hpp>
+#include <tanksim/net_server.hpp>
+#include <common/trace_recorder.hpp>
+#include <common/log_histogram.hpp>
+
+#define HEADLESS_DEFAULT_NUM_TICKS          (100000)
+
+// Every tank cycles through advance / turn left / advance / turn right, one
+// phase per scenario bot_phase_time, and fires every bot_fire_time.
+// Tanks are offset by one phase each so they do not move in lockstep.
+class ScriptedTankInputSource : public TankInputSource {
+    Environment_s const & env;
+
+    public:
+    ScriptedTankInputSource(Environment_s const & env) : env(env) {}
+
+    bool get_tank_act(TankAction_s & tank_act, int tank_idx, float delta_time) {
+        int tick_per_phase = std::max(1, static_cast<int>(this->env.scenario.bot_phase_time / this->env.tick_time));
+        int tick_per_fire = std::max(1, static_cast<int>(this->env.scenario.bot_fire_time / this->env.tick_time));
+        int phase = static_cast<int>((this->env.tick_idx / tick_per_phase + tank_idx) % 4);
+
+        tank_act.turn_angle_xy = 0.0f;
+        tank_act.advance_dist = 0.0f;
+        tank_act.is_firing = 0;
+        if (phase == 0 || phase == 2) {
+            tank_act.advance_dist = 1.0f;
+        }
+        else if (phase == 1) {
+            tank_act.turn_angle_xy = 1.0f;
+        }
+        else {
+            tank_act.turn_angle_xy = -1.0f;
+        }
+        if ((this->env.tick_idx + tank_idx) % tick_per_fire == 0) {
+            tank_act.is_firing = 1;
+        }
+        return true;
+    }
+};
+
+int main(int argc, char ** argv) {
+    long num_ticks = HEADLESS_DEFAULT_NUM_TICKS;
+    double tick_rate = 0.0;
+    int num_threads = 1;
+    char const * record_path = NULL;
+    char const * replay_path = NULL;
+    char const * hash_path = NULL;
+    long profile_every = 0;
+    char const * serve_addr = NULL;
+    int num_wait_clients = 0;
+    Scenario_s scenario;
+    scenario_set_default(scenario);
+
+    int num_positional = 0;
+    for (int arg_idx = 1; arg_idx < argc; arg_idx ++) {
+        if (strncmp(argv[arg_idx], "--", 2) == 0) {
+            if (arg_idx + 1 >= argc) {
+                fprintf(stderr, "Missing value for %s\n", argv[arg_idx]);
+                return -1;
+            }
+            if (strcmp(argv[arg_idx], "--record") == 0) {
+                record_path = argv[arg_idx + 1];
+            }
+            else if (strcmp(argv[arg_idx], "--replay") == 0) {
+                replay_path = argv[arg_idx + 1];
+            }
+            else if (strcmp(argv[arg_idx], "--hash-out") == 0) {
+                hash_path = argv[arg_idx + 1];
+            }
+            else if (strcmp(argv[arg_idx], "--profile-every") == 0) {
+                profile_every = atol(argv[arg_idx + 1]);
+            }
+            else if (strcmp(argv[arg_idx], "--serve") == 0) {
+                serve_addr = argv[arg_idx + 1];
+            }
+            else if (strcmp(argv[arg_idx], "--wait-clients") == 0) {
+                num_wait_clients = atoi(argv[arg_idx + 1]);
+            }
+            else if (strcmp(argv[arg_idx], "--scenario") == 0) {
+                char const * name = argv[arg_idx + 1];
+                bool is_loaded = (strcmp(name, "default") == 0 || strcmp(name, "stress") == 0) ? scenario_set_preset(scenario, name) : scenario_load_file(scenario, name);
+                if (is_loaded == false) {
+                    return -1;
+                }
+            }
+            else if (strcmp(argv[arg_idx], "--set") == 0) {
+                if (scenario_set(scenario, argv[arg_idx + 1]) == false) {
+                    return -1;
+                }
+            }
+            else {
+                fprintf(stderr, "Unknown option %s\n", argv[arg_idx]);
+                return -1;
+            }
+            arg_idx ++;
+        }
+        else if (num_positional == 0) {
+            num_ticks = atol(argv[arg_idx]);
+            num_positional ++;
+        }
+        else if (num_positional == 1) {
+            tick_rate = atof(argv[arg_idx]);
+            num_positional ++;
+        }
+        else {
+            num_threads = atoi(argv[arg_idx]);
+            num_positional ++;
+        }
+    }
+
+    char const * trace_path = getenv("TANK_TRACE");
+    if (trace_path != NULL) {
+        trace_start(trace_path);
+    }
+    trace_set_thread_name("sim");
+
+    Environment_s env;
+    ReplayTankInputSource replay;
+    if (replay_path != NULL) {
+        if (replay.load(replay_path) == false) {
+            return -1;
+        }
+        scenario.rng_seed = replay.get_header().rng_seed;
+        if (env_init(env, scenario) == false) {
+            return -1;
+        }
+        env.tick_time = replay.get_header().tick_time;
+        num_ticks = replay.get_num_ticks();
+        if (replay.get_header().num_tanks != env.tank_vec.size()) {
+            fprintf(stderr, "Replay has %u tanks, the scenario has %d\n", replay.get_header().num_tanks, static_cast<int>(env.tank_vec.size()));
+            return -1;
+        }
+    }
+    else {
+        if (env_init(env, scenario) == false) {
+            return -1;
+        }
+        if (tick_rate > 0.0) {
+            env.tick_time = static_cast<float>(1.0 / tick_rate);
+        }
+    }
+    ScriptedTankInputSource script(env);
+    env.p_input = replay_path != NULL ? static_cast<TankInputSource *>(&replay) : &script;
+
+    // clients take over tanks from the script or replay, so record after them
+    NetServer server(env.p_input);
+    if (serve_addr != NULL) {
+        if (server.open(serve_addr, env) == false) {
+            return -1;
+        }
+        env.p_input = &server;
+    }
+
+    RecordingTankInputSource recorder;
+    if (record_path != NULL) {
+        if (recorder.open(record_path, env, env.p_input) == false) {
+            return -1;
+        }
+        env.p_input = &recorder;
+    }
+
+    FILE * hash_file = NULL;
+    if (hash_path != NULL) {
+        hash_file = fopen(hash_path, "w");
+        if (hash_file == NULL) {
+            fprintf(stderr, "Failed to open %s\n", hash_path);
+            return -1;
+        }
+    }
+
+    WorkerPool workers;
+    if (num_threads > 1) {
+        workers.init(num_threads);
+        env.p_workers = &workers;
+    }
+
+    printf("Running %ld ticks at %.1f Hz sim rate on %d threads%s\n", num_ticks, 1.0 / env.tick_time, workers.get_num_threads(), replay_path != NULL ? " (replay)" : "");
+    printf("World: %d obstacles, %d tanks, %d rain drops in [%.0f, %.0f] x [%.0f, %.0f]\n", static_cast<int>(env.obst_vec.size()), static_cast<int>(env.tank_vec.size()), env.rain.size(), env.scenario.bound.x_min, env.scenario.bound.x_max, env.scenario.bound.y_min, env.scenario.bound.y_max);
+
+    if (serve_addr != NULL && num_wait_clients > 0) {
+        printf("Waiting for %d clients on %s\n", num_wait_clients, serve_addr);
+        fflush(stdout);
+        while (server.get_num_clients() < num_wait_clients) {
+            server.poll();
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        }
+    }
+
+    // in serve mode ticks run in real time and their cost is measured alone
+    SteadyClock clock;
+    LogHistogram tick_hist;
+    double next_time = clock.get_time();
+    std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    for (long tick_cnt = 0; tick_cnt < num_ticks; tick_cnt ++) {
+        if (serve_addr != NULL) {
+            unsigned long long tick_start_ns = prof_get_ns();
+            env_tick(env, env.tick_time);
+            server.broadcast(env);
+            tick_hist.add(prof_get_ns() - tick_start_ns);
+            // after a stall, carry on from now instead of catching up
+            next_time = std::max(next_time + env.tick_time, clock.get_time() - env.tick_time);
+            clock.sleep_until(next_time);
+        }
+        else {
+            env_tick(env, env.tick_time);
+        }
+        if (hash_file != NULL) {
+            fprintf(hash_file, "%lu %016llx\n", env.tick_idx, env_get_state_hash(env));
+        }
+        if (profile_every > 0 && (tick_cnt + 1) % profile_every == 0) {
+            printf("ticks %ld - %ld:\n", tick_cnt + 1 - profile_every, tick_cnt);
+            prof_print(stdout, true);
+        }
+    }
+    double elapsed_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    recorder.close();
+    if (hash_file != NULL) {
+        fclose(hash_file);
+    }
+
+    int num_obst_alive = 0;
+    for (int obst_idx = 0; obst_idx < env.obst_vec.size(); obst_idx ++) {
+        num_obst_alive += env.obst_vec[obst_idx].get_is_activated() ? 1 : 0;
+    }
+    int num_tank_alive = 0;
+    for (int tank_idx = 0; tank_idx < env.tank_vec.size(); tank_idx ++) {
+        num_tank_alive += env.tank_vec[tank_idx].get_is_alive() ? 1 : 0;
+    }
+
+    printf("%ld ticks in %.3f s: %.0f ticks/sec (%.3f us/tick, %.1fx real time)\n",
+        num_ticks, elapsed_time, num_ticks / elapsed_time, elapsed_time * 1e6 / num_ticks, num_ticks * env.tick_time / elapsed_time);
+    printf("obstacles alive: %d / %d, tanks alive: %d / %d\n",
+        num_obst_alive, static_cast<int>(env.obst_vec.size()), num_tank_alive, static_cast<int>(env.tank_vec.size()));
+    printf("final state hash: %016llx\n", env_get_state_hash(env));
+    printf("ammo pool: %d live, high water %d / %d, %lu allocs failed\n",
+        env.ammo_pool.size(), env.ammo_pool.get_high_water_mark(), env.ammo_pool.get_capacity(), env.ammo_pool.get_num_alloc_failed());
+    prof_print(stdout, false);
+    if (serve_addr != NULL) {
+        printf("server tick (sim + broadcast): mean %.1f us, p50 < %.1f us, p99 < %.1f us, max %.1f us\n",
+            tick_hist.get_mean() * 1e-3, tick_hist.get_percentile(0.5) * 1e-3, tick_hist.get_percentile(0.99) * 1e-3, tick_hist.get_max() * 1e-3);
+        server.print_stats(stdout);
+        server.close();
+    }
+    trace_write();
+
+    return 0;
+}
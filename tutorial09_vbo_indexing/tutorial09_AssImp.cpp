@@ -40,7 +40,9 @@ Manu Feature:
 // Include standard headers
 #include <stdio.h>
 #include <stdlib.h>
+#include <stddef.h>
 #include <vector>
+#include <algorithm>
 #include <thread>
 
 // Include GLEW
@@ -60,15 +62,16 @@ using namespace glm;
 #include <common/controls.hpp>
 #include <common/objloader.hpp>
 #include <common/vboindexer.hpp>
+#include <common/frame_timer.hpp>
+#include <common/asset_registry.hpp>
+#include <common/frustum.hpp>
+#include <common/trace_recorder.hpp>
 
-
-#define MY_PI_HALF  (3.1415926f / 2.0f)
-#define BOUND_X_MIN     (-20.0f)
-#define BOUND_X_MAX     ( 20.0f)
-#define BOUND_Y_MIN     (-20.0f)
-#define BOUND_Y_MAX     ( 20.0f)
-#define BOUND_Z_MIN     ( -2.0f)
-#define BOUND_Z_MAX     ( 20.0f)
+#include <tanksim/environment.hpp>
+#include <tanksim/input_queue.hpp>
+#include <tanksim/replay.hpp>
+#include <tanksim/profiler.hpp>
+#include <tanksim/net_client.hpp>
 
 static const GLfloat g_ground_vect_buf_data[] = {
     -1.0f,-1.0f, 0.0f,
@@ -97,648 +100,194 @@ static const GLfloat g_ground_norm_buf_data[] = {
     0.000f,  0.000f,  1.000f,
 };
 
+static glm::mat4 get_render_model_matrix(RenderSphere_s const & rs) {
+    glm::mat4 scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(rs.scale, rs.scale, rs.scale));
+    glm::mat4 trans_mat = glm::translate(glm::mat4(), glm::vec3(rs.x, rs.y, rs.z));
+    glm::mat4 rotat_mat = glm::rotate( glm::mat4(1.0f), rs.angle_xy, glm::vec3(0, 0, 1) );
+    rotat_mat = glm::rotate( rotat_mat, rs.angle_z, glm::vec3(0, 1, 0) );
+    glm::mat4 model_mat = trans_mat * rotat_mat * scale_mat;
+    return model_mat;
+}
 
-class Sphere {
-    protected:
-    float x;
-    float y;
-    float z;
-    float r;
-
-    public:
-    Sphere(float x, float y, float z, float r) : x{x}, y{y}, z{z}, r{r} {}
-
-    static bool get_relation(Sphere const & a, Sphere const & b, float & angle_xy, float & angle_z, float & dist) {
-        if (&a == &b) {
-            angle_xy = 0.0f;
-            angle_z = 0.0f;
-            dist = 0.0f;
-            return false;
-        }
-        float x_diff = b.x - a.x;
-        float y_diff = b.y - a.y;
-        float z_diff = b.z - a.z;
-        float x_diff_sq = x_diff * x_diff;
-        float y_diff_sq = y_diff * y_diff;
-        float z_diff_sq = z_diff * z_diff;
-        angle_xy = atan2(y_diff, x_diff);
-        angle_z = atan2(z_diff_sq, x_diff_sq + y_diff_sq);
-        dist = sqrt(x_diff_sq + y_diff_sq + z_diff_sq);
-        return true;
-    }
-
-    static bool check_is_out_of_bound(Sphere const &a, float x_min, float x_max, float y_min, float y_max, float z_min, float z_max) {
-        return (a.x < x_min) || (a.x > x_max) || (a.y < y_min) || (a.y > y_max) || (a.z < z_min) || (a.z > z_max);
-    }
-
-    static bool check_is_out_of_bound(Sphere const &a) {
-        return check_is_out_of_bound(a, BOUND_X_MIN, BOUND_X_MAX, BOUND_Y_MIN, BOUND_Y_MAX, BOUND_Z_MIN, BOUND_Z_MAX);
-    }
-
-    #define SPHERE_COLLISION_CHECK_TOLERANCE    (0.00001f)
-    static bool check_is_collided(Sphere const & a, Sphere const & b) {
-        if (&a == &b) {
-            return false;
-        }
-        float x_diff = a.x - b.x;
-        float y_diff = a.y - b.y;
-        float z_diff = a.z - b.z;
-        float r_sum = a.r + b.r;
-        return (x_diff * x_diff + y_diff * y_diff + z_diff * z_diff) + SPHERE_COLLISION_CHECK_TOLERANCE < (r_sum * r_sum);
-    }
-
-    float get_x() const {
-        return this->x;
-    }
-
-    float get_y() const {
-        return this->y;
-    }
-
-    float get_z() const {
-        return this->z;
-    }
-
-    float get_r() const {
-        return this->r;
-    }
-
-    bool get_relation(Sphere const & b, float & angle_xy, float & angle_z, float & dist) const {
-        return Sphere::get_relation(*this, b, angle_xy, angle_z, dist);
-    }
-
-    bool check_is_out_of_bound(float x_min, float x_max, float y_min, float y_max, float z_min, float z_max) const {
-        return Sphere::check_is_out_of_bound(*this, x_min, x_max, y_min, y_max, z_min, z_max);
-    }
-
-    bool check_is_out_of_bound() const {
-        return Sphere::check_is_out_of_bound(*this);
-    }
-
-    bool check_is_collided(Sphere const & b) const {
-        return Sphere::check_is_collided(*this, b);
-    }
-
-    bool move(float angle_xy, float angle_z, float dist) {
-        float x_diff = dist * cos(angle_z) * cos(angle_xy);
-        float y_diff = dist * cos(angle_z) * sin(angle_xy);
-        float z_diff = dist * sin(angle_z);
-        this->x += x_diff;
-        this->y += y_diff;
-        this->z += z_diff;
-        return true;
-    }
-
-    glm::mat4 get_model_matrix() const {
-        glm::mat4 scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(this->r, this->r, this->r));
-        glm::mat4 trans_mat = glm::translate(glm::mat4(), glm::vec3(this->x, this->y, this->z));
-        glm::mat4 rotat_mat = glm::rotate( glm::mat4(1.0f), 0.0f, glm::vec3(0, 0, 1) );
-        glm::mat4 model_mat = trans_mat * rotat_mat * scale_mat;
-        return model_mat;
-    }
-};
-
-class Obst : public Sphere {
-    #define OBST_DEFAULT_HEALTH                 (10.0f)
-    #define OBST_DEFAULT_TIMER_IS_HIT           (0.1f)
-
-    float health;
-    float timer_is_hit;
-
-    public:
-    Obst(float x, float y, float z, float r) : Sphere(x, y, z, r), health{OBST_DEFAULT_HEALTH}, timer_is_hit{0.0f} {}
-
-    bool get_is_activated() const {
-        return this->health > 0.0f;
-    }
-
-    bool set_is_activated(bool is_activated) {
-        if (is_activated) {
-            this->health = OBST_DEFAULT_HEALTH;
-        }
-        else {
-            this->health = 0.0f;
-        }
-        return true;
-    }
-
-    bool get_is_hit() const {
-        return this->timer_is_hit > 0.0f;
-    }
-
-    bool set_is_hit(bool is_hit) {
-        if (is_hit) {
-            this->timer_is_hit = OBST_DEFAULT_TIMER_IS_HIT;
-        }
-        else {
-            this->timer_is_hit = 0.0f;
-        }
-        return true;
-    }
-
-    bool reduce_health(float amount) {
-        if (this->health > 0.0f) {
-            this->health -= amount;
-            return true;
-        }
-        else {
-            return false;
-        }
-    }
-
-    bool refreash(float time) {
-        if (this->timer_is_hit > 0.0f) {
-            this->timer_is_hit -= time;
-        }
-        return true;
-    }
-
-    glm::mat4 get_model_matrix() const {
-        glm::mat4 scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(this->r, this->r, this->r));
-        glm::mat4 trans_mat = glm::translate(glm::mat4(), glm::vec3(this->x, this->y, this->z));
-        glm::mat4 rotat_mat = glm::rotate( glm::mat4(1.0f), 0.0f, glm::vec3(0, 0, 1) );
-        glm::mat4 model_mat = trans_mat * rotat_mat * scale_mat;
-        return model_mat;
-    }
-};
-
-class Ammo : public Sphere {
-    bool is_fired;
-    float angle_xy;
-    float angle_z;
-    float move_speed;
-
-    public:
-    Ammo() : Sphere(0.0f, 0.0f, 0.0f, 0.0f), is_fired{false} {}
-    Ammo(float x, float y, float z, float r, float angle_xy, float angle_z, float move_speed) : Sphere(x, y, z, r), angle_xy{angle_xy}, angle_z{angle_z}, move_speed{move_speed}, is_fired{true} {}
-
-    float get_angle_xy() const {
-        return this->angle_xy;
-    }
-
-    float get_angle_z() const {
-        return this->angle_z;
-    }
-
-    float get_move_speed() const {
-        return this->move_speed;
-    }
-
-    bool get_is_fired() const {
-        return this->is_fired;
-    }
-
-    bool set_is_fired(bool is_fired) {
-        this->is_fired = is_fired;
-        return true;
-    }
-
-    bool refreash(float time) {
-        // do nothing
-        return true;
-    }
-
-    #define AMMO_R_TO_SIZE_RATIO            (3.0f)
-    #define AMMO_ROTATE_OFFS_ANGLE_XY       (MY_PI_HALF * 2.0f)
-    glm::mat4 get_model_matrix() const {
-        glm::mat4 scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(this->r * AMMO_R_TO_SIZE_RATIO, this->r * AMMO_R_TO_SIZE_RATIO, this->r * AMMO_R_TO_SIZE_RATIO));
-        glm::mat4 trans_mat = glm::translate(glm::mat4(), glm::vec3(this->x, this->y, this->z));
-        glm::mat4 rotat_mat = glm::rotate( glm::mat4(1.0f), this->angle_xy + AMMO_ROTATE_OFFS_ANGLE_XY, glm::vec3(0, 0, 1) );
-        rotat_mat = glm::rotate( rotat_mat, this->angle_z, glm::vec3(0, 1, 0) );
-        glm::mat4 model_mat = trans_mat * rotat_mat * scale_mat;
-
-        return model_mat;
-    }
-};
-
-class Tank : public Sphere {
-    #define TANK_DEFAULT_HEALTH                 (20.0f)
-    #define TANK_DEFAULT_TURN_SPEED             (MY_PI_HALF / 2.0f)
-    #define TANK_DEFAULT_MOVE_SPEED             (5.0f)
-    #define TANK_DEFAULT_MAX_NUM_AMMO           (12)
-    #define TANK_DEFAULT_TIMER_IS_HIT           (0.1f)
-    #define TANK_DEFAULT_TIMER_IS_COOLING_FIRE  (0.05f)
-    #define TANK_DEFAULT_TIMER_IS_LOADING_AMMO  (0.8f)
-
-    float health;
-    float timer_is_hit;
-    float timer_is_cooling_fire;
-    float timer_is_loading_ammo;
-
-    int MAX_NUM_AMMO;
-    int num_ammo;
-    float move_speed;
-    float angle_xy;
-    float angle_z;
-    float turn_speed;
-
-    public:
-    Tank(float x, float y, float z, float r) : Sphere(x, y, z, r), angle_xy{0.0f}, angle_z{0.0f}, turn_speed{TANK_DEFAULT_TURN_SPEED}, move_speed{TANK_DEFAULT_MOVE_SPEED}, MAX_NUM_AMMO{TANK_DEFAULT_MAX_NUM_AMMO}, num_ammo{TANK_DEFAULT_MAX_NUM_AMMO}, health{TANK_DEFAULT_HEALTH}, timer_is_hit{0.0f}, timer_is_cooling_fire{0.0f}, timer_is_loading_ammo{0.0f} { }
-
-    float get_angle_xy() const {
-        return this->angle_xy;
-    }
-
-    float get_angle_z() const {
-        return this->angle_z;
-    }
-
-    float get_move_speed() const {
-        return this->move_speed;
-    }
-
-    float get_turn_speed() const {
-        return this->turn_speed;
-    }
-
-    bool get_is_alive() const {
-        return this->health > 0.0f;
-    }
-
-    bool set_is_alive(bool is_alive) {
-        if (is_alive) {
-            this->health = TANK_DEFAULT_HEALTH;
-        }
-        else {
-            this->health = 0.0f;
-        }
-        return true;
-    }
-
-    bool get_is_hit() const {
-        return this->timer_is_hit > 0.0f;
-    }
-
-    bool set_is_hit(bool is_hit) {
-        if (is_hit) {
-            this->timer_is_hit = TANK_DEFAULT_TIMER_IS_HIT;
-        }
-        else {
-            this->timer_is_hit = 0.0f;
-        }
-        return true;
-    }
-
-    bool reduce_health(float amount) {
-        if (this->health > 0.0f) {
-            this->health -= amount;
-            return true;
-        }
-        else {
-            return false;
-        }
-    }
-
-    bool turn(float angle_xy) {
-        this->angle_xy += angle_xy * this->turn_speed;
-        return true;
-    }
-
-    #define TANK_R_TO_BARREL_Z_RATIO            (0.54f)
-    Ammo fire() {
-        Ammo ammo;
-        if (this->get_is_alive() == false || this->timer_is_cooling_fire > 0.0f || this->num_ammo <= 0) {
-            // ammo.is_fired() == false;
-        }
-        else {
-            this->timer_is_cooling_fire = TANK_DEFAULT_TIMER_IS_COOLING_FIRE;
-            this->num_ammo --;
-            ammo = Ammo(this->x, this->y, this->z + this->r * TANK_R_TO_BARREL_Z_RATIO, this->r / 4.0f, this->angle_xy, this->angle_z, this->move_speed * 5.0f);
-            ammo.move(ammo.get_angle_xy(), ammo.get_angle_z(), this->r + ammo.get_r());
-        }
-        return ammo;
-    }
-
-    bool refreash(float time) {
-        if (this->get_is_alive() == false) {
-            return false;
-        }
-        if (this->timer_is_hit > 0.0f) {
-            this->timer_is_hit -= time;
-        }
-        if (this->timer_is_cooling_fire > 0.0f) {
-            this->timer_is_cooling_fire -= time;
-        }
-        if (this->timer_is_loading_ammo > 0.0f) {
-            this->timer_is_loading_ammo -= time;
-        }
-        else {
-            if (this->num_ammo < this->MAX_NUM_AMMO) {
-                this->num_ammo ++;
-                this->timer_is_loading_ammo = TANK_DEFAULT_TIMER_IS_LOADING_AMMO;
-            }
-        }
-        return true;
-    }
-
-    #define TANK_R_TO_SIZE_RATIO                (0.35f)
-    glm::mat4 get_model_matrix() const {
-        glm::mat4 scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(this->r * TANK_R_TO_SIZE_RATIO, this->r * TANK_R_TO_SIZE_RATIO, this->r * TANK_R_TO_SIZE_RATIO));
-        glm::mat4 trans_mat = glm::translate(glm::mat4(), glm::vec3(this->x, this->y, this->z));
-        glm::mat4 rotat_mat = glm::rotate( glm::mat4(1.0f), this->angle_xy, glm::vec3(0, 0, 1) );
-        glm::mat4 model_mat = trans_mat * rotat_mat * scale_mat;
-
-        return model_mat;
-    }
-};
-
-typedef struct TankAction_s {
-    float turn_angle_xy;
-    float advance_dist;
-    int is_firing;
-}TankAction_s;
-
-static void get_tank_act_from_user_idx(TankAction_s & tank_act, int user_idx)
-{
-    tank_act.turn_angle_xy = 0.0f;
-    tank_act.advance_dist = 0.0f;
-    tank_act.is_firing = 0;
-
-    if (user_idx == 0) {
-        static int cnt = 0;
-        if (glfwGetKey( window, GLFW_KEY_W ) == GLFW_PRESS){
-            tank_act.advance_dist = 1.0f;
-        }
-        if (glfwGetKey( window, GLFW_KEY_S ) == GLFW_PRESS){
-            tank_act.advance_dist = -1.0f;
-        }
-        if (glfwGetKey( window, GLFW_KEY_A ) == GLFW_PRESS){
-            tank_act.turn_angle_xy = 1.0f;
-        }
-        if (glfwGetKey( window, GLFW_KEY_D ) == GLFW_PRESS){
-            tank_act.turn_angle_xy = -1.0f;
-        }
-        if (glfwGetKey( window, GLFW_KEY_F ) == GLFW_PRESS) {
-            cnt ++;
-        }
-        else if (cnt > 0) {
-            cnt --;
-        }
-
-        if (cnt > 150) {
-            cnt = 0;
-            tank_act.is_firing = 1;
-        }
-    }
-    else if (user_idx == 1) {
-        static int cnt = 0;
-        if (glfwGetKey( window, GLFW_KEY_I ) == GLFW_PRESS){
-            tank_act.advance_dist = 1.0f;
-        }
-        if (glfwGetKey( window, GLFW_KEY_K ) == GLFW_PRESS){
-            tank_act.advance_dist = -1.0f;
-        }
-        if (glfwGetKey( window, GLFW_KEY_J ) == GLFW_PRESS){
-            tank_act.turn_angle_xy = 1.0f;
-        }
-        if (glfwGetKey( window, GLFW_KEY_L ) == GLFW_PRESS){
-            tank_act.turn_angle_xy = -1.0f;
-        }
-        if (glfwGetKey( window, GLFW_KEY_H ) == GLFW_PRESS) {
-            cnt ++;
-        }
-        else if (cnt > 0) {
-            cnt --;
-        }
-
-        if (cnt > 150) {
-            cnt = 0;
-            tank_act.is_firing = 1;
-        }
-    }
-    else {
-        // do nothing
+// Draw categories frustum culled every frame, see cull_stats_print
+#define CULL_CATEGORY_OBST                  (0)
+#define CULL_CATEGORY_TANK                  (1)
+#define CULL_CATEGORY_AMMO                  (2)
+#define CULL_CATEGORY_RAIN                  (3)
+#define CULL_CATEGORY_SHADOW                (4)
+#define CULL_CATEGORY_NUM                   (5)
+
+static char const * const g_cull_category_names[CULL_CATEGORY_NUM] = {"obst", "tank", "ammo", "rain", "shadow"};
+
+// Rain shadows are the ground quad, corners at distance sqrt(2) from its center
+#define RAIN_SPOT_BOUND_R_PER_SCALE         (1.4143f)
+
+// Per-instance attributes of StandardShadingInstanced.vertexshader
+typedef struct RenderInstance_s {
+    glm::mat4 model_mat;        // locations 3 to 6, one column each
+    glm::vec3 color_added;      // location 7
+} RenderInstance_s;
+
+// Appends an instance per sphere of visible_idx_vec, which Frustum::cull_spheres
+// filled from rs_vec, tinted red if hit when is_hit_shown
+static void add_render_instances(std::vector<RenderInstance_s> & instance_vec, std::vector<RenderSphere_s> const & rs_vec, std::vector<int> const & visible_idx_vec, bool is_hit_shown) {
+    for (int visible_idx = 0; visible_idx < visible_idx_vec.size(); visible_idx ++) {
+        RenderSphere_s const & rs = rs_vec[visible_idx_vec[visible_idx]];
+        RenderInstance_s instance;
+        instance.model_mat = get_render_model_matrix(rs);
+        instance.color_added = is_hit_shown && rs.is_hit ? glm::vec3(255.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 0.0f, 0.0f);
+        instance_vec.push_back(instance);
     }
 }
 
-typedef struct Environment_s {
-    int is_terminated;
-    std::vector<Obst> obst_vec;
-    std::vector<Ammo> ammo_vec;
-    std::vector<Ammo> rain_vec;
-    std::vector<Tank> tank_vec;
-} Environment_s;
-
-static bool tank_move_and_check(Tank & tank, float angle_xy, float angle_z, float dist, Environment_s & env, int itr_cnt) {
-    if (itr_cnt > 10) {
-        return false;
-    }
-    if (tank.get_is_alive() == false) {
-        return false;
-    }
-    tank.move(angle_xy, angle_z, dist);
-    if (tank.check_is_out_of_bound()) {
-        tank.move(angle_xy, angle_z, -dist);
-        return false;
-    }
-    for (int obst_idx = 0; obst_idx < env.obst_vec.size(); obst_idx ++) {
-        Obst & obst = env.obst_vec[obst_idx];
-        if (obst.get_is_activated() && Sphere::check_is_collided(tank, obst)) {
-            obst.set_is_hit(true);
-            obst.reduce_health(0.00001);
-            tank.move(angle_xy, angle_z, -dist);
-            return false;
-        }
-    }
-    for (int tank_idx = 0; tank_idx < env.tank_vec.size(); tank_idx ++) {
-        Tank & tank_collided = env.tank_vec[tank_idx];
-        if (tank_collided.get_is_alive() && Sphere::check_is_collided(tank, tank_collided)) {
-            float angle_xy_collided = 0.0f;
-            float angle_z_collided = 0.0f;
-            float dist_collided = 0.0f;
-            Sphere::get_relation(tank, tank_collided, angle_xy_collided, angle_z_collided, dist_collided);
-            dist_collided = tank.get_r() + tank_collided.get_r() - dist_collided;
-            tank_collided.set_is_hit(true);
-            tank_collided.reduce_health(0.00001);
-            if (tank_move_and_check(tank_collided, angle_xy_collided, angle_z_collided, dist_collided, env, itr_cnt + 1)) {
-                break;
-            }
-            else {
-                tank.set_is_hit(true);
-                tank.reduce_health(0.00001);
-                tank.move(angle_xy, angle_z, -dist);
-                return false;
-            }
-        }
-    }
-    return true;
+// Uploads one category's instances, the category's vertex array already points at the buffer
+static void upload_render_instances(GLuint instance_buf, std::vector<RenderInstance_s> const & instance_vec) {
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+    // orphan last frame's storage so the driver need not wait for draws still reading it
+    glBufferData(GL_ARRAY_BUFFER, instance_vec.size() * sizeof(RenderInstance_s), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instance_vec.size() * sizeof(RenderInstance_s), instance_vec.data());
 }
 
-static bool ammo_move_and_check(Ammo & ammo, float angle_xy, float angle_z, float dist, Environment_s & env) {
-    if (ammo.get_is_fired() == false) {
-        return false;
-    }
-    ammo.move(angle_xy, angle_z, dist);
-    if (ammo.check_is_out_of_bound()) {
-        ammo.set_is_fired(false);
-        return false;
-    }
-    for (int obst_idx = 0; obst_idx < env.obst_vec.size(); obst_idx ++) {
-        Obst & obst = env.obst_vec[obst_idx];
-        if (obst.get_is_activated() && Sphere::check_is_collided(ammo, obst)) {
-            obst.set_is_hit(true);
-            obst.reduce_health(1.0f);
-            ammo.set_is_fired(false);
-            return false;
-        }
-    }
-    for (int tank_idx = 0; tank_idx < env.tank_vec.size(); tank_idx ++) {
-        Tank & tank_collided = env.tank_vec[tank_idx];
-        if (tank_collided.get_is_alive() && Sphere::check_is_collided(ammo, tank_collided)) {
-            float angle_xy_collided = 0.0f;
-            float angle_z_collided = 0.0f;
-            float dist_collided = 0.0f;
-            Sphere::get_relation(ammo, tank_collided, angle_xy_collided, angle_z_collided, dist_collided);
-            tank_collided.set_is_hit(true);
-            tank_collided.reduce_health(1.0f);
-            tank_move_and_check(tank_collided, angle_xy_collided, angle_z_collided, ammo.get_r(), env, 0);
-            ammo.set_is_fired(false);
-            return false;
-        }
-    }
-    return true;
+// Static buffer holding data, uploaded through GL_ARRAY_BUFFER since buffers are
+// untyped and an element buffer binding needs a vertex array to go into
+static GLuint create_static_buf(void const * p_data, size_t size) {
+    GLuint buf;
+    glGenBuffers(1, &buf);
+    glBindBuffer(GL_ARRAY_BUFFER, buf);
+    glBufferData(GL_ARRAY_BUFFER, size, p_data, GL_STATIC_DRAW);
+    return buf;
 }
 
-static bool rain_move_and_check(Ammo & rain, float angle_xy, float angle_z, float dist, Environment_s & env) {
-    if (rain.get_is_fired() == false) {
-        return false;
-    }
-    rain.move(angle_xy, angle_z, dist);
-    if (rain.check_is_out_of_bound()) {
-        rain.set_is_fired(false);
-        return false;
-    }
-    if (rain.get_is_fired()) {
-        for (int obst_idx = 0; obst_idx < env.obst_vec.size(); obst_idx ++) {
-            Obst & obst = env.obst_vec[obst_idx];
-            if (obst.get_is_activated() && Sphere::check_is_collided(rain, obst)) {
-                obst.set_is_hit(true);
-                obst.reduce_health(1.0f);
-                rain.set_is_fired(false);
-                return false;
-            }
-        }
-    }
-    if (rain.get_is_fired()) {
-        for (int tank_idx = 0; tank_idx < env.tank_vec.size(); tank_idx ++) {
-            Tank & tank = env.tank_vec[tank_idx];
-            if (tank.get_is_alive() && Sphere::check_is_collided(rain, tank)) {
-                tank.set_is_hit(true);
-                tank.reduce_health(1.0f);
-                rain.set_is_fired(false);
-                return false;
-            }
-        }
-    }
-    return true;
+// Vertex array for one draw category, configured once: the mesh's interleaved
+// vertices in attributes 0 to 2, its indices unless elem_buf is 0, and the
+// category's instances in attributes 3 to 7. Drawing then binds only this.
+static GLuint create_render_vao(GLuint vert_buf, GLuint elem_buf, GLuint instance_buf) {
+    GLuint vao;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+
+    // 1rst attribute : vertices, 2nd : UVs, 3rd : normals
+    glBindBuffer(GL_ARRAY_BUFFER, vert_buf);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, position));
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, uv));
+    glEnableVertexAttribArray(2);
+    glVertexAttribPointer(2, 3, GL_FLOAT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, normal));
+    if (elem_buf != 0) {
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elem_buf);
+    }
+
+    // model matrix columns and tint, advancing once per instance
+    glBindBuffer(GL_ARRAY_BUFFER, instance_buf);
+    for (int col_idx = 0; col_idx < 4; col_idx ++) {
+        glEnableVertexAttribArray(3 + col_idx);
+        glVertexAttribPointer(3 + col_idx, 4, GL_FLOAT, GL_FALSE, sizeof(RenderInstance_s), (void*)(offsetof(RenderInstance_s, model_mat) + sizeof(glm::vec4) * col_idx));
+        glVertexAttribDivisor(3 + col_idx, 1);
+    }
+    glEnableVertexAttribArray(7);
+    glVertexAttribPointer(7, 3, GL_FLOAT, GL_FALSE, sizeof(RenderInstance_s), (void*)offsetof(RenderInstance_s, color_added));
+    glVertexAttribDivisor(7, 1);
+
+    glBindVertexArray(0);
+    return vao;
 }
 
-static bool env_init(Environment_s & env) {
-    env.is_terminated = 0;
+// Same for a registry mesh, 0 if it failed to load
+static GLuint create_render_vao(MeshAsset_s const * p_mesh, GLuint instance_buf) {
+    return p_mesh != NULL ? create_render_vao(p_mesh->vert_buf, p_mesh->elem_buf, instance_buf) : 0;
+}
 
-    srand(0);
+// Draws one category's instances of an indexed mesh at level of detail lod,
+// nothing if the mesh failed to load
+static void draw_mesh_instances(MeshAsset_s const * p_mesh, GLuint vao, GLuint instance_buf, std::vector<RenderInstance_s> const & instance_vec, int lod) {
+    if (p_mesh == NULL || instance_vec.empty()) {
+        return;
+    }
+    glBindVertexArray(vao);
+    upload_render_instances(instance_buf, instance_vec);
+
+    // Draw the triangles !
+    glDrawElementsInstanced(
+        GL_TRIANGLES,      // mode
+        p_mesh->lod_elem_cnt[lod],    // count
+        GL_UNSIGNED_SHORT,   // type
+        (void*)(p_mesh->lod_elem_start[lod] * sizeof(unsigned short)),          // element array buffer offset
+        instance_vec.size()     // instance count
+    );
+}
 
-    for (int obst_idx = 0; obst_idx < 20; obst_idx ++) {
-        float x = BOUND_X_MIN + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (BOUND_X_MAX - BOUND_X_MIN)));
-        float y = BOUND_Y_MIN + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (BOUND_Y_MAX - BOUND_Y_MIN)));
-        float z = 1.0f;
-        float r = 1.0f;
+// Tanks switch to a coarser level below these projected heights in pixels,
+// and back only once TANK_LOD_HYSTERESIS above, so none flickers on the line
+#define TANK_MESH_MAX_LODS                  (4)
+#define TANK_LOD_HYSTERESIS                 (0.15f)
+static float const g_tank_lod_min_px[TANK_MESH_MAX_LODS] = {0.0f, 96.0f, 48.0f, 24.0f};
 
-        Obst obstacle(x, y, z, r);
-        env.obst_vec.push_back(obstacle);
+static int select_tank_lod(float size_px, int lod, int num_lods) {
+    lod = std::min(lod, num_lods - 1);
+    while (lod + 1 < num_lods && size_px < g_tank_lod_min_px[lod + 1] * (1.0f - TANK_LOD_HYSTERESIS)) {
+        lod ++;
     }
-
-    for (int rain_idx = 0; rain_idx < 20; rain_idx ++) {
-        Ammo rain;
-        env.rain_vec.push_back(rain);
+    while (lod > 0 && size_px > g_tank_lod_min_px[lod] * (1.0f + TANK_LOD_HYSTERESIS)) {
+        lod --;
     }
-
-    env.tank_vec.push_back(Tank(-5.0f, -5.0f, 0.0f, 2.0f));
-    env.tank_vec.push_back(Tank(5.0f, 5.0f, 0.0f, 2.0f));
-
-    return true;
+    return lod;
 }
 
-static bool env_refresh(Environment_s & env, float time) {
-    for (int obst_idx = 0; obst_idx < env.obst_vec.size(); obst_idx ++) {
-        Obst & obst = env.obst_vec[obst_idx];
-        if (obst.get_is_activated()) {
-            obst.refreash(time);
-        }
-    }
-
-    for (int tank_idx = 0; tank_idx < env.tank_vec.size(); tank_idx ++) {
-        Tank & tank = env.tank_vec[tank_idx];
-        if (tank.get_is_alive()) {
-            tank.refreash(time);
-        }
-    }
-
-    return true;
+static GLuint get_texture_id(TextureAsset_s const * p_texture) {
+    return p_texture != NULL ? p_texture->texture : 0;
 }
 
+static float get_mesh_bound_r(MeshAsset_s const * p_mesh) {
+    return p_mesh != NULL ? p_mesh->bound_r : 0.0f;
+}
 
-static void env_proc_main(Environment_s * p_arg) {
-    // glfwGetTime is called only once, the first time this function is called
-    static double last_time = glfwGetTime();
-
-    while (p_arg != NULL && p_arg->is_terminated == 0) {
-        Environment_s & env = *p_arg;
-
-        // Compute time difference between current and last frame
-        double curr_time = glfwGetTime();
-        float delta_time = float(curr_time - last_time);
-        last_time = curr_time;
-
-        env_refresh(env, delta_time);
-
-        TankAction_s tank_act;
-        for (int tank_idx = 0; tank_idx < p_arg->tank_vec.size(); tank_idx ++) {
-            Tank & tank = p_arg->tank_vec[tank_idx];
-
-            get_tank_act_from_user_idx(tank_act, tank_idx);
-            tank.turn(tank_act.turn_angle_xy * delta_time);
-            tank_move_and_check(tank, tank.get_angle_xy(), tank.get_angle_z(), tank_act.advance_dist * delta_time, env, 0);
-            if (tank_act.is_firing == 1) {
-                p_arg->ammo_vec.push_back(tank.fire());
-            }
-        }
+// Key bindings: GLFW key, player, tank key
+static int const g_tank_key_map[][3] = {
+    {GLFW_KEY_W, 0, TANK_KEY_FORWARD},
+    {GLFW_KEY_S, 0, TANK_KEY_BACKWARD},
+    {GLFW_KEY_A, 0, TANK_KEY_LEFT},
+    {GLFW_KEY_D, 0, TANK_KEY_RIGHT},
+    {GLFW_KEY_F, 0, TANK_KEY_FIRE},
+    {GLFW_KEY_I, 1, TANK_KEY_FORWARD},
+    {GLFW_KEY_K, 1, TANK_KEY_BACKWARD},
+    {GLFW_KEY_J, 1, TANK_KEY_LEFT},
+    {GLFW_KEY_L, 1, TANK_KEY_RIGHT},
+    {GLFW_KEY_H, 1, TANK_KEY_FIRE},
+};
 
-        auto ammo_itr = p_arg->ammo_vec.begin();
-        while (ammo_itr != p_arg->ammo_vec.end()) {
-            ammo_move_and_check((*ammo_itr), ammo_itr->get_angle_xy(), ammo_itr->get_angle_z(), ammo_itr->get_move_speed() * delta_time, env);
-            if (ammo_itr->get_is_fired()) {
-                ammo_itr ++;
-            }
-            else {
-                ammo_itr = p_arg->ammo_vec.erase(ammo_itr);
-            }
-        }
+// Set in main() before the window delivers any key
+static QueuedTankInputSource * g_p_input = NULL;
 
-        for (int rain_idx = 0; rain_idx < p_arg->rain_vec.size(); rain_idx ++) {
-            Ammo & rain = p_arg->rain_vec[rain_idx];
-            rain_move_and_check(rain, rain.get_angle_xy(), rain.get_angle_z(), rain.get_move_speed() * delta_time, env);
-            if (rain.get_is_fired() == false) {
-                rain = Ammo(
-                BOUND_X_MIN + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (BOUND_X_MAX - BOUND_X_MIN))),
-                BOUND_Y_MIN + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (BOUND_Y_MAX - BOUND_Y_MIN))),
-                BOUND_Z_MAX,
-                0.5f,
-                0.0f,
-                -MY_PI_HALF,
-                1.0f + static_cast<float>(rand()) / (static_cast<float>(RAND_MAX / (5.0f - 1.0f))));
-            }
+// Runs on the main thread inside glfwPollEvents; only forwards transitions,
+// the sim thread never touches GLFW
+static void tank_key_callback(GLFWwindow * window, int key, int scancode, int action, int mods) {
+    if (g_p_input == NULL || action == GLFW_REPEAT) {
+        return;
+    }
+    for (int map_idx = 0; map_idx < sizeof(g_tank_key_map) / sizeof(g_tank_key_map[0]); map_idx ++) {
+        if (g_tank_key_map[map_idx][0] == key) {
+            g_p_input->push_key(g_tank_key_map[map_idx][1], g_tank_key_map[map_idx][2], action == GLFW_PRESS);
         }
-
-        // printf("p_arg->ammo_vec.size() = %d\n", p_arg->ammo_vec.size());
-
-        // Compute the MVP matrix from keyboard and mouse input
-        computeMatricesFromInputs();
     }
 }
 
+// FrameTimer sync function: waits until the GPU has finished the section
+static void frame_timer_sync() {
+    glFinish();
+}
+
 
 int main( void ) {
+    // TANK_TRACE=path records startup, render and sim zones and writes them on
+    // exit as a Chrome trace, open it in chrome://tracing or ui.perfetto.dev
+    char const * trace_path = getenv("TANK_TRACE");
+    if (trace_path != NULL) {
+        trace_start(trace_path);
+    }
+    trace_set_thread_name("render");
+    TraceZone startup_zone("startup");
+
     // Initialise GLFW
     if( !glfwInit() ) {
         fprintf( stderr, "Failed to initialize GLFW\n" );
@@ -791,17 +340,13 @@ int main( void ) {
     // Cull triangles which normal is not towards the camera
     // glEnable(GL_CULL_FACE);
 
-    GLuint VertexArrayID;
-    glGenVertexArrays(1, &VertexArrayID);
-    glBindVertexArray(VertexArrayID);
+    // Create and compile our GLSL program from the shaders, every category is
+    // drawn in one call with the model matrix and tint as instance attributes
+    GLuint programID = LoadShaders( "StandardShadingInstanced.vertexshader", "StandardShadingInstanced.fragmentshader" );
 
-    // Create and compile our GLSL program from the shaders
-    GLuint programID = LoadShaders( "StandardShading.vertexshader", "StandardShading.fragmentshader" );
-
-    // Get a handle for our "MVP" uniform
-    GLuint MatrixID = glGetUniformLocation(programID, "MVP");
+    // Get a handle for our "VP" uniform
+    GLuint MatrixID = glGetUniformLocation(programID, "VP");
     GLuint ViewMatrixID = glGetUniformLocation(programID, "V");
-    GLuint ModelMatrixID = glGetUniformLocation(programID, "M");
 
     // Get a handle for our "myTextureSampler" uniform
     GLuint TextureID  = glGetUniformLocation(programID, "myTextureSampler");
@@ -809,178 +354,166 @@ int main( void ) {
     // Get a handle for our "LightPosition" uniform
     GLuint LightID = glGetUniformLocation(programID, "LightPosition_worldspace");
 
-    GLuint ColorAddedID = glGetUniformLocation(programID, "MaterialDiffuseColor_Added");
-
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec2> uvs;
-    std::vector<glm::vec3> normals;
+    // One instance buffer per category, refilled every frame
+    GLuint ground_inst_buf;
+    GLuint obst_inst_buf;
+    GLuint tank_inst_buf;
+    GLuint ammo_inst_buf;
+    GLuint rain_inst_buf;
+    GLuint spot_inst_buf;
+    glGenBuffers(1, &ground_inst_buf);
+    glGenBuffers(1, &obst_inst_buf);
+    glGenBuffers(1, &tank_inst_buf);
+    glGenBuffers(1, &ammo_inst_buf);
+    glGenBuffers(1, &rain_inst_buf);
+    glGenBuffers(1, &spot_inst_buf);
+    std::vector<RenderInstance_s> instance_vec;
+    // TANK_CULL=0 draws every live entity, to compare against frustum culling
+    Frustum frustum;
+    bool is_culling = getenv("TANK_CULL") == NULL || atoi(getenv("TANK_CULL")) != 0;
+    std::vector<int> visible_idx_vec;
+    CullStats_s cull_window_stats[CULL_CATEGORY_NUM] = {};
+    CullStats_s cull_total_stats[CULL_CATEGORY_NUM] = {};
+    // TANK_LOD=0 draws every tank at full detail
+    bool is_tank_lod_used = getenv("TANK_LOD") == NULL || atoi(getenv("TANK_LOD")) != 0;
+    std::vector<int> tank_lod_vec;                  // current level of every tank, for the hysteresis
+    std::vector<int> tank_lod_idx_vec[TANK_MESH_MAX_LODS];
+    unsigned long long tank_lod_window_cnt[TANK_MESH_MAX_LODS] = {};
+    unsigned long long tank_window_num_tris = 0;
+    int window_num_frames = 0;
+
+    // Meshes and textures by path, each file is loaded once however many users it has
+    AssetRegistry assets;
 
     /*****************************************************************************/
     /******************************** LOAD GROUND ********************************/
     /*****************************************************************************/
 
-    GLuint ground_texture = loadBMP_custom("ground.bmp");
+    TextureAsset_s const * p_ground_texture = assets.acquire_texture("ground.bmp");
 
-    GLuint ground_vert_buf;
-    glGenBuffers(1, &ground_vert_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, ground_vert_buf);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(g_ground_vect_buf_data), g_ground_vect_buf_data, GL_STATIC_DRAW);
-
-    GLuint ground_uv_buf;
-    glGenBuffers(1, &ground_uv_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, ground_uv_buf);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(g_ground_uv_buf_data) * sizeof(glm::vec2), g_ground_uv_buf_data, GL_STATIC_DRAW);
-
-    GLuint ground_norm_buf;
-    glGenBuffers(1, &ground_norm_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, ground_norm_buf);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(g_ground_norm_buf_data), g_ground_norm_buf_data, GL_STATIC_DRAW);
-
-    /*****************************************************************************/
-    /******************************** LOAD OBST **********************************/
-    /*****************************************************************************/
-
-    GLuint obst_texture = loadDDS("box.dds");
-    std::vector<unsigned short> obst_indices;
-    std::vector<glm::vec3> obst_indexed_vertices;
-    std::vector<glm::vec2> obst_indexed_uvs;
-    std::vector<glm::vec3> obst_indexed_normals;
-    vertices.clear();
-    uvs.clear();
-    normals.clear();
-    bool is_obst_loaded = loadOBJ("box.obj", vertices, uvs, normals);
-    indexVBO(vertices, uvs, normals, obst_indices, obst_indexed_vertices, obst_indexed_uvs, obst_indexed_normals);
-    if (is_obst_loaded == false)
-    {
-        printf("Failed to load obj\n");
+    // interleave the ground quad like the indexed meshes
+    int const ground_vert_cnt = sizeof(g_ground_vect_buf_data) / (3 * sizeof(GLfloat));
+    std::vector<PackedVertex> ground_packed_vertices(ground_vert_cnt);
+    for (int vert_idx = 0; vert_idx < ground_vert_cnt; vert_idx ++) {
+        PackedVertex & packed = ground_packed_vertices[vert_idx];
+        packed.position = glm::vec3(g_ground_vect_buf_data[3 * vert_idx], g_ground_vect_buf_data[3 * vert_idx + 1], g_ground_vect_buf_data[3 * vert_idx + 2]);
+        packed.uv = glm::vec2(g_ground_uv_buf_data[2 * vert_idx], g_ground_uv_buf_data[2 * vert_idx + 1]);
+        packed.normal = glm::vec3(g_ground_norm_buf_data[3 * vert_idx], g_ground_norm_buf_data[3 * vert_idx + 1], g_ground_norm_buf_data[3 * vert_idx + 2]);
     }
-
-    GLuint obst_vect_buf;
-    glGenBuffers(1, &obst_vect_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, obst_vect_buf);
-    glBufferData(GL_ARRAY_BUFFER, obst_indexed_vertices.size() * sizeof(glm::vec3), &obst_indexed_vertices[0], GL_STATIC_DRAW);
-
-    GLuint obst_uv_buf;
-    glGenBuffers(1, &obst_uv_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, obst_uv_buf);
-    glBufferData(GL_ARRAY_BUFFER, obst_indexed_uvs.size() * sizeof(glm::vec2), &obst_indexed_uvs[0], GL_STATIC_DRAW);
-
-    GLuint obst_norm_buf;
-    glGenBuffers(1, &obst_norm_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, obst_norm_buf);
-    glBufferData(GL_ARRAY_BUFFER, obst_indexed_normals.size() * sizeof(glm::vec3), &obst_indexed_normals[0], GL_STATIC_DRAW);
-
-    GLuint obst_elem_buf;
-    glGenBuffers(1, &obst_elem_buf);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obst_elem_buf);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, obst_indices.size() * sizeof(unsigned short), &obst_indices[0] , GL_STATIC_DRAW);
+    GLuint ground_vert_buf = create_static_buf(&ground_packed_vertices[0], ground_packed_vertices.size() * sizeof(PackedVertex));
 
     /*****************************************************************************/
-    /******************************** LOAD TANK **********************************/
+    /**************************** LOAD OBST, TANK, AMMO **************************/
     /*****************************************************************************/
 
-    GLuint tank_texture = loadDDS("tank.dds");
-    std::vector<unsigned short> tank_indices;
-    std::vector<glm::vec3> tank_indexed_vertices;
-    std::vector<glm::vec2> tank_indexed_uvs;
-    std::vector<glm::vec3> tank_indexed_normals;
-    vertices.clear();
-    uvs.clear();
-    normals.clear();
-    bool is_tank_loaded = loadOBJ("tank.obj", vertices, uvs, normals);
-    indexVBO(vertices, uvs, normals, tank_indices, tank_indexed_vertices, tank_indexed_uvs, tank_indexed_normals);
-    if (is_tank_loaded == false)
-    {
-        printf("Failed to load obj\n");
-    }
-
-    GLuint tank_vect_buf;
-    glGenBuffers(1, &tank_vect_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, tank_vect_buf);
-    glBufferData(GL_ARRAY_BUFFER, tank_indexed_vertices.size() * sizeof(glm::vec3), &tank_indexed_vertices[0], GL_STATIC_DRAW);
-
-    GLuint tank_uv_buf;
-    glGenBuffers(1, &tank_uv_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, tank_uv_buf);
-    glBufferData(GL_ARRAY_BUFFER, tank_indexed_uvs.size() * sizeof(glm::vec2), &tank_indexed_uvs[0], GL_STATIC_DRAW);
+    TextureAsset_s const * p_obst_texture = assets.acquire_texture("box.dds");
+    MeshAsset_s const * p_obst_mesh = assets.acquire_mesh("box.obj");
 
-    GLuint tank_norm_buf;
-    glGenBuffers(1, &tank_norm_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, tank_norm_buf);
-    glBufferData(GL_ARRAY_BUFFER, tank_indexed_normals.size() * sizeof(glm::vec3), &tank_indexed_normals[0], GL_STATIC_DRAW);
-
-    GLuint tank_elem_buf;
-    glGenBuffers(1, &tank_elem_buf);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tank_elem_buf);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, tank_indices.size() * sizeof(unsigned short), &tank_indices[0] , GL_STATIC_DRAW);
+    TextureAsset_s const * p_tank_texture = assets.acquire_texture("tank.dds");
+    MeshAsset_s const * p_tank_mesh = assets.acquire_mesh("tank.obj", TANK_MESH_MAX_LODS);
 
+    // no bullet.dds yet, the ammo shares the tank texture
+    TextureAsset_s const * p_ammo_texture = assets.acquire_texture("tank.dds");
+    MeshAsset_s const * p_ammo_mesh = assets.acquire_mesh("bomb.obj");
+    if (p_ammo_mesh == NULL) {
+        printf("Ammo and rain are not drawn without bomb.obj\n");
+    }
 
+    assets.print(stdout);
 
     /*****************************************************************************/
-    /******************************** LOAD AMMO **********************************/
+    /******************************* VERTEX ARRAYS *******************************/
     /*****************************************************************************/
 
-    GLuint ammo_texture = loadDDS("tank.dds");
-    // GLuint ammo_texture = loadDDS("bullet.dds");
-
-    // Read our .obj file
-    std::vector<unsigned short> ammo_indices;
-    std::vector<glm::vec3> ammo_indexed_vertices;
-    std::vector<glm::vec2> ammo_indexed_uvs;
-    std::vector<glm::vec3> ammo_indexed_normals;
-    vertices.clear();
-    uvs.clear();
-    normals.clear();
-    bool is_ammo_loaded = loadOBJ("bomb.obj", vertices, uvs, normals);
-    indexVBO(vertices, uvs, normals, ammo_indices, ammo_indexed_vertices, ammo_indexed_uvs, ammo_indexed_normals);
-    if (is_ammo_loaded == false)
-    {
-        printf("Failed to load ammo obj\n");
-    }
-
-    GLuint ammo_vect_buf;
-    glGenBuffers(1, &ammo_vect_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, ammo_vect_buf);
-    glBufferData(GL_ARRAY_BUFFER, ammo_indexed_vertices.size() * sizeof(glm::vec3), &ammo_indexed_vertices[0], GL_STATIC_DRAW);
-
-    GLuint ammo_uv_buf;
-    glGenBuffers(1, &ammo_uv_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, ammo_uv_buf);
-    glBufferData(GL_ARRAY_BUFFER, ammo_indexed_uvs.size() * sizeof(glm::vec2), &ammo_indexed_uvs[0], GL_STATIC_DRAW);
-
-    GLuint ammo_norm_buf;
-    glGenBuffers(1, &ammo_norm_buf);
-    glBindBuffer(GL_ARRAY_BUFFER, ammo_norm_buf);
-    glBufferData(GL_ARRAY_BUFFER, ammo_indexed_normals.size() * sizeof(glm::vec3), &ammo_indexed_normals[0], GL_STATIC_DRAW);
-
-    GLuint ammo_elem_buf;
-    glGenBuffers(1, &ammo_elem_buf);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ammo_elem_buf);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, ammo_indices.size() * sizeof(unsigned short), &ammo_indices[0] , GL_STATIC_DRAW);
-
-
+    // rain drops reuse the ammo mesh and rain shadows the ground quad
+    GLuint ground_vao = create_render_vao(ground_vert_buf, 0, ground_inst_buf);
+    GLuint obst_vao = create_render_vao(p_obst_mesh, obst_inst_buf);
+    GLuint tank_vao = create_render_vao(p_tank_mesh, tank_inst_buf);
+    GLuint ammo_vao = create_render_vao(p_ammo_mesh, ammo_inst_buf);
+    GLuint rain_vao = create_render_vao(p_ammo_mesh, rain_inst_buf);
+    GLuint spot_vao = create_render_vao(ground_vert_buf, 0, spot_inst_buf);
 
     glUseProgram(programID);
 
     // For speed computation
     double lastTime = glfwGetTime();
-    int nbFrames = 0;
+    // TANK_FRAME_CSV=path writes one row of section times per frame on exit,
+    // TANK_FRAME_SYNC=1 waits for the GPU after every section so they include its work
+    FrameTimer frame_timer;
+    char const * frame_csv_path = getenv("TANK_FRAME_CSV");
+    frame_timer.set_is_recording_rows(frame_csv_path != NULL);
+    if (getenv("TANK_FRAME_SYNC") != NULL) {
+        frame_timer.set_sync_fn(frame_timer_sync);
+    }
 
     Environment_s env;
     env_init(env);
-    std::thread env_proc_thread(env_proc_main, &env);
+    // key events are timestamped with the same clock the sim thread paces ticks with
+    SteadyClock input_clock;
+    QueuedTankInputSource input(input_clock);
+    input.set_is_latency_logged(getenv("TANK_INPUT_LATENCY") != NULL);
+    env.p_input = &input;
+    g_p_input = &input;
+    glfwSetKeyCallback(window, tank_key_callback);
+    char const * tick_rate_str = getenv("TANK_TICK_RATE");
+    if (tick_rate_str != NULL && atof(tick_rate_str) > 0.0) {
+        env.tick_time = static_cast<float>(1.0 / atof(tick_rate_str));
+    }
+    // TANK_CONNECT=unix:path|[host:]port renders a tanksim_headless --serve
+    // instead of a local sim, the WASD keys drive the tank it hands out
+    NetClient client;
+    char const * connect_addr = getenv("TANK_CONNECT");
+    if (connect_addr != NULL) {
+        if (client.connect(connect_addr) == false || client.wait_welcome(5000) == false) {
+            glfwTerminate();
+            return -1;
+        }
+        env.tick_time = client.get_tick_time();
+        env.scenario.bound = client.get_bound();
+        printf("Connected to %s, %s\n", connect_addr, client.get_tank_idx() >= 0 ? "driving a tank" : "watching");
+    }
+    // TANK_RECORD=path logs every tank action, replay it with tanksim_headless --replay path
+    RecordingTankInputSource recorder;
+    char const * record_path = getenv("TANK_RECORD");
+    if (record_path != NULL && connect_addr == NULL && recorder.open(record_path, env, env.p_input)) {
+        env.p_input = &recorder;
+    }
+    // TANK_PROFILE=seconds prints the sim phase timings that often and in full on exit,
+    // needs a build with the TANKSIM_PROFILE option
+    char const * profile_str = getenv("TANK_PROFILE");
+    double profile_period = profile_str != NULL ? atof(profile_str) : 0.0;
+    double lastProfileTime = lastTime;
+    std::thread env_proc_thread = connect_addr != NULL ? std::thread(net_client_proc_main, &env, &client) : std::thread(env_proc_main, &env);
+    startup_zone.end();
 
     do{
 
         // Measure speed
+        frame_timer.begin_frame();
         double currentTime = glfwGetTime();
-        nbFrames++;
         if ( currentTime - lastTime >= 1.0 ){ // If last prinf() was more than 1sec ago
             // printf and reset
-            printf("%f ms/frame\n", 1000.0/double(nbFrames));
-            nbFrames = 0;
+            frame_timer.print_window(stdout);
+            cull_stats_print(stdout, g_cull_category_names, cull_window_stats, CULL_CATEGORY_NUM);
+            printf("tank instances by LOD:");
+            for (int lod = 0; lod < TANK_MESH_MAX_LODS; lod ++) {
+                printf(" %llu", tank_lod_window_cnt[lod]);
+                tank_lod_window_cnt[lod] = 0;
+            }
+            printf(", %.0f tank triangles per frame\n", window_num_frames > 0 ? static_cast<double>(tank_window_num_tris) / window_num_frames : 0.0);
+            tank_window_num_tris = 0;
+            window_num_frames = 0;
+            for (int category = 0; category < CULL_CATEGORY_NUM; category ++) {
+                cull_total_stats[category].num_tested += cull_window_stats[category].num_tested;
+                cull_total_stats[category].num_visible += cull_window_stats[category].num_visible;
+                cull_window_stats[category] = CullStats_s();
+            }
             lastTime += 1.0;
         }
+        if ( profile_period > 0.0 && currentTime - lastProfileTime >= profile_period ){
+            prof_print(stdout, true);
+            lastProfileTime = currentTime;
+        }
 
         // Clear the screen
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -991,400 +524,182 @@ int main( void ) {
         glm::vec3 lightPos = glm::vec3(5, 5, 20);
         glUniform3f(LightID, lightPos.x, lightPos.y, lightPos.z);
 
+        // Latest world state published by env_proc_main or net_client_proc_main
+        env.snapshot_buf.fetch();
+        RenderSnapshot_s const & snapshot = env.snapshot_buf.get_front();
+
+        // Compute the MVP matrix from keyboard and mouse input
+        {
+            PROF_SCOPE(PROF_PHASE_CONTROLS);
+            TRACE_ZONE("controls");
+            computeMatricesFromInputs();
+        }
         glm::mat4 ProjectionMatrix = getProjectionMatrix();
         glm::mat4 ViewMatrix = getViewMatrix();
+        glm::mat4 vp_mat = ProjectionMatrix * ViewMatrix;
+        if (is_culling) {
+            frustum.set_view_proj(vp_mat);
+        }
 
         /*****************************************************************************/
         /******************************** DRAW GROUND ********************************/
         /*****************************************************************************/
 
+        frame_timer.begin_section(FRAME_SECTION_GROUND);
+
         glm::mat4 ground_scale_mat;
         glm::mat4 ground_rotate_mat;
         glm::mat4 ground_model_mat;
-        glm::mat4 ground_mvp_mat;
 
         ground_scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(20.0f, 20.0f, 20.0f));
         ground_rotate_mat = glm::rotate(ground_scale_mat, 0.0f, glm::vec3(1, 0, 0));
         ground_model_mat = ground_rotate_mat; // glm::mat4(1.0);
-        ground_mvp_mat = ProjectionMatrix * ViewMatrix * ground_model_mat;
 
         // Send our transformation to the currently bound shader,
-        // in the "MVP" uniform
-        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &ground_mvp_mat[0][0]);
-        glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ground_model_mat[0][0]);
+        // in the "VP" uniform, the model matrix is per instance
+        glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &vp_mat[0][0]);
         glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
-        glUniform3f(ColorAddedID, 0.0f, 0.0f, 0.0f);
 
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, ground_texture);
+        glBindTexture(GL_TEXTURE_2D, get_texture_id(p_ground_texture));
         glUniform1i(TextureID, 0);
 
-        // 1rst attribute buffer : vertices
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, ground_vert_buf);
-        glVertexAttribPointer(
-            0,                  // attribute. No particular reason for 0, but must match the layout in the shader.
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void*)0            // array buffer offset
-        );
-
-        // 2nd attribute buffer : UVs
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, ground_uv_buf);
-        glVertexAttribPointer(
-            1,                                // attribute
-            2,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            (void*)0                          // array buffer offset
-        );
-
-        // 3rd attribute buffer : normals
-        glEnableVertexAttribArray(2);
-        glBindBuffer(GL_ARRAY_BUFFER, ground_norm_buf);
-        glVertexAttribPointer(
-            2,                                // attribute
-            3,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            (void*)0                          // array buffer offset
-        );
+        glBindVertexArray(ground_vao);
+
+        instance_vec.clear();
+        RenderInstance_s ground_instance;
+        ground_instance.model_mat = ground_model_mat;
+        ground_instance.color_added = glm::vec3(0.0f, 0.0f, 0.0f);
+        instance_vec.push_back(ground_instance);
+        upload_render_instances(ground_inst_buf, instance_vec);
 
         // Draw the triangle !
-        glDrawArrays(GL_TRIANGLES, 0, 6*3);
+        glDrawArraysInstanced(GL_TRIANGLES, 0, ground_vert_cnt, 1);
 
         /*****************************************************************************/
         /********************************* DRAW OBST *********************************/
         /*****************************************************************************/
 
+        frame_timer.begin_section(FRAME_SECTION_OBST);
+
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, obst_texture);
+        glBindTexture(GL_TEXTURE_2D, get_texture_id(p_obst_texture));
         glUniform1i(TextureID, 1);
 
-        // 1rst attribute buffer : vertices
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, obst_vect_buf);
-        glVertexAttribPointer(
-            0,                  // attribute
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void*)0            // array buffer offset
-        );
-
-        // 2nd attribute buffer : UVs
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, obst_uv_buf);
-        glVertexAttribPointer(
-            1,                                // attribute
-            2,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            (void*)0                          // array buffer offset
-        );
-
-        // 3rd attribute buffer : normals
-        glEnableVertexAttribArray(2);
-        glBindBuffer(GL_ARRAY_BUFFER, obst_norm_buf);
-        glVertexAttribPointer(
-            2,                                // attribute
-            3,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            (void*)0                          // array buffer offset
-        );
-
-        // Index buffer
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obst_elem_buf);
-
-        for (int obst_idx = 0; obst_idx < env.obst_vec.size(); obst_idx ++)
-        {
-            Obst const & obst = env.obst_vec[obst_idx];
-            if (obst.get_is_activated() == false) {
-                continue;
-            }
-            glm::mat4 obst_model_mat = obst.get_model_matrix(); //glm::mat4(1.0);
-            glm::mat4 obst_mvp_mat = ProjectionMatrix * ViewMatrix * obst_model_mat;
-
-            // Send our transformation to the currently bound shader,
-            // in the "MVP" uniform
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &obst_mvp_mat[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &obst_model_mat[0][0]);
-            glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
-            glUniform3f(ColorAddedID, 0.0f, 0.0f, 0.0f);
-            if (obst.get_is_hit()) {
-                glUniform3f(ColorAddedID, 255.0f, 0.0f, 0.0f);
-            }
-
-            // Draw the triangles !
-            glDrawElements(
-                GL_TRIANGLES,      // mode
-                obst_indices.size(),    // count
-                GL_UNSIGNED_SHORT,   // type
-                (void*)0           // element array buffer offset
-            );
-        }
+        visible_idx_vec.clear();
+        frustum.cull_spheres(snapshot.obst_vec, get_mesh_bound_r(p_obst_mesh), visible_idx_vec, &cull_window_stats[CULL_CATEGORY_OBST]);
+        instance_vec.clear();
+        add_render_instances(instance_vec, snapshot.obst_vec, visible_idx_vec, true);
+        draw_mesh_instances(p_obst_mesh, obst_vao, obst_inst_buf, instance_vec, 0);
 
         /*****************************************************************************/
         /********************************* DRAW TANK *********************************/
         /*****************************************************************************/
 
+        frame_timer.begin_section(FRAME_SECTION_TANK);
+
         glActiveTexture(GL_TEXTURE2);
-        glBindTexture(GL_TEXTURE_2D, tank_texture);
+        glBindTexture(GL_TEXTURE_2D, get_texture_id(p_tank_texture));
         glUniform1i(TextureID, 2);
 
-        // 1rst attribute buffer : vertices
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, tank_vect_buf);
-        glVertexAttribPointer(
-            0,                  // attribute
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void*)0            // array buffer offset
-        );
-
-        // 2nd attribute buffer : UVs
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, tank_uv_buf);
-        glVertexAttribPointer(
-            1,                                // attribute
-            2,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            (void*)0                          // array buffer offset
-        );
-
-        // 3rd attribute buffer : normals
-        glEnableVertexAttribArray(2);
-        glBindBuffer(GL_ARRAY_BUFFER, tank_norm_buf);
-        glVertexAttribPointer(
-            2,                                // attribute
-            3,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            (void*)0                          // array buffer offset
-        );
-
-        // Index buffer
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, tank_elem_buf);
-
-        for (int tank_idx = 0; tank_idx < env.tank_vec.size(); tank_idx ++)
-        {
-            Tank const & tank = env.tank_vec[tank_idx];
-            if (tank.get_is_alive() == false) {
-                continue;
-            }
-
-            glm::mat4 tank_model_mat = tank.get_model_matrix(); //glm::mat4(1.0);
-            glm::mat4 tank_mvp_mat = ProjectionMatrix * ViewMatrix * tank_model_mat;
-
-            // Send our transformation to the currently bound shader,
-            // in the "MVP" uniform
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &tank_mvp_mat[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &tank_model_mat[0][0]);
-            glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
-            glUniform3f(ColorAddedID, 0.0f, 0.0f, 0.0f);
-            if (tank.get_is_hit()){
-                glUniform3f(ColorAddedID, 255.0f, 0.0f, 0.0f);
-            }
-
-            // Draw the triangles !
-            glDrawElements(
-                GL_TRIANGLES,      // mode
-                tank_indices.size(),    // count
-                GL_UNSIGNED_SHORT,   // type
-                (void*)0           // element array buffer offset
-            );
-        }
+        visible_idx_vec.clear();
+        frustum.cull_spheres(snapshot.tank_vec, get_mesh_bound_r(p_tank_mesh), visible_idx_vec, &cull_window_stats[CULL_CATEGORY_TANK]);
+        // level of detail from the projected height, clip w being the view depth
+        int tank_num_lods = p_tank_mesh != NULL && is_tank_lod_used ? p_tank_mesh->num_lods : 1;
+        int fb_width = 0, fb_height = 0;
+        glfwGetFramebufferSize(window, &fb_width, &fb_height);
+        tank_lod_vec.resize(snapshot.tank_vec.size(), 0);
+        for (int lod = 0; lod < TANK_MESH_MAX_LODS; lod ++) {
+            tank_lod_idx_vec[lod].clear();
+        }
+        for (int visible_idx = 0; visible_idx < visible_idx_vec.size(); visible_idx ++) {
+            int tank_idx = visible_idx_vec[visible_idx];
+            RenderSphere_s const & tank = snapshot.tank_vec[tank_idx];
+            glm::vec4 clip_pos = vp_mat * glm::vec4(tank.x, tank.y, tank.z, 1.0f);
+            float size_px = 2.0f * tank.scale * get_mesh_bound_r(p_tank_mesh) * ProjectionMatrix[1][1] / std::max(clip_pos.w, 1e-3f) * 0.5f * fb_height;
+            int lod = select_tank_lod(size_px, tank_lod_vec[tank_idx], tank_num_lods);
+            tank_lod_vec[tank_idx] = lod;
+            tank_lod_idx_vec[lod].push_back(tank_idx);
+        }
+        for (int lod = 0; lod < tank_num_lods; lod ++) {
+            instance_vec.clear();
+            add_render_instances(instance_vec, snapshot.tank_vec, tank_lod_idx_vec[lod], true);
+            draw_mesh_instances(p_tank_mesh, tank_vao, tank_inst_buf, instance_vec, lod);
+            tank_lod_window_cnt[lod] += tank_lod_idx_vec[lod].size();
+            tank_window_num_tris += p_tank_mesh != NULL ? tank_lod_idx_vec[lod].size() * (p_tank_mesh->lod_elem_cnt[lod] / 3) : 0;
+        }
+        window_num_frames ++;
 
         /*****************************************************************************/
         /********************************* DRAW AMMO *********************************/
         /*****************************************************************************/
 
+        frame_timer.begin_section(FRAME_SECTION_AMMO);
+
         glActiveTexture(GL_TEXTURE3);
-        glBindTexture(GL_TEXTURE_2D, ammo_texture);
+        glBindTexture(GL_TEXTURE_2D, get_texture_id(p_ammo_texture));
         glUniform1i(TextureID, 3);
 
-        // 1rst attribute buffer : vertices
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, ammo_vect_buf);
-        glVertexAttribPointer(
-            0,                  // attribute
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void*)0            // array buffer offset
-        );
-
-        // 2nd attribute buffer : UVs
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, ammo_uv_buf);
-        glVertexAttribPointer(
-            1,                                // attribute
-            2,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            (void*)0                          // array buffer offset
-        );
-
-        // 3rd attribute buffer : normals
-        glEnableVertexAttribArray(2);
-        glBindBuffer(GL_ARRAY_BUFFER, ammo_norm_buf);
-        glVertexAttribPointer(
-            2,                                // attribute
-            3,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            (void*)0                          // array buffer offset
-        );
-
-        // Index buffer
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ammo_elem_buf);
-
-        for (int ammo_idx = 0; ammo_idx < env.ammo_vec.size(); ammo_idx ++)
-        {
-            Ammo const & ammo = env.ammo_vec[ammo_idx];
-            if (ammo.get_is_fired() == false) {
-                continue;
-            }
-
-            glm::mat4 ammo_model_mat = env.ammo_vec[ammo_idx].get_model_matrix(); //glm::mat4(1.0);
-            glm::mat4 ammo_mvp_mat = ProjectionMatrix * ViewMatrix * ammo_model_mat;
-
-            // Send our transformation to the currently bound shader,
-            // in the "MVP" uniform
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &ammo_mvp_mat[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &ammo_model_mat[0][0]);
-            glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
-            glUniform3f(ColorAddedID, 0.0f, 0.0f, 0.0f);
-
-            // Draw the triangles !
-             glDrawElements(
-                GL_TRIANGLES,      // mode
-                ammo_indices.size(),    // count
-                GL_UNSIGNED_SHORT,   // type
-                (void*)0           // element array buffer offset
-             );
-        }
-
-        for (int rain_idx = 0; rain_idx < env.rain_vec.size(); rain_idx ++)
-        {
-            Ammo const & rain = env.rain_vec[rain_idx];
-            if (rain.get_is_fired() == false) {
-                continue;
-            }
+        visible_idx_vec.clear();
+        frustum.cull_spheres(snapshot.ammo_vec, get_mesh_bound_r(p_ammo_mesh), visible_idx_vec, &cull_window_stats[CULL_CATEGORY_AMMO]);
+        instance_vec.clear();
+        add_render_instances(instance_vec, snapshot.ammo_vec, visible_idx_vec, false);
+        draw_mesh_instances(p_ammo_mesh, ammo_vao, ammo_inst_buf, instance_vec, 0);
 
-            glm::mat4 rain_model_mat = env.rain_vec[rain_idx].get_model_matrix(); //glm::mat4(1.0);
-            glm::mat4 rain_mvp_mat = ProjectionMatrix * ViewMatrix * rain_model_mat;
-
-            // Send our transformation to the currently bound shader,
-            // in the "MVP" uniform
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &rain_mvp_mat[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &rain_model_mat[0][0]);
-            glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
-            glUniform3f(ColorAddedID, 0.0f, 0.0f, 0.0f);
-
-            // Draw the triangles !
-             glDrawElements(
-                GL_TRIANGLES,      // mode
-                ammo_indices.size(),    // count
-                GL_UNSIGNED_SHORT,   // type
-                (void*)0           // element array buffer offset
-             );
-        }
+        // rain drops share the ammo mesh
+        frame_timer.begin_section(FRAME_SECTION_RAIN);
+        visible_idx_vec.clear();
+        frustum.cull_spheres(snapshot.rain_vec, get_mesh_bound_r(p_ammo_mesh), visible_idx_vec, &cull_window_stats[CULL_CATEGORY_RAIN]);
+        instance_vec.clear();
+        add_render_instances(instance_vec, snapshot.rain_vec, visible_idx_vec, false);
+        draw_mesh_instances(p_ammo_mesh, rain_vao, rain_inst_buf, instance_vec, 0);
 
         /*****************************************************************************/
         /******************************* DRAW RAIN SHADOW ****************************/
         /*****************************************************************************/
 
+        frame_timer.begin_section(FRAME_SECTION_SHADOW);
+
         glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, ground_texture);
+        glBindTexture(GL_TEXTURE_2D, get_texture_id(p_ground_texture));
         glUniform1i(TextureID, 0);
 
-        // 1rst attribute buffer : vertices
-        glEnableVertexAttribArray(0);
-        glBindBuffer(GL_ARRAY_BUFFER, ground_vert_buf);
-        glVertexAttribPointer(
-            0,                  // attribute. No particular reason for 0, but must match the layout in the shader.
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            (void*)0            // array buffer offset
-        );
-
-        // 2nd attribute buffer : UVs
-        glEnableVertexAttribArray(1);
-        glBindBuffer(GL_ARRAY_BUFFER, ground_uv_buf);
-        glVertexAttribPointer(
-            1,                                // attribute
-            2,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            (void*)0                          // array buffer offset
-        );
-
-        // 3rd attribute buffer : normals
-        glEnableVertexAttribArray(2);
-        glBindBuffer(GL_ARRAY_BUFFER, ground_norm_buf);
-        glVertexAttribPointer(
-            2,                                // attribute
-            3,                                // size
-            GL_FLOAT,                         // type
-            GL_FALSE,                         // normalized?
-            0,                                // stride
-            (void*)0                          // array buffer offset
-        );
-
-
-
-        for (int rain_idx = 0; rain_idx < env.rain_vec.size(); rain_idx ++)
+        glBindVertexArray(spot_vao);
+
+        instance_vec.clear();
+        CullStats_s & spot_stats = cull_window_stats[CULL_CATEGORY_SHADOW];
+        for (int rain_idx = 0; rain_idx < snapshot.rain_vec.size(); rain_idx ++)
         {
-            Ammo const & rain = env.rain_vec[rain_idx];
-            if (rain.get_is_fired() == false) {
+            RenderSphere_s const & rain = snapshot.rain_vec[rain_idx];
+
+            #define RAIN_SPOT_Z_TO_SCALE(z)         (((env.scenario.bound.z_max - z) / env.scenario.bound.z_max) * 0.5f)
+            spot_stats.num_tested ++;
+            if (frustum.is_sphere_visible(rain.x, rain.y, 0.01f, RAIN_SPOT_Z_TO_SCALE(rain.z) * RAIN_SPOT_BOUND_R_PER_SCALE) == false) {
                 continue;
             }
-
-            #define RAIN_SPOT_Z_TO_SCALE(z)         (((BOUND_Z_MAX - z) / BOUND_Z_MAX) * 0.5f)
-            glm::mat4 spot_scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(RAIN_SPOT_Z_TO_SCALE(rain.get_z()), RAIN_SPOT_Z_TO_SCALE(rain.get_z()), RAIN_SPOT_Z_TO_SCALE(rain.get_z())));
+            spot_stats.num_visible ++;
+            glm::mat4 spot_scale_mat = glm::scale(glm::mat4(1.0f), glm::vec3(RAIN_SPOT_Z_TO_SCALE(rain.z), RAIN_SPOT_Z_TO_SCALE(rain.z), RAIN_SPOT_Z_TO_SCALE(rain.z)));
             glm::mat4 spot_rotat_mat = glm::rotate(glm::mat4(1.0f), 0.0f, glm::vec3(1, 0, 0));
-            glm::mat4 spot_trans_mat = glm::translate(glm::mat4(1.0f), glm::vec3(rain.get_x(), rain.get_y(), 0.01f));
-            glm::mat4 spot_model_mat = spot_trans_mat * spot_rotat_mat * spot_scale_mat;
-            glm::mat4 spot_mvp_mat = ProjectionMatrix * ViewMatrix * spot_model_mat;
-
-            // Send our transformation to the currently bound shader,
-            // in the "MVP" uniform
-            glUniformMatrix4fv(MatrixID, 1, GL_FALSE, &spot_mvp_mat[0][0]);
-            glUniformMatrix4fv(ModelMatrixID, 1, GL_FALSE, &spot_model_mat[0][0]);
-            glUniformMatrix4fv(ViewMatrixID, 1, GL_FALSE, &ViewMatrix[0][0]);
-            glUniform3f(ColorAddedID, 0.0f, 0.0f, 255.0f);
-
-             // Draw the triangle !
-            glDrawArrays(GL_TRIANGLES, 0, 6*3);
+            glm::mat4 spot_trans_mat = glm::translate(glm::mat4(1.0f), glm::vec3(rain.x, rain.y, 0.01f));
+
+            RenderInstance_s spot_instance;
+            spot_instance.model_mat = spot_trans_mat * spot_rotat_mat * spot_scale_mat;
+            spot_instance.color_added = glm::vec3(0.0f, 0.0f, 255.0f);
+            instance_vec.push_back(spot_instance);
         }
+        upload_render_instances(spot_inst_buf, instance_vec);
+
+        // Draw the triangles !
+        glDrawArraysInstanced(GL_TRIANGLES, 0, ground_vert_cnt, instance_vec.size());
 
-        glDisableVertexAttribArray(0);
-        glDisableVertexAttribArray(1);
-        glDisableVertexAttribArray(2);
+        glBindVertexArray(0);
+
+        frame_timer.end_section();
 
         // Swap buffers
+        frame_timer.begin_section(FRAME_SECTION_SWAP);
         glfwSwapBuffers(window);
+        frame_timer.end_section();
         glfwPollEvents();
 
     } // Check if the ESC key was pressed or the window was closed
@@ -1395,36 +710,57 @@ int main( void ) {
     glDeleteProgram(programID);
 
     // Cleanup VBO and shader
-    glDeleteTextures(1, &ground_texture);
     glDeleteBuffers(1, &ground_vert_buf);
-    glDeleteBuffers(1, &ground_uv_buf);
-    glDeleteBuffers(1, &ground_norm_buf);
-
-    glDeleteTextures(1, &obst_texture);
-    glDeleteBuffers(1, &obst_vect_buf);
-    glDeleteBuffers(1, &obst_uv_buf);
-    glDeleteBuffers(1, &obst_norm_buf);
-    glDeleteBuffers(1, &obst_elem_buf);
-
-    glDeleteTextures(1, &tank_texture);
-    glDeleteBuffers(1, &tank_vect_buf);
-    glDeleteBuffers(1, &tank_uv_buf);
-    glDeleteBuffers(1, &tank_norm_buf);
-    glDeleteBuffers(1, &tank_elem_buf);
-
-    glDeleteTextures(1, &ammo_texture);
-    glDeleteBuffers(1, &ammo_vect_buf);
-    glDeleteBuffers(1, &ammo_uv_buf);
-    glDeleteBuffers(1, &ammo_norm_buf);
-    glDeleteBuffers(1, &ammo_elem_buf);
-
-    glDeleteVertexArrays(1, &VertexArrayID);
+    assets.release_texture("ground.bmp");
+    assets.release_texture("box.dds");
+    assets.release_mesh("box.obj");
+    assets.release_texture("tank.dds");
+    assets.release_mesh("tank.obj");
+    assets.release_texture("tank.dds");
+    assets.release_mesh("bomb.obj");
+
+    glDeleteBuffers(1, &ground_inst_buf);
+    glDeleteBuffers(1, &obst_inst_buf);
+    glDeleteBuffers(1, &tank_inst_buf);
+    glDeleteBuffers(1, &ammo_inst_buf);
+    glDeleteBuffers(1, &rain_inst_buf);
+    glDeleteBuffers(1, &spot_inst_buf);
+
+    glDeleteVertexArrays(1, &ground_vao);
+    glDeleteVertexArrays(1, &obst_vao);
+    glDeleteVertexArrays(1, &tank_vao);
+    glDeleteVertexArrays(1, &ammo_vao);
+    glDeleteVertexArrays(1, &rain_vao);
+    glDeleteVertexArrays(1, &spot_vao);
 
     // Close OpenGL window and terminate GLFW
     glfwTerminate();
 
     env.is_terminated = 1;
     env_proc_thread.join();
+    recorder.close();
+    client.close();
+
+    printf("ammo pool: %d live, high water %d / %d, %lu allocs failed\n", env.ammo_pool.size(), env.ammo_pool.get_high_water_mark(), env.ammo_pool.get_capacity(), env.ammo_pool.get_num_alloc_failed());
+    if (getenv("TANK_INPUT_LATENCY") != NULL) {
+        LogHistogram const & latency_hist = input.get_latency_hist();
+        printf("input latency: %llu samples, mean %.3f ms, p50 < %.3f ms, p99 < %.3f ms, max %.3f ms\n", latency_hist.get_num_samples(),
+            latency_hist.get_mean() * 1e-6, latency_hist.get_percentile(0.5) * 1e-6, latency_hist.get_percentile(0.99) * 1e-6, latency_hist.get_max() * 1e-6);
+        printf("input events dropped: %lu\n", input.get_num_dropped());
+    }
+    if (profile_str != NULL) {
+        prof_print(stdout, false);
+    }
+    frame_timer.print(stdout);
+    for (int category = 0; category < CULL_CATEGORY_NUM; category ++) {
+        cull_total_stats[category].num_tested += cull_window_stats[category].num_tested;
+        cull_total_stats[category].num_visible += cull_window_stats[category].num_visible;
+    }
+    cull_stats_print(stdout, g_cull_category_names, cull_total_stats, CULL_CATEGORY_NUM);
+    if (frame_csv_path != NULL) {
+        frame_timer.write_csv(frame_csv_path);
+    }
+    trace_write();
 
     return 0;
 }